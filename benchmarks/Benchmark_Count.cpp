@@ -0,0 +1,182 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures InvertedDataSetIndex::Count(ItemSet) throughput with each bitmap
+// kernel the CPU supports, against the chunked TidList layout the index
+// used to store.
+//
+// Usage: Benchmark_Count [data set CSV files...]
+// Defaults to the mushroom and census1 data sets; run from the repository
+// root.
+
+#include <stdio.h>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "BitmapKernels.h"
+#include "DataSetReader.h"
+#include "InvertedDataSetIndex.h"
+#include "ItemSet.h"
+#include "TidList.h"
+#include "utils.h"
+
+using namespace std;
+
+// The index layout and Count() implementation InvertedDataSetIndex had
+// before it switched to bitmap rows.
+class LegacyIndex {
+public:
+  explicit LegacyIndex(DataSetReader& aReader) {
+    vector<Item> transaction;
+    int tid = 0;
+    while (aReader.GetNext(transaction)) {
+      ++tid;
+      for (const Item item : transaction) {
+        mInvertedIndex[item.GetId()].Set(tid, true);
+      }
+    }
+  }
+
+  int Count(const ItemSet& aItemSet) const {
+    vector<const TidList*> tidLists;
+    for (const Item item : aItemSet.mItems) {
+      auto t = mInvertedIndex.find(item.GetId());
+      if (t != mInvertedIndex.end()) {
+        tidLists.push_back(&(t->second));
+      }
+    }
+    if (tidLists.empty()) {
+      return 0;
+    }
+    int count = 0;
+    vector<vector<unsigned>*> firstTidlist = tidLists[0]->mChunks;
+    for (unsigned f = 0; f < firstTidlist.size(); f++) {
+      vector<unsigned>* chunks = firstTidlist[f];
+      if (!chunks) {
+        continue;
+      }
+      for (unsigned i = 0; i < chunks->size(); ++i) {
+        unsigned chunk = chunks->at(i);
+        if (chunk) {
+          for (unsigned t = 1; t < tidLists.size(); t++) {
+            chunk &= tidLists[t]->GetChunk(f, i);
+          }
+        }
+        count += PopulationCount(chunk);
+      }
+    }
+    return count;
+  }
+
+private:
+  map<int, TidList> mInvertedIndex;
+};
+
+// Apriori style candidates; every pair of items, and a sample of triples of
+// items, which appear in at least 1% of transactions.
+static vector<ItemSet> MakeCandidates(const InvertedDataSetIndex& aIndex) {
+  vector<Item> items;
+  for (const Item item : aIndex.GetItems()) {
+    if (aIndex.Count(item) * 100 >= (int)aIndex.NumTransactions()) {
+      items.push_back(item);
+    }
+  }
+  vector<ItemSet> candidates;
+  for (size_t i = 0; i < items.size(); i++) {
+    for (size_t j = i + 1; j < items.size(); j++) {
+      ItemSet candidate;
+      candidate.Add(items[i]);
+      candidate.Add(items[j]);
+      candidates.push_back(candidate);
+    }
+  }
+  mt19937 rng(1);
+  uniform_int_distribution<size_t> pick(0, items.size() - 1);
+  for (int n = 0; n < 20000 && items.size() >= 3; n++) {
+    ItemSet candidate;
+    while (candidate.Size() < 3) {
+      candidate.Add(items[pick(rng)]);
+    }
+    candidates.push_back(candidate);
+  }
+  return candidates;
+}
+
+template<class Index>
+static double Run(const Index& aIndex,
+                  const vector<ItemSet>& aCandidates,
+                  vector<int>& aCounts) {
+  aCounts.assign(aCandidates.size(), 0);
+  // Repeat until we've run for long enough to get a stable measurement.
+  int rounds = 0;
+  DurationTimer timer;
+  do {
+    for (size_t i = 0; i < aCandidates.size(); i++) {
+      aCounts[i] = aIndex.Count(aCandidates[i]);
+    }
+    rounds++;
+  } while (timer.Seconds() < 0.5);
+  return (double)aCandidates.size() * rounds / timer.Seconds();
+}
+
+static void Benchmark(const string& aFileName) {
+  InvertedDataSetIndex index(make_unique<DataSetReader>(aFileName));
+  if (!index.Load()) {
+    return;
+  }
+  // Reading the file again assigns the same item ids.
+  DataSetReader reader(aFileName);
+  LegacyIndex legacy(reader);
+
+  const vector<ItemSet> candidates = MakeCandidates(index);
+  printf("\n%s: %u transactions, %u items, %zu candidates\n",
+         aFileName.c_str(), index.NumTransactions(), index.GetNumItems(),
+         candidates.size());
+
+  vector<int> expected;
+  const double legacyRate = Run(legacy, candidates, expected);
+  printf("  %-8s %12.0f counts/s\n", "legacy", legacyRate);
+
+  const eBitmapKernel selected = GetBitmapKernel();
+  const eBitmapKernel kernels[] = {kBitmapScalar, kBitmapPopcnt, kBitmapAVX2, kBitmapAVX512};
+  for (const eBitmapKernel kernel : kernels) {
+    if (!SetBitmapKernel(kernel)) {
+      printf("  %-8s not supported\n", GetBitmapKernelName(kernel));
+      continue;
+    }
+    vector<int> counts;
+    const double rate = Run(index, candidates, counts);
+    printf("  %-8s %12.0f counts/s  %5.1fx%s\n",
+           GetBitmapKernelName(kernel), rate, rate / legacyRate,
+           counts == expected ? "" : "  MISMATCH");
+  }
+  SetBitmapKernel(selected);
+}
+
+int main(int argc, const char* argv[]) {
+  vector<string> fileNames;
+  for (int i = 1; i < argc; i++) {
+    fileNames.push_back(argv[i]);
+  }
+  if (fileNames.empty()) {
+    fileNames = {"datasets/mushroom.csv", "datasets/test/census1.csv"};
+  }
+  for (const string& fileName : fileNames) {
+    Benchmark(fileName);
+  }
+  return 0;
+}
@@ -20,13 +20,19 @@
 #include "Item.h"
 #include "ItemSet.h"
 #include "InvertedDataSetIndex.h"
+#include "ItemSetTrie.h"
+#include "CandidateTrie.h"
 #include "AprioriFilter.h"
 #include "TidList.h"
 #include "debug.h"
 #include <thread>
 #include "Options.h"
 #include <sstream>
-#include <future>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <algorithm>
+#include <string.h>
 
 using namespace std;
 
@@ -43,84 +49,489 @@ bool ContainsAllSubSets(const set<ItemSet>& aContainer, const ItemSet& aItemSet)
   return true;
 }
 
-static void
-safeAdvance(set<ItemSet>::const_iterator& aIter,
-            const set<ItemSet>::const_iterator end,
-            uint32_t aStep)
-{
-  for (uint32_t i = 0; i < aStep && aIter != end; i++) {
-    aIter++;
+// The itemsets of one Apriori generation, all the same size, stored as
+// rows of item ids. Each row's ids are in increasing order, and the rows are
+// in lexicographic order, so itemsets which share all but their last item,
+// a prefix class, are adjacent.
+struct CandidateLevel {
+  explicit CandidateLevel(unsigned aItemSetSize)
+    : itemSetSize(aItemSetSize) {
+  }
+
+  size_t Size() const {
+    return counts.size();
+  }
+
+  const int* Row(size_t aIndex) const {
+    return ids.data() + aIndex * itemSetSize;
+  }
+
+  void Append(const int* aIds, int aCount) {
+    ids.insert(ids.end(), aIds, aIds + itemSetSize);
+    counts.push_back(aCount);
+  }
+
+  void Append(const CandidateLevel& aOther) {
+    ASSERT(aOther.itemSetSize == itemSetSize);
+    ids.insert(ids.end(), aOther.ids.begin(), aOther.ids.end());
+    counts.insert(counts.end(), aOther.counts.begin(), aOther.counts.end());
+  }
+
+  unsigned itemSetSize;
+  std::vector<int> ids;
+  // Count of each row's itemset, or -1 if the filter which accepted it
+  // didn't count it.
+  std::vector<int> counts;
+};
+
+// Hash table of the rows of a CandidateLevel, used to check that all of a
+// candidate's subsets survived the previous generation.
+class CandidateLevelIndex {
+public:
+  explicit CandidateLevelIndex(const CandidateLevel& aLevel)
+    : mLevel(aLevel) {
+    size_t numSlots = 2;
+    while (numSlots < 2 * aLevel.Size()) {
+      numSlots *= 2;
+    }
+    mSlots.assign(numSlots, 0);
+    const size_t mask = numSlots - 1;
+    for (size_t row = 0; row < aLevel.Size(); row++) {
+      size_t slot = Hash(aLevel.Row(row)) & mask;
+      while (mSlots[slot]) {
+        slot = (slot + 1) & mask;
+      }
+      mSlots[slot] = (uint32_t)row + 1;
+    }
+  }
+
+  bool Contains(const int* aIds) const {
+    const size_t mask = mSlots.size() - 1;
+    const size_t numBytes = mLevel.itemSetSize * sizeof(int);
+    for (size_t slot = Hash(aIds) & mask; mSlots[slot]; slot = (slot + 1) & mask) {
+      if (memcmp(mLevel.Row(mSlots[slot] - 1), aIds, numBytes) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  uint64_t Hash(const int* aIds) const {
+    uint64_t hash = 0;
+    for (unsigned i = 0; i < mLevel.itemSetSize; i++) {
+      hash = (hash ^ (uint32_t)aIds[i]) * 0x9E3779B97F4A7C15ULL;
+    }
+    return hash ^ (hash >> 29);
+  }
+
+  const CandidateLevel& mLevel;
+  // Row number + 1 of the row in each slot, or 0 if the slot is empty.
+  std::vector<uint32_t> mSlots;
+};
+
+static ItemSet ToItemSet(const int* aIds, unsigned aNumIds) {
+  ItemSet itemset;
+  for (unsigned i = 0; i < aNumIds; i++) {
+    itemset.Add(Item(aIds[i]));
   }
+  return itemset;
 }
 
-set<ItemSet>
-GenerateSubCandidates(const set<ItemSet>& aCandidates,
-                      uint32_t aStartOffset,
-                      uint32_t aItemSetSize,
-                      uint32_t aStep,
-                      shared_ptr<AprioriFilter> aFilter)
+// Joins each of aLevel's rows [aBegin,aEnd) with the rows after it in its
+// prefix class, which ends at aClassEnds[x] for row x, appending the
+// candidates whose subsets are all in aLevel and which pass aFilter to
+// aResult. If aFilter is null, the candidates are appended uncounted.
+// Candidates are appended in lexicographic order.
+static void JoinRows(const CandidateLevel& aLevel,
+                     const CandidateLevelIndex& aLevelIndex,
+                     const vector<size_t>& aClassEnds,
+                     size_t aBegin,
+                     size_t aEnd,
+                     const AprioriFilter* aFilter,
+                     CandidateLevel& aResult) {
+  const unsigned n = aLevel.itemSetSize;
+  const unsigned k = n + 1;
+  vector<int> candidate(k);
+  vector<int> subset(n);
+  for (size_t x = aBegin; x < aEnd; x++) {
+    copy(aLevel.Row(x), aLevel.Row(x) + n, candidate.begin());
+    for (size_t y = x + 1; y < aClassEnds[x]; y++) {
+      candidate[n] = aLevel.Row(y)[n - 1];
+      // Removing either of the last two items leaves one of the itemsets
+      // joined, so only the other subsets need checking.
+      bool frequentSubsets = true;
+      for (unsigned skip = 0; frequentSubsets && skip + 2 < k; skip++) {
+        copy(candidate.begin(), candidate.begin() + skip, subset.begin());
+        copy(candidate.begin() + skip + 1, candidate.end(), subset.begin() + skip);
+        frequentSubsets = aLevelIndex.Contains(subset.data());
+      }
+      if (!frequentSubsets) {
+        continue;
+      }
+      if (!aFilter) {
+        aResult.Append(candidate.data(), -1);
+        continue;
+      }
+      ItemSet itemset = ToItemSet(candidate.data(), k);
+      int count = -1;
+      if (aFilter->Filter(itemset, count)) {
+        aResult.Append(candidate.data(), count);
+      }
+    }
+  }
+}
+
+// Finds the prefix classes of aLevel; the ranges of rows which share their
+// first n-1 items. aClassEnds[x] is set to one past the last row of row x's
+// class. Returns the number of joins in the classes, to which the work of
+// generating the next level is proportional.
+static uint64_t FindPrefixClasses(const CandidateLevel& aLevel,
+                                  vector<size_t>& aClassEnds) {
+  uint64_t numJoins = 0;
+  aClassEnds.resize(aLevel.Size());
+  const size_t prefixBytes = (aLevel.itemSetSize - 1) * sizeof(int);
+  for (size_t begin = 0, end; begin < aLevel.Size(); begin = end) {
+    end = begin + 1;
+    while (end < aLevel.Size() &&
+           memcmp(aLevel.Row(begin), aLevel.Row(end), prefixBytes) == 0) {
+      end++;
+    }
+    fill(aClassEnds.begin() + begin, aClassEnds.begin() + end, end);
+    numJoins += (uint64_t)(end - begin) * (end - begin - 1) / 2;
+  }
+  return numJoins;
+}
+
+// Splits the rows of a level, whose prefix classes end at aClassEnds, into
+// chunks of roughly equal work for aNumThreads threads. Row x's work is its
+// aClassEnds[x] - x - 1 joins. Chunks are ranges of rows, so a chunk can
+// hold several small classes, or some of the rows of a large one; at level 2
+// every row is in the one class. Returns the first row of each chunk and one
+// past the last row, or nothing if there are no joins.
+vector<size_t> SplitJoinsIntoChunks(const vector<size_t>& aClassEnds,
+                                    unsigned aNumThreads) {
+  vector<size_t> chunks;
+  uint64_t totalWork = 0;
+  for (size_t x = 0; x < aClassEnds.size(); x++) {
+    totalWork += aClassEnds[x] - x - 1;
+  }
+  if (totalWork == 0) {
+    return chunks;
+  }
+  // Aim for several chunks per thread, so that threads which draw cheap
+  // chunks can take more.
+  const uint64_t workPerChunk =
+    max<uint64_t>(totalWork / (16 * max(aNumThreads, 1u)), 1);
+  uint64_t work = workPerChunk;
+  for (size_t x = 0; x < aClassEnds.size(); x++) {
+    const uint64_t rowWork = aClassEnds[x] - x - 1;
+    if (rowWork == 0) {
+      continue;
+    }
+    if (work >= workPerChunk) {
+      chunks.push_back(x);
+      work = 0;
+    }
+    work += rowWork;
+  }
+  chunks.push_back(aClassEnds.size());
+  return chunks;
+}
+
+// Generates the next generation of candidates from aLevel on numThreads
+// threads. The rows are split into chunks of roughly equal work, which the
+// threads claim as they go. Each thread appends its chunks' candidates to
+// its own result, and the threads then copy their chunks into place in the
+// combined result, which is in chunk order, and so sorted.
+// If aFilter is null, the candidates are all kept, and left uncounted.
+static CandidateLevel
+GenerateNextLevel(const CandidateLevel& aLevel,
+                  const AprioriFilter* aFilter,
+                  int numThreads)
 {
-  set<ItemSet> result;
-  set<ItemSet>::const_iterator iter = aCandidates.cbegin();
-  safeAdvance(iter, aCandidates.end(), aStartOffset);
-  for (; iter != aCandidates.end(); safeAdvance(iter, aCandidates.end(), aStep)) {
-    set<ItemSet>::const_iterator y = aCandidates.begin();
-    for (const ItemSet& y : aCandidates) {
-      const ItemSet& x = *iter;
-      if (IntersectionSize(x, y) == aItemSetSize - 2) {
-        ItemSet itemset(x, y);
-        if (aFilter->Filter(itemset) && ContainsAllSubSets(aCandidates, itemset)) {
-          result.insert(move(itemset));
-        }
+  const unsigned n = aLevel.itemSetSize;
+  CandidateLevel result(n + 1);
+
+  const unsigned cores = max(numThreads, 1);
+  vector<size_t> classEnds;
+  FindPrefixClasses(aLevel, classEnds);
+  const vector<size_t> chunks = SplitJoinsIntoChunks(classEnds, cores);
+  if (chunks.empty()) {
+    return result;
+  }
+  const size_t numChunks = chunks.size() - 1;
+
+  // The workers only read aLevel; each has its own result. chunkRows[i] is
+  // the range of rows of chunk i in its worker's result.
+  const CandidateLevelIndex levelIndex(aLevel);
+  vector<CandidateLevel> workerResults(cores, CandidateLevel(n + 1));
+  vector<unsigned> chunkWorker(numChunks);
+  vector<pair<size_t, size_t>> chunkRows(numChunks);
+  atomic<size_t> nextChunk(0);
+  auto generate = [&](unsigned aWorker) {
+    CandidateLevel& workerResult = workerResults[aWorker];
+    size_t chunk;
+    while ((chunk = nextChunk++) < numChunks) {
+      const size_t firstRow = workerResult.Size();
+      JoinRows(aLevel, levelIndex, classEnds, chunks[chunk], chunks[chunk + 1],
+               aFilter, workerResult);
+      chunkWorker[chunk] = aWorker;
+      chunkRows[chunk] = make_pair(firstRow, workerResult.Size());
+    }
+  };
+  vector<thread> workers;
+  for (unsigned i = 0; i < cores; i++) {
+    workers.push_back(thread(generate, i));
+  }
+  for (thread& t : workers) {
+    t.join();
+  }
+
+  // Offset of each chunk's rows in the combined result.
+  vector<size_t> chunkOffsets(numChunks + 1, 0);
+  for (size_t chunk = 0; chunk < numChunks; chunk++) {
+    chunkOffsets[chunk + 1] = chunkOffsets[chunk] +
+                              chunkRows[chunk].second - chunkRows[chunk].first;
+  }
+  const size_t numRows = chunkOffsets[numChunks];
+  result.ids.resize(numRows * (n + 1));
+  result.counts.resize(numRows);
+  auto combine = [&](unsigned aWorker) {
+    const CandidateLevel& workerResult = workerResults[aWorker];
+    for (size_t chunk = 0; chunk < numChunks; chunk++) {
+      if (chunkWorker[chunk] != aWorker) {
+        continue;
       }
-    } // for y
-  } // for x
+      const size_t begin = chunkRows[chunk].first;
+      const size_t end = chunkRows[chunk].second;
+      copy(workerResult.Row(begin), workerResult.Row(end),
+           result.ids.begin() + chunkOffsets[chunk] * (n + 1));
+      copy(workerResult.counts.begin() + begin, workerResult.counts.begin() + end,
+           result.counts.begin() + chunkOffsets[chunk]);
+    }
+  };
+  workers.clear();
+  for (unsigned i = 0; i < cores; i++) {
+    workers.push_back(thread(combine, i));
+  }
+  for (thread& t : workers) {
+    t.join();
+  }
   return result;
 }
 
+static CandidateLevel
+GenerateInitialLevel(const InvertedDataSetIndex& aIndex,
+                     shared_ptr<AprioriFilter> aFilter) {
+  vector<pair<int, int>> items;
+  for (const Item item : aIndex.GetItems()) {
+    ItemSet itemset = item;
+    int count = -1;
+    if (aFilter->Filter(itemset, count)) {
+      items.push_back(make_pair(item.GetId(), count));
+    }
+  }
+  sort(items.begin(), items.end());
+  CandidateLevel level(1);
+  for (const auto& item : items) {
+    level.Append(&item.first, item.second);
+  }
+  return level;
+}
+
+static CandidateLevel ToCandidateLevel(const set<ItemSet>& aItemSets,
+                                       unsigned aItemSetSize) {
+  vector<vector<int>> rows;
+  for (const ItemSet& itemset : aItemSets) {
+    ASSERT(itemset.Size() == (int)aItemSetSize);
+    vector<int> row;
+    for (const Item item : itemset.mItems) {
+      row.push_back(item.GetId());
+    }
+    sort(row.begin(), row.end());
+    rows.push_back(move(row));
+  }
+  sort(rows.begin(), rows.end());
+  CandidateLevel level(aItemSetSize);
+  for (const vector<int>& row : rows) {
+    level.Append(row.data(), -1);
+  }
+  return level;
+}
+
+static set<ItemSet> ToSet(const CandidateLevel& aLevel) {
+  set<ItemSet> itemsets;
+  for (size_t i = 0; i < aLevel.Size(); i++) {
+    itemsets.insert(ToItemSet(aLevel.Row(i), aLevel.itemSetSize));
+  }
+  return itemsets;
+}
+
 set<ItemSet>
 GenerateCandidates(const set<ItemSet>& aCandidates,
                    int aItemSetSize,
                    shared_ptr<AprioriFilter> aFilter,
                    int numThreads)
 {
-  const uint32_t cores = numThreads;
-  vector<future<set<ItemSet>>> futures;
-  set<ItemSet>::iterator end = aCandidates.end();
-  for (uint32_t i = 0; i < cores; i++) {
-    auto future = std::async(std::launch::async,
-                             GenerateSubCandidates,
-                             aCandidates, i, aItemSetSize, cores, aFilter);
-    futures.push_back(move(future));
-  }
-
-  set<ItemSet> results;
-  for (future<set<ItemSet>>& future : futures) {
-    const set<ItemSet>& result = future.get();
-    results.insert(result.begin(), result.end());
-  }
- 
-  return results;
+  return ToSet(GenerateNextLevel(ToCandidateLevel(aCandidates, aItemSetSize - 1),
+                                 aFilter.get(), numThreads));
 }
 
 set<ItemSet>
 GenerateInitialCandidates(const InvertedDataSetIndex& aIndex,
                           shared_ptr<AprioriFilter> aFilter) {
-  set<ItemSet> candidates;
-  for (const Item item : aIndex.GetItems()) {
-    ItemSet itemset = item;
-    if (aFilter->Filter(itemset)) {
-      candidates.insert(move(itemset));
+  return ToSet(GenerateInitialLevel(aIndex, aFilter));
+}
+
+// The data set's transactions, keeping only the frequent items, in
+// compressed row form, for counting candidates horizontally.
+struct HorizontalDataSet {
+  HorizontalDataSet(const InvertedDataSetIndex& aIndex,
+                    const CandidateLevel& aFrequentItems) {
+    aIndex.GetTransactions(aFrequentItems.ids, offsets, items);
+  }
+
+  size_t NumTransactions() const {
+    return offsets.size() - 1;
+  }
+
+  std::vector<uint32_t> offsets;
+  std::vector<int> items;
+};
+
+// Returns the number of transactions of each length, counting only the
+// frequent items. This is all the cost model needs to know of the data set,
+// and is much cheaper to find than the transactions themselves.
+static vector<uint64_t>
+CountTransactionLengths(const InvertedDataSetIndex& aIndex,
+                        const CandidateLevel& aFrequentItems) {
+  vector<uint32_t> lengths;
+  aIndex.GetTransactionLengths(aFrequentItems.ids, lengths);
+  vector<uint64_t> numOfLength(1, 0);
+  for (const uint32_t length : lengths) {
+    if (length >= numOfLength.size()) {
+      numOfLength.resize(length + 1, 0);
     }
+    numOfLength[length]++;
+  }
+  return numOfLength;
+}
+
+// Returns true if counting aNumCandidates candidates of size k in a pass
+// over the aNumTransactions transactions, aNumOfLength[n] of which have n
+// frequent items, is estimated to be cheaper than intersecting their items'
+// transaction bitmaps. Costs are in 64 bit bitmap words ANDed. Counting
+// a transaction visits at most one trie path per k-subset of its items,
+// and no more than there are candidates.
+static bool ShouldCountHorizontally(uint64_t aNumCandidates,
+                                    unsigned k,
+                                    const vector<uint64_t>& aNumOfLength,
+                                    size_t aNumTransactions) {
+  // Cost of building an ItemSet and looking it up in the count cache,
+  // and of visiting a trie node, relative to ANDing a word.
+  const double kCandidateCost = 64;
+  const double kTrieNodeCost = 4;
+  const double numWords = (aNumTransactions + 63) / 64;
+  const double vertical = aNumCandidates * (kCandidateCost + k * numWords);
+  double horizontal = 0;
+  for (size_t length = k; length < aNumOfLength.size(); length++) {
+    // Number of k-subsets of the transaction's items, or of candidates, if
+    // that's fewer.
+    double subsets = 1;
+    for (unsigned i = 0; i < k && subsets < aNumCandidates; i++) {
+      subsets = subsets * (length - i) / (i + 1);
+    }
+    horizontal += aNumOfLength[length] * min<double>(subsets, aNumCandidates) * k;
+  }
+  horizontal = horizontal * kTrieNodeCost + aNumCandidates * kCandidateCost;
+  return horizontal < vertical;
+}
+
+// Sets the counts of aLevel's candidates by counting them in each of aData's
+// transactions. Chunks of transactions are claimed by numThreads threads,
+// which each count into their own array; the arrays are then summed.
+static void CountHorizontally(CandidateLevel& aLevel,
+                              const HorizontalDataSet& aData,
+                              int numThreads) {
+  const CandidateTrie trie(aLevel.ids.data(), aLevel.Size(), aLevel.itemSetSize);
+  const unsigned cores = max(numThreads, 1);
+  const size_t kChunkSize = 1024;
+  const size_t numChunks = (aData.NumTransactions() + kChunkSize - 1) / kChunkSize;
+  vector<vector<int>> workerCounts(cores);
+  atomic<size_t> nextChunk(0);
+  auto count = [&](unsigned aWorker) {
+    vector<int>& counts = workerCounts[aWorker];
+    counts.assign(aLevel.Size(), 0);
+    size_t chunk;
+    while ((chunk = nextChunk++) < numChunks) {
+      const size_t end = min((chunk + 1) * kChunkSize, aData.NumTransactions());
+      for (size_t t = chunk * kChunkSize; t < end; t++) {
+        trie.Count(aData.items.data() + aData.offsets[t],
+                   aData.offsets[t + 1] - aData.offsets[t], counts.data());
+      }
+    }
+  };
+  // Each thread then sums its share of the candidates' counts.
+  auto reduce = [&](unsigned aWorker) {
+    const size_t begin = aLevel.Size() * aWorker / cores;
+    const size_t end = aLevel.Size() * (aWorker + 1) / cores;
+    for (size_t i = begin; i < end; i++) {
+      int sum = 0;
+      for (const vector<int>& counts : workerCounts) {
+        sum += counts[i];
+      }
+      aLevel.counts[i] = sum;
+    }
+  };
+  auto runWorkers = [cores](const function<void(unsigned)>& aWork) {
+    vector<thread> workers;
+    for (unsigned i = 0; i < cores; i++) {
+      workers.push_back(thread(aWork, i));
+    }
+    for (thread& t : workers) {
+      t.join();
+    }
+  };
+  runWorkers(count);
+  runWorkers(reduce);
+}
+
+// Removes the counted candidates of aLevel which aFilter doesn't accept.
+static void RemoveRejected(CandidateLevel& aLevel, const AprioriFilter& aFilter) {
+  const unsigned k = aLevel.itemSetSize;
+  size_t kept = 0;
+  for (size_t i = 0; i < aLevel.Size(); i++) {
+    if (!aFilter.Accepts(aLevel.counts[i])) {
+      continue;
+    }
+    copy(aLevel.Row(i), aLevel.Row(i) + k, aLevel.ids.begin() + kept * k);
+    aLevel.counts[kept] = aLevel.counts[i];
+    kept++;
+  }
+  aLevel.ids.resize(kept * k);
+  aLevel.counts.resize(kept);
+}
+
+// Records the itemsets in aResult, counting any which the filter didn't.
+static void AddResults(const CandidateLevel& aLevel,
+                       const InvertedDataSetIndex& aIndex,
+                       ItemSetTrie& aResult) {
+  for (size_t i = 0; i < aLevel.Size(); i++) {
+    int count = aLevel.counts[i];
+    if (count < 0) {
+      count = aIndex.Count(ToItemSet(aLevel.Row(i), aLevel.itemSetSize));
+    }
+    aResult.Insert(aLevel.Row(i), aLevel.itemSetSize, count);
   }
-  return candidates;
 }
 
 void Apriori(Options& options) {
-  InvertedDataSetIndex index(make_unique<DataSetReader>(make_unique<ifstream>(options.inputFileName)));
+  InvertedDataSetIndex index(OpenDataSetReader(options.inputFileName, options.pipelineIngest));
+  index.EnableCountCache((size_t)options.countCacheMB << 20);
   index.Load();
 
-  vector<ItemSet> result;
+  ItemSetTrie result;
 
   int k = 1;
   shared_ptr<AprioriFilter> filter = nullptr;
@@ -131,35 +542,65 @@ void Apriori(Options& options) {
   }
 
   Log("Generating initial candidates...\n");
-  set<ItemSet> candidates = GenerateInitialCandidates(index, filter);
-  result.insert(result.end(), candidates.begin(), candidates.end());
+  CandidateLevel candidates = GenerateInitialLevel(index, filter);
+  AddResults(candidates, index, result);
+  // The cost model's transaction lengths, and the transactions, are found
+  // from the frequent items when first needed.
+  const CandidateLevel initialCandidates = candidates;
+  vector<uint64_t> numOfLength;
+  unique_ptr<HorizontalDataSet> horizontalData;
 
-  Log("Generated %u candidates\n", candidates.size());
+  Log("Generated %u candidates\n", candidates.Size());
 
-  time_t aprioriStartTime = time(0);
+  DurationTimer aprioriTimer;
 
-  while (candidates.size() != 0) {
-    time_t startTime = time(0);
+  while (candidates.Size() != 0) {
+    DurationTimer timer;
     k++;
-    candidates = GenerateCandidates(candidates, k, filter, options.numThreads);
-    result.insert(result.end(), candidates.begin(), candidates.end());
+    bool horizontal = false;
+    if (filter->IsCountThreshold() &&
+        options.aprioriCounting != kVerticalCounting) {
+      if (options.aprioriCounting == kHorizontalCounting) {
+        horizontal = true;
+      } else {
+        if (numOfLength.empty()) {
+          numOfLength = CountTransactionLengths(index, initialCandidates);
+        }
+        vector<size_t> classEnds;
+        const uint64_t numJoins = FindPrefixClasses(candidates, classEnds);
+        horizontal = ShouldCountHorizontally(numJoins, k, numOfLength,
+                                             index.NumTransactions());
+      }
+    }
+    if (horizontal) {
+      if (!horizontalData) {
+        horizontalData.reset(new HorizontalDataSet(index, initialCandidates));
+      }
+      candidates = GenerateNextLevel(candidates, nullptr, options.numThreads);
+      Log("Counting %u candidates in a pass over the data set\n", candidates.Size());
+      CountHorizontally(candidates, *horizontalData, options.numThreads);
+      RemoveRejected(candidates, *filter);
+    } else {
+      candidates = GenerateNextLevel(candidates, filter.get(), options.numThreads);
+    }
+    AddResults(candidates, index, result);
 
-    time_t timeTaken = (time(0) - startTime);
     Log("=============\n");
     Log("Finished generating itemsets of size %u\n", k);
-    Log("Generated %u itemsets\n", candidates.size());
-    Log("Time for generation: %lld\n", timeTaken);
+    Log("Generated %u itemsets\n", candidates.Size());
+    Log("Time for generation: %.3lfs\n", timer.Seconds());
   }
 
-  Log("Apriori finished, generated %u itemsets in %llds\n",
-      result.size(), (time(0) - aprioriStartTime));
+  Log("Apriori finished, generated %u itemsets in %.3lfs\n",
+      result.Size(), aprioriTimer.Seconds());
 
-  DumpItemSets(result, &index, options);
+  DumpItemSets(result, index.NumTransactions(), options);
 
   vector<Rule> rules;
   long numRules = 0;
   Log("Generating rules...\n");
   DurationTimer timer;
-  GenerateRules(result, 0.9, 1.0, numRules, &index, options.outputFilePrefix, options.countRulesOnly);
+  GenerateRules(result, index.NumTransactions(), &index, 0.9, 1.0, numRules,
+                options.outputFilePrefix, options.countRulesOnly, options.numThreads);
   Log("Generated %d rules in %.3lfs...\n", numRules, timer.Seconds());
 }
@@ -20,20 +20,44 @@
 #include "utils.h"
 #include "debug.h"
 
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 // Abstract class, used by Apriori algorithm to filter out ItemSets
 // during candidate generation.
 class AprioriFilter {
 public:
   // Returns true if |aItem| should be kept and passed into the next
-  // generation.
-  virtual bool Filter(ItemSet& aItem) const = 0;
+  // generation. Sets |aCount| to the number of transactions containing
+  // |aItem| if the filter counted them, otherwise -1.
+  virtual bool Filter(ItemSet& aItem, int& aCount) const = 0;
+
+  bool Filter(ItemSet& aItem) const {
+    int count;
+    return Filter(aItem, count);
+  }
+
+  // Returns true if the filter only depends on the itemset's count, in
+  // which case Accepts() filters an itemset given its count. This lets
+  // Apriori count candidates in bulk.
+  virtual bool IsCountThreshold() const {
+    return false;
+  }
+  // Only called on filters which are count thresholds.
+  virtual bool Accepts(int) const {
+    ASSERT(false);
+    return false;
+  }
 };
 
 
 class AlwaysAcceptFilter : public AprioriFilter {
 public:
-  bool Filter(ItemSet& aItem) const override
+  using AprioriFilter::Filter;
+  bool Filter(ItemSet& aItem, int& aCount) const override
   {
+    aCount = -1;
     return true;
   }
 };
@@ -47,9 +71,21 @@ public:
   {
   }
 
-  bool Filter(ItemSet& aItem) const override
+  using AprioriFilter::Filter;
+  bool Filter(ItemSet& aItem, int& aCount) const override
   {
-    return mIndex.Support(aItem) >= mMinSup;
+    aCount = mIndex.Count(aItem);
+    return Accepts(aCount);
+  }
+
+  bool IsCountThreshold() const override
+  {
+    return true;
+  }
+
+  bool Accepts(int aCount) const override
+  {
+    return (double)aCount / (double)mIndex.NumTransactions() >= mMinSup;
   }
 
 private:
@@ -66,9 +102,21 @@ public:
   {
   }
 
-  bool Filter(ItemSet& aItem) const override
+  using AprioriFilter::Filter;
+  bool Filter(ItemSet& aItem, int& aCount) const override
   {
-    return mIndex.Count(aItem) >= mMinCount;
+    aCount = mIndex.Count(aItem);
+    return Accepts(aCount);
+  }
+
+  bool IsCountThreshold() const override
+  {
+    return true;
+  }
+
+  bool Accepts(int aCount) const override
+  {
+    return aCount >= mMinCount;
   }
 
 private:
@@ -76,17 +124,51 @@ private:
   InvertedDataSetIndex& mIndex;
 };
 
+// log(n!) for n in [0, aMaxN], accumulated once so that the hypergeometric
+// probabilities MinAbsSup sums cost a few lookups each, rather than loops
+// of logs.
+class LogFactorialTable {
+public:
+  explicit LogFactorialTable(int aMaxN);
+
+  double Get(int n) const {
+    ASSERT(n >= 0 && (size_t)n < mTable.size());
+    return mTable[n];
+  }
+
+private:
+  std::vector<double> mTable;
+};
+
+// Returns the minimum count of AB for A and B, which have counts aA and aB
+// in aN transactions, to be considered positively correlated with
+// confidence aE. aTable must extend to aN.
+int MinAbsSup(int aA, int aB, int aN, double aE, const LogFactorialTable& aTable);
+
+// Keeps an itemset if its count exceeds the MinAbsSup of its least
+// supported item and the rest of the itemset. Filter() is called
+// concurrently by Apriori's worker threads; the thresholds are cached by
+// their counts, which many candidates share.
 class MinAbsSupFilter : public AprioriFilter {
 public:
   MinAbsSupFilter(InvertedDataSetIndex& aIndex)
     : mIndex(aIndex)
+    , mLogFactorials(aIndex.NumTransactions())
   {
   }
 
-  bool Filter(ItemSet& aItem) const override;
+  using AprioriFilter::Filter;
+  bool Filter(ItemSet& aItem, int& aCount) const override;
 
 private:
+  int GetThreshold(int aA, int aB) const;
+
   InvertedDataSetIndex& mIndex;
+  const LogFactorialTable mLogFactorials;
+  mutable std::mutex mThresholdsLock;
+  // MinAbsSup, keyed by the counts of A and B; it's symmetric in them, so
+  // the smaller count is in the high word.
+  mutable std::unordered_map<uint64_t, int> mThresholds;
 };
 
 #endif
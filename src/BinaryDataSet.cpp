@@ -0,0 +1,248 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "BinaryDataSet.h"
+#include "utils.h"
+
+#include <string.h>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+static const char kMagic[] = "HARMBIN";
+static const size_t kMagicLength = 7;
+static const uint8_t kVersion = 1;
+static const size_t kHeaderLength = kMagicLength + 1;
+static const size_t kTrailerLength = 8;
+
+static void FailCorrupt(const char* aWhat) {
+  cerr << "ERROR: Binary data set is corrupt (" << aWhat << "); failing!" << endl;
+  exit(-1);
+}
+
+static inline uint64_t ReadVarint(const uint8_t*& aPos, const uint8_t* aEnd) {
+  uint64_t value = 0;
+  unsigned shift = 0;
+  while (aPos < aEnd && shift < 64) {
+    const uint8_t byte = *aPos++;
+    value |= uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return value;
+    }
+    shift += 7;
+  }
+  FailCorrupt("truncated integer");
+  return 0;
+}
+
+static inline void WriteVarint(string& aOut, uint64_t aValue) {
+  while (aValue >= 0x80) {
+    aOut.push_back(static_cast<char>((aValue & 0x7f) | 0x80));
+    aValue >>= 7;
+  }
+  aOut.push_back(static_cast<char>(aValue));
+}
+
+BinaryDataSetReader::BinaryDataSetReader(const string& aFileName) {
+  if (!mFile.Open(aFileName)) {
+    return;
+  }
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(mFile.Data());
+  const size_t size = mFile.Size();
+  if (size < kHeaderLength + kTrailerLength ||
+      memcmp(data, kMagic, kMagicLength) != 0) {
+    FailCorrupt("bad header");
+  }
+  if (data[kMagicLength] != kVersion) {
+    cerr << "ERROR: Binary data set version " << unsigned(data[kMagicLength])
+         << " is not supported; failing!" << endl;
+    exit(-1);
+  }
+
+  const uint8_t* trailer = data + size - kTrailerLength;
+  uint64_t dictionaryOffset = 0;
+  for (unsigned i = 0; i < kTrailerLength; i++) {
+    dictionaryOffset |= uint64_t(trailer[i]) << (8 * i);
+  }
+  if (dictionaryOffset < kHeaderLength || dictionaryOffset > size - kTrailerLength) {
+    FailCorrupt("bad dictionary offset");
+  }
+
+  const uint8_t* pos = data + dictionaryOffset;
+  const uint64_t numItems = ReadVarint(pos, trailer);
+  if (numItems > uint64_t(trailer - pos)) {
+    FailCorrupt("bad item count");
+  }
+  mNames.reserve(numItems);
+  for (uint64_t i = 0; i < numItems; i++) {
+    const uint64_t length = ReadVarint(pos, trailer);
+    if (length == 0 || length > uint64_t(trailer - pos)) {
+      FailCorrupt("bad item name");
+    }
+    mNames.emplace_back(reinterpret_cast<const char*>(pos), length);
+    pos += length;
+  }
+  mFrequencies.reserve(numItems);
+  for (uint64_t i = 0; i < numItems; i++) {
+    mFrequencies.push_back(static_cast<unsigned>(ReadVarint(pos, trailer)));
+  }
+  // The trailer ends with the number of transactions, which isn't needed
+  // to read them.
+
+  mTransactionsBegin = data + kHeaderLength;
+  mTransactionsEnd = data + dictionaryOffset;
+  mCursor = mTransactionsBegin;
+}
+
+bool BinaryDataSetReader::IsBinaryDataSet(const string& aFileName) {
+  ifstream file(aFileName, ios::in | ios::binary);
+  char magic[kMagicLength];
+  if (!file.read(magic, kMagicLength)) {
+    return false;
+  }
+  return memcmp(magic, kMagic, kMagicLength) == 0;
+}
+
+bool BinaryDataSetReader::IsGood() {
+  return mTransactionsBegin != nullptr;
+}
+
+bool BinaryDataSetReader::Rewind() {
+  mCursor = mTransactionsBegin;
+  return IsGood();
+}
+
+void BinaryDataSetReader::EnsureItems() {
+  if (!mItems.empty() || mNames.empty()) {
+    return;
+  }
+  mItems.reserve(mNames.size());
+  for (const string& name : mNames) {
+    mItems.push_back(Item(name.data(), name.size()));
+  }
+}
+
+bool BinaryDataSetReader::GetNext(vector<Item>& aTransaction) {
+  aTransaction.clear();
+  if (mCursor == mTransactionsEnd) {
+    return false;
+  }
+  EnsureItems();
+  const uint64_t length = ReadVarint(mCursor, mTransactionsEnd);
+  if (length == 0 || length > uint64_t(mTransactionsEnd - mCursor)) {
+    FailCorrupt("bad transaction length");
+  }
+  aTransaction.reserve(length);
+  for (uint64_t i = 0; i < length; i++) {
+    const uint64_t index = ReadVarint(mCursor, mTransactionsEnd);
+    if (index >= mItems.size()) {
+      FailCorrupt("bad item index");
+    }
+    aTransaction.push_back(mItems[index]);
+  }
+  return true;
+}
+
+bool BinaryDataSetReader::GetItemFrequencies(ItemMap<unsigned>& aOutFrequencies) {
+  EnsureItems();
+  aOutFrequencies.Clear();
+  for (size_t i = 0; i < mItems.size(); i++) {
+    aOutFrequencies.Set(mItems[i], mFrequencies[i]);
+  }
+  return true;
+}
+
+bool WriteBinaryDataSet(DataSetReader& aReader, const string& aFileName) {
+  ofstream out(aFileName, ios::out | ios::binary | ios::trunc);
+  if (!out.is_open()) {
+    return false;
+  }
+  out.write(kMagic, kMagicLength);
+  out.put(static_cast<char>(kVersion));
+
+  // Items are numbered in the order they first appear, which is the order
+  // in which a CSV reader assigns item ids.
+  vector<uint32_t> idToIndex; // Item id to dictionary index + 1.
+  vector<Item> dictionary;
+  vector<uint64_t> frequencies;
+  uint64_t numTransactions = 0;
+  uint64_t offset = kHeaderLength;
+
+  string buffer;
+  vector<Item> transaction;
+  aReader.Rewind();
+  while (aReader.GetNext(transaction)) {
+    numTransactions++;
+    WriteVarint(buffer, transaction.size());
+    for (const Item item : transaction) {
+      const size_t id = item.GetId();
+      if (id >= idToIndex.size()) {
+        idToIndex.resize(max<size_t>(id + 1, 2 * idToIndex.size()), 0);
+      }
+      if (!idToIndex[id]) {
+        dictionary.push_back(item);
+        frequencies.push_back(0);
+        idToIndex[id] = static_cast<uint32_t>(dictionary.size());
+      }
+      const uint32_t index = idToIndex[id] - 1;
+      frequencies[index]++;
+      WriteVarint(buffer, index);
+    }
+    if (buffer.size() >= (1 << 20)) {
+      out.write(buffer.data(), buffer.size());
+      offset += buffer.size();
+      buffer.clear();
+    }
+  }
+  out.write(buffer.data(), buffer.size());
+  offset += buffer.size();
+  buffer.clear();
+
+  WriteVarint(buffer, dictionary.size());
+  for (const Item item : dictionary) {
+    const string name = item;
+    WriteVarint(buffer, name.size());
+    buffer.append(name);
+  }
+  for (const uint64_t frequency : frequencies) {
+    WriteVarint(buffer, frequency);
+  }
+  WriteVarint(buffer, numTransactions);
+  for (unsigned i = 0; i < kTrailerLength; i++) {
+    buffer.push_back(static_cast<char>((offset >> (8 * i)) & 0xff));
+  }
+  out.write(buffer.data(), buffer.size());
+  out.close();
+  return out.good();
+}
+
+void ConvertDataSet(Options& options) {
+  DurationTimer timer;
+  Item::ResetBaseId();
+  DataSetReader reader(options.inputFileName);
+  if (!reader.IsGood()) {
+    cerr << "ERROR: Can't read input;failing!" << endl;
+    return;
+  }
+  const string outputFileName =
+    GetOutputBinaryDataSetFileName(options.outputFilePrefix);
+  Log("Converting %s to binary data set %s\n",
+      options.inputFileName.c_str(), outputFileName.c_str());
+  if (!WriteBinaryDataSet(reader, outputFileName)) {
+    cerr << "ERROR: Failed to write binary data set " << outputFileName << endl;
+    return;
+  }
+  Log("Converted data set in %.3lfs\n", timer.Seconds());
+}
@@ -0,0 +1,80 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "DataSetReader.h"
+#include "Item.h"
+#include "ItemMap.h"
+#include "MappedFile.h"
+#include "Options.h"
+
+// Binary data set format, written by "-m convert". Loading a binary data
+// set skips parsing text and interning item names for every transaction.
+//
+// Layout, all integers are LEB128 varints unless noted:
+//   "HARMBIN" magic, then a one byte format version.
+//   Transactions; each is its item count then its items' dictionary
+//   indices, in the order the items appeared in the source transaction.
+//   Dictionary; the item count, then each item's name as its length and
+//   bytes, in the order the items first appeared in the data set. Then each
+//   item's frequency, then the number of transactions.
+//   Trailer; the file offset of the dictionary as a little endian uint64.
+//
+// Items are interned in dictionary order, so they're assigned the same ids
+// as they would be when the source CSV file is read.
+class BinaryDataSetReader : public DataSetReader {
+public:
+  explicit BinaryDataSetReader(const std::string& aFileName);
+
+  bool IsGood() override;
+
+  bool Rewind() override;
+
+  bool GetNext(std::vector<Item>& aTransaction) override;
+
+  bool GetItemFrequencies(ItemMap<unsigned>& aOutFrequencies) override;
+
+  // Returns true if |aFileName| starts with the binary data set magic.
+  static bool IsBinaryDataSet(const std::string& aFileName);
+
+private:
+  // Interns the dictionary's names. This is deferred until the data set is
+  // first read, as the data set that reads us resets the item ids when it
+  // is constructed, and that happens after we are.
+  void EnsureItems();
+
+  MappedFile mFile;
+  const uint8_t* mTransactionsBegin = nullptr;
+  const uint8_t* mTransactionsEnd = nullptr;
+  const uint8_t* mCursor = nullptr;
+
+  // Names and frequencies of the items, in dictionary order.
+  std::vector<std::string> mNames;
+  std::vector<unsigned> mFrequencies;
+
+  // Maps dictionary index to interned item. Empty until EnsureItems().
+  std::vector<Item> mItems;
+};
+
+// Writes the transactions read by |aReader| to |aFileName| in the binary
+// data set format. Returns false on failure to write the file.
+bool WriteBinaryDataSet(DataSetReader& aReader, const std::string& aFileName);
+
+// Converts the input data set to the binary format, for "-m convert".
+void ConvertDataSet(Options& options);
@@ -0,0 +1,236 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "BitmapKernels.h"
+#include "debug.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// The SIMD kernels are compiled with per function target attributes, so the
+// rest of the program doesn't need to be built for a particular CPU.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HARM_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+uint64_t* AllocateBitmapWords(size_t aNumWords) {
+  const size_t size = max<size_t>(aNumWords, 1) * sizeof(uint64_t);
+  void* words = nullptr;
+#ifdef _WIN32
+  words = _aligned_malloc(size, kBitmapRowAlignment);
+#else
+  if (posix_memalign(&words, kBitmapRowAlignment, size) != 0) {
+    words = nullptr;
+  }
+#endif
+  if (!words) {
+    throw bad_alloc();
+  }
+  memset(words, 0, size);
+  return static_cast<uint64_t*>(words);
+}
+
+void FreeBitmapWords(uint64_t* aWords) {
+#ifdef _WIN32
+  _aligned_free(aWords);
+#else
+  free(aWords);
+#endif
+}
+
+static uint64_t AndPopCountScalar(const uint64_t* const* aRows,
+                                  unsigned aNumRows,
+                                  size_t aNumWords) {
+  uint64_t count = 0;
+  for (size_t w = 0; w < aNumWords; w++) {
+    uint64_t word = aRows[0][w];
+    for (unsigned r = 1; r < aNumRows && word; r++) {
+      word &= aRows[r][w];
+    }
+    count += PopCount64(word);
+  }
+  return count;
+}
+
+#ifdef HARM_X86_KERNELS
+
+__attribute__((target("popcnt")))
+static uint64_t AndPopCountPopcnt(const uint64_t* const* aRows,
+                                  unsigned aNumRows,
+                                  size_t aNumWords) {
+  uint64_t count = 0;
+  for (size_t w = 0; w < aNumWords; w++) {
+    uint64_t word = aRows[0][w];
+    for (unsigned r = 1; r < aNumRows; r++) {
+      word &= aRows[r][w];
+    }
+    count += __builtin_popcountll(word);
+  }
+  return count;
+}
+
+// Counts the bits in each byte with a nibble lookup table, then sums the
+// byte counts into the four 64 bit lanes.
+__attribute__((target("avx2")))
+static inline __m256i PopCount256(__m256i aValue) {
+  const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+                                          1, 2, 2, 3, 2, 3, 3, 4,
+                                          0, 1, 1, 2, 1, 2, 2, 3,
+                                          1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i lowNibbles = _mm256_set1_epi8(0x0f);
+  const __m256i low = _mm256_and_si256(aValue, lowNibbles);
+  const __m256i high = _mm256_and_si256(_mm256_srli_epi16(aValue, 4), lowNibbles);
+  const __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low),
+                                         _mm256_shuffle_epi8(lookup, high));
+  return _mm256_sad_epu8(counts, _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2")))
+static uint64_t AndPopCountAVX2(const uint64_t* const* aRows,
+                                unsigned aNumRows,
+                                size_t aNumWords) {
+  __m256i total = _mm256_setzero_si256();
+  for (size_t w = 0; w < aNumWords; w += kBitmapBlockWords) {
+    __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(aRows[0] + w));
+    __m256i b = _mm256_load_si256(reinterpret_cast<const __m256i*>(aRows[0] + w + 4));
+    for (unsigned r = 1; r < aNumRows; r++) {
+      a = _mm256_and_si256(a, _mm256_load_si256(reinterpret_cast<const __m256i*>(aRows[r] + w)));
+      b = _mm256_and_si256(b, _mm256_load_si256(reinterpret_cast<const __m256i*>(aRows[r] + w + 4)));
+    }
+    total = _mm256_add_epi64(total, PopCount256(a));
+    total = _mm256_add_epi64(total, PopCount256(b));
+  }
+  uint64_t lanes[4];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), total);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq")))
+static uint64_t AndPopCountAVX512(const uint64_t* const* aRows,
+                                  unsigned aNumRows,
+                                  size_t aNumWords) {
+  __m512i total = _mm512_setzero_si512();
+  for (size_t w = 0; w < aNumWords; w += kBitmapBlockWords) {
+    __m512i block = _mm512_load_si512(aRows[0] + w);
+    for (unsigned r = 1; r < aNumRows; r++) {
+      block = _mm512_and_si512(block, _mm512_load_si512(aRows[r] + w));
+    }
+    total = _mm512_add_epi64(total, _mm512_popcnt_epi64(block));
+  }
+  uint64_t lanes[8];
+  _mm512_storeu_si512(lanes, total);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+         lanes[4] + lanes[5] + lanes[6] + lanes[7];
+}
+
+#endif // HARM_X86_KERNELS
+
+typedef uint64_t (*AndPopCountFn)(const uint64_t* const*, unsigned, size_t);
+
+static AndPopCountFn GetKernelFunction(eBitmapKernel aKernel) {
+  switch (aKernel) {
+    case kBitmapScalar:
+      return AndPopCountScalar;
+#ifdef HARM_X86_KERNELS
+    case kBitmapPopcnt:
+      return AndPopCountPopcnt;
+    case kBitmapAVX2:
+      return AndPopCountAVX2;
+    case kBitmapAVX512:
+      return AndPopCountAVX512;
+#endif
+    default:
+      return nullptr;
+  }
+}
+
+bool IsBitmapKernelSupported(eBitmapKernel aKernel) {
+  switch (aKernel) {
+    case kBitmapScalar:
+      return true;
+#ifdef HARM_X86_KERNELS
+    case kBitmapPopcnt:
+      return __builtin_cpu_supports("popcnt");
+    case kBitmapAVX2:
+      return __builtin_cpu_supports("avx2");
+    case kBitmapAVX512:
+      return __builtin_cpu_supports("avx512f") &&
+             __builtin_cpu_supports("avx512vpopcntdq");
+#endif
+    default:
+      return false;
+  }
+}
+
+const char* GetBitmapKernelName(eBitmapKernel aKernel) {
+  switch (aKernel) {
+    case kBitmapScalar:
+      return "scalar";
+    case kBitmapPopcnt:
+      return "popcnt";
+    case kBitmapAVX2:
+      return "avx2";
+    case kBitmapAVX512:
+      return "avx512";
+  }
+  return "unknown";
+}
+
+static eBitmapKernel SelectBestKernel() {
+#ifdef HARM_X86_KERNELS
+  // We may run before the constructor which initializes the CPU feature
+  // data used by __builtin_cpu_supports().
+  __builtin_cpu_init();
+#endif
+  const eBitmapKernel preferred[] = {kBitmapAVX512, kBitmapAVX2, kBitmapPopcnt};
+  for (const eBitmapKernel kernel : preferred) {
+    if (IsBitmapKernelSupported(kernel)) {
+      return kernel;
+    }
+  }
+  return kBitmapScalar;
+}
+
+static eBitmapKernel sKernel = SelectBestKernel();
+static AndPopCountFn sAndPopCount = GetKernelFunction(sKernel);
+
+bool SetBitmapKernel(eBitmapKernel aKernel) {
+  if (!IsBitmapKernelSupported(aKernel)) {
+    return false;
+  }
+  sKernel = aKernel;
+  sAndPopCount = GetKernelFunction(aKernel);
+  return true;
+}
+
+eBitmapKernel GetBitmapKernel() {
+  return sKernel;
+}
+
+uint64_t AndPopCount(const uint64_t* const* aRows,
+                     unsigned aNumRows,
+                     size_t aNumWords) {
+  ASSERT(aNumRows > 0);
+  ASSERT(aNumWords % kBitmapBlockWords == 0);
+  return sAndPopCount(aRows, aNumRows, aNumWords);
+}
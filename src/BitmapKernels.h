@@ -0,0 +1,73 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bitmap rows used by the kernels below are arrays of 64 bit words, aligned
+// to kBitmapRowAlignment bytes, and a multiple of kBitmapBlockWords words
+// long, so the kernels can process whole 512 bit blocks with aligned loads.
+static const size_t kBitmapRowAlignment = 64;
+static const size_t kBitmapBlockWords = 8;
+
+// Returns the number of words in a row which holds |aNumBits| bits.
+inline size_t BitmapRowWords(size_t aNumBits) {
+  const size_t words = (aNumBits + 63) / 64;
+  return (words + kBitmapBlockWords - 1) / kBitmapBlockWords * kBitmapBlockWords;
+}
+
+// Allocates zeroed, suitably aligned storage for |aNumWords| words.
+uint64_t* AllocateBitmapWords(size_t aNumWords);
+void FreeBitmapWords(uint64_t* aWords);
+
+// Deleter for std::unique_ptr<uint64_t[]> holding AllocateBitmapWords()
+// storage.
+struct BitmapWordsDeleter {
+  void operator()(uint64_t* aWords) const {
+    FreeBitmapWords(aWords);
+  }
+};
+
+inline uint64_t PopCount64(uint64_t x) {
+  x = x - ((x >> 1) & 0x5555555555555555ull);
+  x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+  x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+  return (x * 0x0101010101010101ull) >> 56;
+}
+
+enum eBitmapKernel {
+  kBitmapScalar, // Portable C++.
+  kBitmapPopcnt, // x86 POPCNT instruction.
+  kBitmapAVX2,
+  kBitmapAVX512, // AVX-512F with VPOPCNTDQ.
+};
+
+const char* GetBitmapKernelName(eBitmapKernel aKernel);
+
+// Returns true if the CPU we're running on supports |aKernel|.
+bool IsBitmapKernelSupported(eBitmapKernel aKernel);
+
+// The fastest kernel the CPU supports is selected on startup. This overrides
+// that choice; used to compare kernels. Returns false if |aKernel| isn't
+// supported, in which case the selected kernel is unchanged.
+bool SetBitmapKernel(eBitmapKernel aKernel);
+eBitmapKernel GetBitmapKernel();
+
+// Returns the number of bits set in the bitwise AND of the |aNumRows| rows,
+// each |aNumWords| words long. |aNumRows| must be at least 1.
+uint64_t AndPopCount(const uint64_t* const* aRows,
+                     unsigned aNumRows,
+                     size_t aNumWords);
@@ -0,0 +1,70 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CFITree.h"
+#include "debug.h"
+
+#include <algorithm>
+
+using namespace std;
+
+CFITree::CFITree(unsigned aNumRanks)
+  : mHeads(aNumRanks, kNone) {
+  Node root = {kNone, kNone, -1, 0, 0};
+  mNodes.push_back(root);
+}
+
+void CFITree::Insert(const int* aRanks, size_t aNumRanks, int aCount) {
+  uint32_t node = kRoot;
+  for (size_t i = 0; i < aNumRanks; i++) {
+    ASSERT(i == 0 || aRanks[i - 1] < aRanks[i]);
+    ASSERT((size_t)aRanks[i] < mHeads.size());
+    const uint32_t next = (uint32_t)mNodes.size();
+    auto result = mEdges.emplace(EdgeKey(node, aRanks[i]), next);
+    if (result.second) {
+      Node child = {node, mHeads[aRanks[i]], aRanks[i], aCount, (uint32_t)i + 1};
+      mHeads[aRanks[i]] = next;
+      mNodes.push_back(child);
+    }
+    node = result.first->second;
+    mNodes[node].count = max(mNodes[node].count, aCount);
+  }
+}
+
+bool CFITree::HasSuperset(const int* aRanks, size_t aNumRanks, int aMinCount) const {
+  if (!aNumRanks) {
+    return mNodes.size() > 1;
+  }
+  for (uint32_t node = mHeads[aRanks[aNumRanks - 1]]; node != kNone; node = mNodes[node].next) {
+    const Node& last = mNodes[node];
+    if (last.count < aMinCount || last.depth < aNumRanks) {
+      continue;
+    }
+    // Match the remaining ranks against the node's ancestors, which have
+    // decreasing ranks.
+    size_t remaining = aNumRanks - 1;
+    for (uint32_t p = last.parent; remaining > 0 && p != kRoot; p = mNodes[p].parent) {
+      const int rank = mNodes[p].rank;
+      if (rank == aRanks[remaining - 1]) {
+        remaining--;
+      } else if (rank < aRanks[remaining - 1] || mNodes[p].depth < remaining) {
+        break;
+      }
+    }
+    if (!remaining) {
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,68 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+// Stores the closed (CFI) or maximal (MFI) frequent itemsets found so far
+// by FPClose and FPMax, and answers whether a candidate is a subset of one
+// of them, after Grahne and Zhu's CFI-tree and MFI-tree.
+//
+// Itemsets are stored as paths of item ranks, in increasing rank order,
+// like an FP-tree. Each node records the largest count of the itemsets
+// passing through it, and the nodes of each rank are linked in a chain,
+// so a subset check only visits the nodes of the candidate's last item.
+class CFITree {
+public:
+  // Item ranks must be less than aNumRanks.
+  explicit CFITree(unsigned aNumRanks);
+
+  // Adds the itemset of the aNumRanks ranks in increasing order.
+  void Insert(const int* aRanks, size_t aNumRanks, int aCount);
+
+  // Returns true if an itemset with count at least aMinCount which is a
+  // superset of (or equal to) the aNumRanks ranks in increasing order has
+  // been inserted.
+  bool HasSuperset(const int* aRanks, size_t aNumRanks, int aMinCount) const;
+
+  size_t NumNodes() const {
+    return mNodes.size();
+  }
+
+private:
+  static const uint32_t kRoot = 0;
+  static const uint32_t kNone = 0xffffffff;
+
+  struct Node {
+    uint32_t parent;
+    // Next node with the same rank.
+    uint32_t next;
+    int rank;
+    int count;
+    uint32_t depth;
+  };
+
+  static uint64_t EdgeKey(uint32_t aParent, int aRank) {
+    return (uint64_t(aParent) << 32) | uint32_t(aRank);
+  }
+
+  std::vector<Node> mNodes;
+  std::unordered_map<uint64_t, uint32_t> mEdges;
+  // First node of each rank's chain.
+  std::vector<uint32_t> mHeads;
+};
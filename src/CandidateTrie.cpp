@@ -0,0 +1,104 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CandidateTrie.h"
+#include "debug.h"
+
+#include <algorithm>
+
+using namespace std;
+
+CandidateTrie::CandidateTrie(const int* aIds, size_t aNumCandidates,
+                             unsigned aItemSetSize)
+  : mItemSetSize(aItemSetSize),
+    mNumRootChildren(0) {
+  ASSERT(aItemSetSize > 0);
+  uint32_t first = 0;
+  if (aNumCandidates) {
+    AddChildren(aIds, 0, aNumCandidates, 0, first, mNumRootChildren);
+  }
+  ASSERT(first == 0);
+}
+
+void CandidateTrie::AddChildren(const int* aIds, size_t aBegin, size_t aEnd,
+                                unsigned aDepth, uint32_t& aFirst,
+                                uint32_t& aNumChildren) {
+  // The rows with each distinct item in this column are adjacent.
+  vector<size_t> groups;
+  for (size_t row = aBegin; row < aEnd; row++) {
+    if (row == aBegin ||
+        aIds[row * mItemSetSize + aDepth] != aIds[(row - 1) * mItemSetSize + aDepth]) {
+      groups.push_back(row);
+    }
+  }
+  groups.push_back(aEnd);
+
+  aFirst = (uint32_t)mNodes.size();
+  aNumChildren = (uint32_t)groups.size() - 1;
+  for (uint32_t i = 0; i < aNumChildren; i++) {
+    Node node = {aIds[groups[i] * mItemSetSize + aDepth], 0, 0};
+    mNodes.push_back(node);
+  }
+  for (uint32_t i = 0; i < aNumChildren; i++) {
+    if (aDepth + 1 == mItemSetSize) {
+      // Rows are distinct, so each leaf is one candidate.
+      ASSERT(groups[i + 1] - groups[i] == 1);
+      mNodes[aFirst + i].first = (uint32_t)groups[i];
+      continue;
+    }
+    uint32_t first;
+    uint32_t numChildren;
+    AddChildren(aIds, groups[i], groups[i + 1], aDepth + 1, first, numChildren);
+    mNodes[aFirst + i].first = first;
+    mNodes[aFirst + i].numChildren = numChildren;
+  }
+}
+
+void CandidateTrie::Count(uint32_t aFirst, uint32_t aNumChildren,
+                          unsigned aDepth, const int* aTransaction,
+                          size_t aLength, int* aCounts) const {
+  // Items needed to complete a candidate, including this one.
+  const size_t needed = mItemSetSize - aDepth + 1;
+  if (aLength < needed) {
+    return;
+  }
+  const Node* child = mNodes.data() + aFirst;
+  const Node* end = child + aNumChildren;
+  // The last items of the transaction can't start a candidate.
+  const size_t last = aLength - needed;
+  const bool search = aNumChildren > 4 * (last + 1);
+  for (size_t i = 0; i <= last && child != end; i++) {
+    const int item = aTransaction[i];
+    if (search) {
+      // Many more children than items; look each item up.
+      child = lower_bound(child, end, item, [](const Node& aNode, int aItem) {
+        return aNode.item < aItem;
+      });
+    } else {
+      while (child != end && child->item < item) {
+        child++;
+      }
+    }
+    if (child == end || child->item != item) {
+      continue;
+    }
+    if (aDepth == mItemSetSize) {
+      aCounts[child->first]++;
+    } else {
+      Count(child->first, child->numChildren, aDepth + 1,
+            aTransaction + i + 1, aLength - i - 1, aCounts);
+    }
+    child++;
+  }
+}
@@ -0,0 +1,64 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Counts how many transactions contain each of a set of candidate itemsets
+// of the same size, one transaction at a time. This lets Apriori count a
+// whole generation of candidates in one pass over the data set, rather
+// than intersecting the items' transaction lists for each candidate.
+//
+// Candidates are stored in a prefix trie, whose nodes are laid out so that
+// each node's children are adjacent and sorted by item id. A transaction is
+// counted by walking down the trie, following only the children whose items
+// are in the remainder of the transaction.
+class CandidateTrie {
+public:
+  // aIds holds aNumCandidates rows of aItemSetSize item ids. Each row must
+  // be in increasing order, and the rows in lexicographic order.
+  CandidateTrie(const int* aIds, size_t aNumCandidates, unsigned aItemSetSize);
+
+  // Adds one to aCounts[c] for each candidate c contained in the
+  // transaction of aLength item ids, in increasing order.
+  void Count(const int* aTransaction, size_t aLength, int* aCounts) const {
+    Count(0, mNumRootChildren, 1, aTransaction, aLength, aCounts);
+  }
+
+private:
+  struct Node {
+    int item;
+    // Index of the node's first child, or for leaves, the candidate's index.
+    uint32_t first;
+    uint32_t numChildren;
+  };
+
+  // Adds adjacent nodes for the distinct items in column aDepth of rows
+  // [aBegin,aEnd), then their descendants. Sets aFirst and aNumChildren to
+  // the range of nodes added for the column.
+  void AddChildren(const int* aIds, size_t aBegin, size_t aEnd,
+                   unsigned aDepth, uint32_t& aFirst, uint32_t& aNumChildren);
+
+  // Counts the candidates at or below the nodes [aFirst, aFirst +
+  // aNumChildren), which hold the aDepth'th item of candidates, starting at 1.
+  void Count(uint32_t aFirst, uint32_t aNumChildren, unsigned aDepth,
+             const int* aTransaction, size_t aLength, int* aCounts) const;
+
+  std::vector<Node> mNodes;
+  unsigned mItemSetSize;
+  uint32_t mNumRootChildren;
+};
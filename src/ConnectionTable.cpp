@@ -49,7 +49,7 @@ void ConnectionTable::createTable(FPNode* root) {
     // a new item otherwise, just add new children if there is any.
     if (!cl.Contains(node->item)) {
       addNewNode(node);
-    } else if (node->children.size() > 0) {
+    } else if (node->children.Size() > 0) {
       // Note: this copies! Maybe ConnectionList should map to pointers
       // to child lists!!
       ChildList childList(cl.Get(node->item));
@@ -69,12 +69,12 @@ void ConnectionTable::addNewNode(FPNode* node) {
   children.Clear();
   // go through the node's chilren and add them to an item map. For every children, add its children to an
   // nextItems.
-  for (std::map<Item, FPNode*>::iterator childIter = node->children.begin(); childIter != node->children.end(); childIter++) {
+  for (FPNode* child : node->SortedChildren()) {
     nextItems.Clear();
-    for (std::map<Item, FPNode*>::iterator nextIter = childIter->second->children.begin(); nextIter != childIter->second->children.end(); nextIter++) {
-      nextItems += nextIter->first;
+    for (FPNode* next : child->SortedChildren()) {
+      nextItems += next->item;
     }
-    children.Set(childIter->first, Child(nextItems, childIter->second->count));
+    children.Set(child->item, Child(nextItems, child->count));
   }
 
   // we cant put an item with ID 0 in ItemMap, so we do not keep the root in the connection list.
@@ -90,8 +90,8 @@ void ConnectionTable::addNewNode(FPNode* node) {
 }
 
 void ConnectionTable::addChildrenToQueue(FPNode* node, queue<FPNode*>& q) {
-  for (std::map<Item, FPNode*>::iterator childIter = node->children.begin(); childIter != node->children.end(); childIter++) {
-    q.push(childIter->second);
+  for (FPNode* child : node->SortedChildren()) {
+    q.push(child);
   }
 }
 
@@ -99,15 +99,15 @@ void ConnectionTable::addToChildren(ChildList& children, FPNode* node) {
   ItemList nextItems;
 
   // loop through the node's children and add them new children to the list of there is any.
-  for (std::map<Item, FPNode*>::iterator childIter = node->children.begin(); childIter != node->children.end(); childIter++) {
+  for (FPNode* child : node->SortedChildren()) {
     nextItems.Clear();
-    if (children.Contains(childIter->first)) {
-      nextItems = children.Get(childIter->first).nextItems;
+    if (children.Contains(child->item)) {
+      nextItems = children.Get(child->item).nextItems;
     }
-    for (std::map<Item, FPNode*>::iterator nextIter = childIter->second->children.begin(); nextIter != childIter->second->children.end(); nextIter++) {
-      nextItems += nextIter->first;
+    for (FPNode* next : child->SortedChildren()) {
+      nextItems += next->item;
     }
-    children.Set(childIter->first, Child(nextItems, childIter->second->count));
+    children.Set(child->item, Child(nextItems, child->count));
   }
   cl.Set(node->item, children);
 }
@@ -0,0 +1,199 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CountCache.h"
+#include "ItemSet.h"
+#include "debug.h"
+
+#include <string.h>
+#include <algorithm>
+
+using namespace std;
+
+// Expected pool space per entry; its item count plus a few ids.
+static const uint32_t kExpectedIdsPerEntry = 5;
+
+CountCache::Key::Key(const ItemSet& aItemSet)
+  : mHash(aItemSet.Hash()),
+    mNumIds((uint32_t)aItemSet.Size()) {
+  uint32_t* ids = mInline;
+  if (mNumIds > kInlineIds) {
+    mHeap.resize(mNumIds);
+    ids = mHeap.data();
+  }
+  uint32_t n = 0;
+  for (const Item item : aItemSet.mItems) {
+    ids[n++] = item.GetId();
+  }
+  // Items are stored in the current Item comparison order, which may not
+  // be id order.
+  sort(ids, ids + n);
+}
+
+void CountCache::Table::Clear() {
+  if (numEntries) {
+    for (Slot& slot : slots) {
+      slot.idsOffset = kEmptySlot;
+    }
+  }
+  ids.clear();
+  numEntries = 0;
+}
+
+CountCache::CountCache(size_t aMaxBytes)
+  : mGeneration(0) {
+  // The current and previous tables together may use twice a table's
+  // share. A table is kept at most half full, so each entry costs two
+  // slots and its share of the id pool. The slot count is the largest
+  // power of two which fits, and the id pool gets the rest of the share.
+  const size_t tableBytes = aMaxBytes / kNumShards / 2;
+  const size_t bytesPerSlot = sizeof(Slot) + kExpectedIdsPerEntry * sizeof(uint32_t) / 2;
+  mSlotsPerTable = 2;
+  while (2 * mSlotsPerTable * bytesPerSlot <= tableBytes) {
+    mSlotsPerTable *= 2;
+  }
+  mMaxEntriesPerTable = mSlotsPerTable / 2;
+  const size_t slotBytes = mSlotsPerTable * sizeof(Slot);
+  mMaxIdsPerTable = (uint32_t)max<size_t>(
+    (tableBytes > slotBytes ? tableBytes - slotBytes : 0) / sizeof(uint32_t),
+    1 + kExpectedIdsPerEntry);
+}
+
+uint64_t CountCache::Hits() const {
+  uint64_t hits = 0;
+  for (Shard& shard : mShards) {
+    lock_guard<mutex> lock(shard.lock);
+    hits += shard.hits;
+  }
+  return hits;
+}
+
+uint64_t CountCache::Misses() const {
+  uint64_t misses = 0;
+  for (Shard& shard : mShards) {
+    lock_guard<mutex> lock(shard.lock);
+    misses += shard.misses;
+  }
+  return misses;
+}
+
+size_t CountCache::MemoryUsage() const {
+  size_t bytes = 0;
+  for (Shard& shard : mShards) {
+    lock_guard<mutex> lock(shard.lock);
+    for (const Table* table : {&shard.current, &shard.previous}) {
+      bytes += table->slots.capacity() * sizeof(Slot) +
+               table->ids.capacity() * sizeof(uint32_t);
+    }
+  }
+  return bytes;
+}
+
+void CountCache::ValidateShard(Shard& aShard) {
+  const uint64_t generation = mGeneration;
+  if (aShard.generation == generation) {
+    return;
+  }
+  aShard.current.Clear();
+  aShard.previous.Clear();
+  aShard.generation = generation;
+}
+
+CountCache::Slot* CountCache::Find(Table& aTable, const Key& aKey) {
+  if (!aTable.numEntries) {
+    return nullptr;
+  }
+  const uint32_t mask = (uint32_t)aTable.slots.size() - 1;
+  // The top bits pick the shard, so probe from the low bits.
+  for (uint32_t i = (uint32_t)aKey.Hash() & mask; ; i = (i + 1) & mask) {
+    Slot& slot = aTable.slots[i];
+    if (slot.idsOffset == kEmptySlot) {
+      return nullptr;
+    }
+    if (slot.hash != aKey.Hash()) {
+      continue;
+    }
+    const uint32_t* ids = aTable.ids.data() + slot.idsOffset;
+    if (ids[0] == aKey.NumIds() &&
+        memcmp(ids + 1, aKey.Ids(), aKey.NumIds() * sizeof(uint32_t)) == 0) {
+      return &slot;
+    }
+  }
+}
+
+void CountCache::InsertEntry(Shard& aShard, const Key& aKey, int aCount) {
+  if (1 + aKey.NumIds() > mMaxIdsPerTable) {
+    // Too large for the id pool.
+    return;
+  }
+  Table* table = &aShard.current;
+  if (table->numEntries >= mMaxEntriesPerTable ||
+      table->ids.size() + 1 + aKey.NumIds() > mMaxIdsPerTable) {
+    // Full; the current entries become the previous entries.
+    swap(aShard.current, aShard.previous);
+    table->Clear();
+  }
+  if (table->slots.empty()) {
+    Slot empty = {0, 0, kEmptySlot};
+    table->slots.assign(mSlotsPerTable, empty);
+    table->ids.reserve(mMaxIdsPerTable);
+  }
+  const uint32_t mask = (uint32_t)table->slots.size() - 1;
+  uint32_t i = (uint32_t)aKey.Hash() & mask;
+  while (table->slots[i].idsOffset != kEmptySlot) {
+    i = (i + 1) & mask;
+  }
+  Slot& slot = table->slots[i];
+  slot.hash = aKey.Hash();
+  slot.count = aCount;
+  slot.idsOffset = (uint32_t)table->ids.size();
+  table->ids.push_back(aKey.NumIds());
+  table->ids.insert(table->ids.end(), aKey.Ids(), aKey.Ids() + aKey.NumIds());
+  table->numEntries++;
+}
+
+bool CountCache::Lookup(const Key& aKey, int& aCount) {
+  Shard& shard = GetShard(aKey);
+  lock_guard<mutex> lock(shard.lock);
+  ValidateShard(shard);
+  const Slot* slot = Find(shard.current, aKey);
+  if (slot) {
+    aCount = slot->count;
+    shard.hits++;
+    return true;
+  }
+  slot = Find(shard.previous, aKey);
+  if (slot) {
+    aCount = slot->count;
+    // Still in use; keep it when the previous table is dropped.
+    InsertEntry(shard, aKey, aCount);
+    shard.hits++;
+    return true;
+  }
+  shard.misses++;
+  return false;
+}
+
+void CountCache::Insert(const Key& aKey, int aCount) {
+  Shard& shard = GetShard(aKey);
+  lock_guard<mutex> lock(shard.lock);
+  ValidateShard(shard);
+  Slot* slot = Find(shard.current, aKey);
+  if (slot) {
+    // Another thread counted it first.
+    slot->count = aCount;
+    return;
+  }
+  InsertEntry(shard, aKey, aCount);
+}
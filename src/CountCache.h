@@ -0,0 +1,132 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+class ItemSet;
+
+// Memoizes DataSet::Count(ItemSet) results. Rule generation and the Apriori
+// filters count the same antecedents and consequents over and over, and
+// each count is an intersection of the items' tid lists.
+//
+// Entries are spread over shards by the itemset's hash, each with its own
+// lock, so concurrent counters rarely contend. A shard stores entries in
+// flat open addressing tables, with the entries' item ids packed into a
+// pool alongside, so a lookup touches few cache lines. Each shard holds at
+// most its share of the memory budget; when a shard's current table fills
+// up it becomes the shard's previous table, and the old previous table is
+// dropped. Hits in the previous table are copied back to the current
+// table, so recently used counts survive.
+//
+// Invalidate() discards every entry in O(1) by bumping a generation
+// number; shards drop their stale tables the next time they're used.
+// Windowed data sets call it whenever their window moves.
+class CountCache {
+public:
+  explicit CountCache(size_t aMaxBytes);
+
+  // Canonical form of an itemset, used as the cache key.
+  class Key {
+  public:
+    explicit Key(const ItemSet& aItemSet);
+    uint64_t Hash() const {
+      return mHash;
+    }
+    // Sorted item ids.
+    const uint32_t* Ids() const {
+      return mNumIds <= kInlineIds ? mInline : mHeap.data();
+    }
+    uint32_t NumIds() const {
+      return mNumIds;
+    }
+  private:
+    static const uint32_t kInlineIds = 16;
+    uint64_t mHash;
+    uint32_t mNumIds;
+    uint32_t mInline[kInlineIds];
+    std::vector<uint32_t> mHeap;
+  };
+
+  // Returns true and sets aCount if aKey's count is cached.
+  bool Lookup(const Key& aKey, int& aCount);
+  void Insert(const Key& aKey, int aCount);
+
+  void Invalidate() {
+    mGeneration++;
+  }
+
+  uint64_t Hits() const;
+  uint64_t Misses() const;
+
+  // Memory used by entries, in bytes. At most the budget passed to the
+  // constructor, unless that's too small to hold a few entries per shard.
+  size_t MemoryUsage() const;
+
+private:
+  struct Slot {
+    uint64_t hash;
+    int32_t count;
+    // Offset of the entry's ids in the table's id pool; kEmptySlot if the
+    // slot is unused.
+    uint32_t idsOffset;
+  };
+
+  static const uint32_t kEmptySlot = 0xffffffff;
+
+  struct Table {
+    std::vector<Slot> slots;
+    std::vector<uint32_t> ids;
+    uint32_t numEntries = 0;
+    void Clear();
+  };
+
+  struct Shard {
+    std::mutex lock;
+    Table current;
+    Table previous;
+    uint64_t generation = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+  };
+
+  static const unsigned kNumShards = 32;
+
+  Shard& GetShard(const Key& aKey) {
+    return mShards[aKey.Hash() >> 59];
+  }
+
+  // Drops the shard's tables if they were filled before the last
+  // Invalidate(). Shard lock must be held.
+  void ValidateShard(Shard& aShard);
+
+  // Returns the slot holding aKey in aTable, or nullptr.
+  static Slot* Find(Table& aTable, const Key& aKey);
+
+  // Adds an entry to the shard's current table, rotating the tables if
+  // it's full. Shard lock must be held.
+  void InsertEntry(Shard& aShard, const Key& aKey, int aCount);
+
+  mutable Shard mShards[kNumShards];
+  // Entries and id pool capacity in each of a shard's tables.
+  uint32_t mSlotsPerTable;
+  uint32_t mMaxEntriesPerTable;
+  uint32_t mMaxIdsPerTable;
+  std::atomic<uint64_t> mGeneration;
+};
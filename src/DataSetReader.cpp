@@ -0,0 +1,144 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "DataSetReader.h"
+#include "BinaryDataSet.h"
+#include "PipelinedDataSetReader.h"
+
+#include <string.h>
+
+using namespace std;
+
+static inline bool IsWhiteSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+DataSetReader::DataSetReader(unique_ptr<istream> aInput)
+  : mInput(move(aInput))
+{
+}
+
+DataSetReader::DataSetReader(const string& aFileName)
+{
+  if (mFile.Open(aFileName)) {
+    mCursor = mFile.Data();
+  }
+}
+
+bool DataSetReader::IsGood() {
+  return mInput ? mInput->good() : mFile.IsOpen();
+}
+
+bool DataSetReader::Rewind() {
+  mLineNumber = 0;
+  if (!mInput) {
+    mCursor = mFile.Data();
+    return IsGood();
+  }
+  mInput->clear(); // Clear EOF flag if necessary.
+  mInput->seekg(std::istream::beg);
+  return IsGood();
+}
+
+bool DataSetReader::GetNext(vector<Item>& aTransaction) {
+  aTransaction.clear();
+  aTransaction.reserve(20);
+  const char* begin = nullptr;
+  const char* end = nullptr;
+  if (mInput) {
+    if (!getline(*mInput, mLine)) {
+      return false;
+    }
+    begin = mLine.data();
+    end = begin + mLine.size();
+  } else {
+    const char* fileEnd = mFile.Data() + mFile.Size();
+    if (!mCursor || mCursor == fileEnd) {
+      return false;
+    }
+    begin = mCursor;
+    const char* newline =
+      static_cast<const char*>(memchr(begin, '\n', fileEnd - begin));
+    end = newline ? newline : fileEnd;
+    mCursor = newline ? newline + 1 : fileEnd;
+  }
+  ++mLineNumber;
+  ParseLine(begin, end, aTransaction);
+  return true;
+}
+
+void DataSetReader::ParseLine(const char* aBegin,
+                              const char* aEnd,
+                              vector<Item>& aTransaction) {
+  ++mTransactionNumber;
+  bool haveToken = false;
+  const char* pos = aBegin;
+  while (pos < aEnd) {
+    const char* comma = static_cast<const char*>(memchr(pos, ',', aEnd - pos));
+    const char* tokenEnd = comma ? comma : aEnd;
+    // Like Tokenize(), adjacent delimiters don't make an empty token.
+    if (tokenEnd != pos) {
+      haveToken = true;
+      const char* first = pos;
+      const char* last = tokenEnd;
+      while (first < last && IsWhiteSpace(*first)) {
+        first++;
+      }
+      while (last > first && IsWhiteSpace(*(last - 1))) {
+        last--;
+      }
+      if (first == last) {
+        std::cerr << "Empty or all whitespace transaction on line '" << mLineNumber << "' failing!\n";
+        exit(-1);
+      }
+      if (memchr(first, ' ', last - first)) {
+        std::string itemName(first, last - first);
+        std::cerr << "ERROR: Item name '" << itemName.c_str() << " on line "
+                  << mLineNumber << " contains spaces, this won't work with the HARM's "
+                  " puny itemset parser. Remove all spaces from your dataset! Aborting!" << std::endl;
+        exit(-1);
+      }
+      Item item(first, last - first);
+      // Only add the item if it doesn't already appear in this transaction.
+      // We rely on assuming that transactions don't include the same item twice.
+      const size_t id = item.GetId();
+      if (id >= mLastSeen.size()) {
+        mLastSeen.resize(max<size_t>(id + 1, 2 * mLastSeen.size()), 0);
+      }
+      if (mLastSeen[id] != mTransactionNumber) {
+        mLastSeen[id] = mTransactionNumber;
+        aTransaction.push_back(item);
+      }
+    }
+    pos = tokenEnd + 1;
+  }
+  if (!haveToken) {
+    std::cerr << "Null transaction on line '" << mLineNumber << "' failing!\n";
+    exit(-1);
+  }
+}
+
+unique_ptr<DataSetReader> OpenDataSetReader(const string& aFileName,
+                                            bool aPipelined) {
+  unique_ptr<DataSetReader> reader;
+  if (BinaryDataSetReader::IsBinaryDataSet(aFileName)) {
+    reader = make_unique<BinaryDataSetReader>(aFileName);
+  } else {
+    reader = make_unique<DataSetReader>(aFileName);
+  }
+  if (aPipelined) {
+    reader = make_unique<PipelinedDataSetReader>(move(reader));
+  }
+  return reader;
+}
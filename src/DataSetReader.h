@@ -16,13 +16,15 @@
 
 #include <iostream>
 #include <fstream>
-#include <unordered_set>
+#include <vector>
 
 #include <time.h>
 #include <stdlib.h>
 #include <memory>
 
 #include "Item.h"
+#include "ItemMap.h"
+#include "MappedFile.h"
 #include "debug.h"
 #include "utils.h"
 
@@ -30,66 +32,56 @@
 class DataSetReader {
 public:
 
-  DataSetReader(std::unique_ptr<std::istream> aInput)
-    : mInput(move(aInput))
-  {
-  }
+  DataSetReader(std::unique_ptr<std::istream> aInput);
 
-  bool IsGood() {
-    return mInput->good();
-  }
+  // Reads the file |aFileName|. The file is memory mapped, and its lines
+  // are tokenized in place rather than being copied out line by line.
+  explicit DataSetReader(const std::string& aFileName);
 
-  bool Rewind() {
-    mLineNumber = 0;
-    mInput->clear(); // Clear EOF flag if necessary.
-    mInput->seekg(std::istream::beg);
-    return IsGood();
-  }
+  virtual ~DataSetReader() {}
+
+  virtual bool IsGood();
+
+  virtual bool Rewind();
 
   // Returns the next transaction in the file. Note duplicate items in
   // the transaction are removed, items only appear once in a transaction,
   // even if they're appear multiple times in the actual file.
   // Returns true if not at end of file.
-  bool GetNext(std::vector<Item>& aTransaction) {
-    std::string line;
-    aTransaction.clear();
-    aTransaction.reserve(20);
-    if (!getline(*mInput, line)) {
-      return false;
-    }
-    ++mLineNumber;
-    std::vector<std::string> tokens;
-    Tokenize(line, tokens, ",");
-    if (tokens.size() == 0) {
-      std::cerr << "Null transaction on line '" << mLineNumber << "' failing!\n";
-      exit(-1);
-    }
-
-    std::vector<std::string>::iterator itr;
-    std::unordered_set<std::string> items;
-    for (itr = tokens.begin(); itr != tokens.end(); itr++) {
-      std::string itemName = TrimWhiteSpace(*itr);
-      if (itemName.empty()) {
-        std::cerr << "Empty or all whitespace transaction on line '" << mLineNumber << "' failing!\n";
-        exit(-1);
-      }
-      if (itemName.find(" ") != std::string::npos) {
-        std::cerr << "ERROR: Item name '" << itemName.c_str() << " on line "
-                  << mLineNumber << " contains spaces, this won't work with the HARM's "
-                  " puny itemset parser. Remove all spaces from your dataset! Aborting!" << std::endl;
-        exit(-1);
-      }
-      if (items.find(itemName) == items.end()) {
-        // Item does not already appear in this transaction, add it.
-        // This is how we prevent duplicate items appearing in the transaction.
-        // We rely on assuming that transactions don't include the same item twice.
-        aTransaction.push_back(Item(itemName));
-        items.insert(itemName);
-      }
-    }
-    return true;
+  virtual bool GetNext(std::vector<Item>& aTransaction);
+
+  // Stores the number of transactions each item appears in into the map,
+  // if the data set records that up front. Returns false if the
+  // frequencies can only be found by reading the data set.
+  virtual bool GetItemFrequencies(ItemMap<unsigned>&) {
+    return false;
   }
+
+protected:
+  DataSetReader() {}
+
 private:
+  // Tokenizes the comma separated line [aBegin, aEnd) into aTransaction.
+  void ParseLine(const char* aBegin,
+                 const char* aEnd,
+                 std::vector<Item>& aTransaction);
+
   std::unique_ptr<std::istream> mInput;
+  std::string mLine;
+
+  MappedFile mFile;
+  const char* mCursor = nullptr;
+
   uint64_t mLineNumber = 0;
+
+  // The number of the last transaction in which each item id appeared. Used
+  // to remove duplicate items from a transaction.
+  std::vector<uint64_t> mLastSeen;
+  uint64_t mTransactionNumber = 0;
 };
+
+// Opens |aFileName| with a reader suited to its format; either a binary data
+// set written by "-m convert", or a CSV file. If |aPipelined| is true, the
+// file is parsed on a background thread while the caller consumes it.
+std::unique_ptr<DataSetReader> OpenDataSetReader(const std::string& aFileName,
+                                                 bool aPipelined = false);
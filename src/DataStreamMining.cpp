@@ -45,6 +45,7 @@ void MiningContext::Mine(FPTree* root, DataSet* dataset) {
              options.treePruneDepth,
              options.countItemSetsOnly,
              options.countRulesOnly,
+             options.numThreads,
              nullptr);
 }
 
@@ -78,8 +79,8 @@ void MineDataStream(const Options& options) {
   unique_ptr<StreamMiner> miner(CreateStreamMiner(options));
   miner->Init(&context);
 
-  DataSetReader reader(make_unique<ifstream>(options.inputFileName));
-  if (!reader.IsGood()) {
+  unique_ptr<DataSetReader> reader = OpenDataSetReader(options.inputFileName, options.pipelineIngest);
+  if (!reader->IsGood()) {
     cerr << "ERROR: Can't open " << options.inputFileName << " failing!" << endl;
     exit(-1);
   }
@@ -87,7 +88,7 @@ void MineDataStream(const Options& options) {
   TransactionId tid = 0;
   while (true) {
     Transaction transaction(tid);
-    if (reader.GetNext(transaction.items)) {
+    if (reader->GetNext(transaction.items)) {
       // Read a transaction, send it to the StreamMiner.
       miner->Add(transaction);
       // Increment the transaction id, so that the next transaction
@@ -0,0 +1,336 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "utils.h"
+#include "debug.h"
+#include "Item.h"
+#include "ItemSetTrie.h"
+#include "InvertedDataSetIndex.h"
+#include "Options.h"
+#include "PatternStream.h"
+
+using namespace std;
+
+// Depth first frequent itemset mining over the vertical data set, after
+// Zaki's Eclat and dEclat. The itemsets sharing a prefix form an
+// equivalence class; the members of a class are joined pairwise to form
+// the classes one item longer.
+//
+// Members of a class store either the transactions containing them (a
+// tidset), or the transactions containing the class prefix but not them
+// (a diffset). A class's children switch to diffsets when those are
+// smaller in total, which they are on dense data sets, and then stay as
+// diffsets.
+struct EclatMember {
+  Item item;
+  int count;
+  vector<uint32_t> tids;
+};
+
+// aOut = aA intersect aB. Both are sorted.
+static void Intersect(const vector<uint32_t>& aA,
+                      const vector<uint32_t>& aB,
+                      vector<uint32_t>& aOut) {
+  aOut.clear();
+  aOut.reserve(min(aA.size(), aB.size()));
+  set_intersection(aA.begin(), aA.end(), aB.begin(), aB.end(),
+                   back_inserter(aOut));
+}
+
+// aOut = aA - aB. Both are sorted.
+static void Difference(const vector<uint32_t>& aA,
+                       const vector<uint32_t>& aB,
+                       vector<uint32_t>& aOut) {
+  aOut.clear();
+  aOut.reserve(aA.size());
+  set_difference(aA.begin(), aA.end(), aB.begin(), aB.end(),
+                 back_inserter(aOut));
+}
+
+// Counts of the pairs of frequent items, in a triangular array indexed by
+// the items' positions in the first level class. Counted in one pass over
+// the transactions, so the first level joins skip the infrequent pairs
+// without intersecting their tidsets; on sparse data sets most pairs are
+// infrequent.
+class PairCounts {
+public:
+  // Returns false, without counting, if there are too many items for the
+  // array to be a reasonable size.
+  bool Count(const InvertedDataSetIndex& aIndex,
+             const vector<EclatMember>& aItems) {
+    const size_t kMaxItems = 4096;
+    mNumItems = aItems.size();
+    if (mNumItems > kMaxItems) {
+      return false;
+    }
+    vector<int> ids;
+    for (const EclatMember& member : aItems) {
+      ids.push_back(member.item.GetId());
+    }
+    sort(ids.begin(), ids.end());
+    // Position in aItems of the item with the id ids[i].
+    vector<uint32_t> positions(ids.size());
+    for (size_t i = 0; i < aItems.size(); i++) {
+      const int id = aItems[i].item.GetId();
+      positions[lower_bound(ids.begin(), ids.end(), id) - ids.begin()] = (uint32_t)i;
+    }
+    vector<uint32_t> offsets;
+    vector<int> items;
+    aIndex.GetTransactions(ids, offsets, items);
+
+    mCounts.assign(mNumItems * (mNumItems - 1) / 2, 0);
+    vector<uint32_t> transaction;
+    for (size_t t = 0; t + 1 < offsets.size(); t++) {
+      transaction.clear();
+      for (uint32_t i = offsets[t]; i < offsets[t + 1]; i++) {
+        const int id = items[i];
+        transaction.push_back(positions[lower_bound(ids.begin(), ids.end(), id) - ids.begin()]);
+      }
+      sort(transaction.begin(), transaction.end());
+      for (size_t i = 0; i < transaction.size(); i++) {
+        for (size_t j = i + 1; j < transaction.size(); j++) {
+          mCounts[Index(transaction[i], transaction[j])]++;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Count of the pair of the items at positions aI < aJ.
+  int Get(size_t aI, size_t aJ) const {
+    ASSERT(aI < aJ && aJ < mNumItems);
+    return mCounts[Index(aI, aJ)];
+  }
+
+private:
+  size_t Index(size_t aI, size_t aJ) const {
+    return aI * (2 * mNumItems - aI - 1) / 2 + (aJ - aI - 1);
+  }
+
+  size_t mNumItems = 0;
+  vector<int> mCounts;
+};
+
+// Builds the class of frequent extensions of aMembers[aIndex] by the
+// members after it in aMembers, whose members are tidsets if aDiffsets is
+// false, else diffsets. Sets aChildDiffsets to the children's form. If
+// aPairs is non-null, aMembers is the first level class and the pairs it
+// counts as infrequent aren't joined.
+static void MakeChildClass(const vector<EclatMember>& aMembers,
+                           size_t aIndex,
+                           bool aDiffsets,
+                           double aMinCount,
+                           const PairCounts* aPairs,
+                           vector<EclatMember>& aChildren,
+                           bool& aChildDiffsets) {
+  const EclatMember& x = aMembers[aIndex];
+  aChildren.clear();
+  uint64_t tidsetsSize = 0;
+  uint64_t diffsetsSize = 0;
+  for (size_t j = aIndex + 1; j < aMembers.size(); j++) {
+    if (aPairs && aPairs->Get(aIndex, j) < aMinCount) {
+      continue;
+    }
+    const EclatMember& y = aMembers[j];
+    EclatMember child;
+    child.item = y.item;
+    if (aDiffsets) {
+      // d(PXY) = d(PY) - d(PX)
+      Difference(y.tids, x.tids, child.tids);
+      child.count = x.count - (int)child.tids.size();
+    } else {
+      Intersect(x.tids, y.tids, child.tids);
+      child.count = (int)child.tids.size();
+    }
+    if (child.count < aMinCount) {
+      continue;
+    }
+    tidsetsSize += child.count;
+    diffsetsSize += x.count - child.count;
+    aChildren.push_back(move(child));
+  }
+  aChildDiffsets = aDiffsets;
+  if (!aDiffsets && diffsetsSize < tidsetsSize) {
+    // d(XY) = t(X) - t(XY)
+    vector<uint32_t> diffset;
+    for (EclatMember& child : aChildren) {
+      Difference(x.tids, child.tids, diffset);
+      child.tids.swap(diffset);
+    }
+    aChildDiffsets = true;
+  }
+}
+
+// Writes each member of the class with prefix aPattern, then mines its
+// extensions. Members' tids are released once no longer needed.
+static void MineClass(vector<Item>& aPattern,
+                      vector<EclatMember>& aMembers,
+                      bool aDiffsets,
+                      double aMinCount,
+                      PatternOutputStream& aOutput) {
+  vector<EclatMember> children;
+  for (size_t i = 0; i < aMembers.size(); i++) {
+    aPattern.push_back(aMembers[i].item);
+    aOutput.Write(aPattern, aMembers[i].count);
+    bool childDiffsets;
+    MakeChildClass(aMembers, i, aDiffsets, aMinCount, nullptr, children, childDiffsets);
+    vector<uint32_t>().swap(aMembers[i].tids);
+    MineClass(aPattern, children, childDiffsets, aMinCount, aOutput);
+    aPattern.pop_back();
+  }
+}
+
+// Mines the first level equivalence classes, one per frequent item, shared
+// out amongst numThreads threads. Each class is mined into its own forked
+// output stream, and the forked streams are joined back into aOutput in
+// order, so the output is the same as for a single thread.
+static void ParallelEclat(const vector<EclatMember>& aItems,
+                          const PairCounts* aPairs,
+                          double aMinCount,
+                          PatternOutputStream& aOutput,
+                          unsigned numThreads) {
+  vector<PatternOutputStream> sinks;
+  sinks.reserve(aItems.size());
+  for (size_t i = 0; i < aItems.size(); i++) {
+    sinks.push_back(aOutput.Fork());
+  }
+
+  // The workers only read aItems.
+  atomic<size_t> nextTask(0);
+  vector<bool> finished(aItems.size(), false);
+  mutex finishedLock;
+  condition_variable finishedCondition;
+  auto worker = [&]() {
+    vector<Item> pattern;
+    vector<EclatMember> children;
+    size_t task;
+    while ((task = nextTask++) < aItems.size()) {
+      PatternOutputStream& sink = sinks[task];
+      pattern.push_back(aItems[task].item);
+      sink.Write(pattern, aItems[task].count);
+      bool childDiffsets;
+      MakeChildClass(aItems, task, false, aMinCount, aPairs, children, childDiffsets);
+      MineClass(pattern, children, childDiffsets, aMinCount, sink);
+      pattern.pop_back();
+
+      lock_guard<mutex> lock(finishedLock);
+      finished[task] = true;
+      finishedCondition.notify_one();
+    }
+  };
+
+  vector<thread> workers;
+  for (unsigned i = 0; i < max(numThreads, 1u); i++) {
+    workers.push_back(thread(worker));
+  }
+
+  for (size_t task = 0; task < aItems.size(); task++) {
+    {
+      unique_lock<mutex> lock(finishedLock);
+      finishedCondition.wait(lock, [&]() { return finished[task]; });
+    }
+    aOutput.Join(sinks[task]);
+    sinks[task] = PatternOutputStream();
+  }
+
+  for (thread& t : workers) {
+    t.join();
+  }
+}
+
+// Mines the itemsets with count at least aMinCount into aOutput, using
+// numThreads threads.
+void MineEclat(const InvertedDataSetIndex& aIndex,
+               double aMinCount,
+               PatternOutputStream& aOutput,
+               unsigned numThreads) {
+  // The frequent items, in increasing order of count, which keeps the
+  // classes of the early, most numerous, members small.
+  vector<EclatMember> items;
+  for (const Item item : aIndex.GetItems()) {
+    const int count = aIndex.Count(item);
+    if (count >= aMinCount) {
+      EclatMember member;
+      member.item = item;
+      member.count = count;
+      items.push_back(move(member));
+    }
+  }
+  sort(items.begin(), items.end(), [](const EclatMember& a, const EclatMember& b) {
+    return a.count < b.count ||
+           (a.count == b.count && a.item.GetId() < b.item.GetId());
+  });
+  for (EclatMember& member : items) {
+    member.tids = aIndex.GetTransactionIds(member.item);
+  }
+  Log("Eclat: %u frequent items\n", (unsigned)items.size());
+  PairCounts pairs;
+  const bool countedPairs = pairs.Count(aIndex, items);
+
+  ParallelEclat(items, countedPairs ? &pairs : nullptr, aMinCount, aOutput, numThreads);
+}
+
+void Eclat(Options& options) {
+  InvertedDataSetIndex index(OpenDataSetReader(options.inputFileName, options.pipelineIngest));
+  index.Load();
+
+  const double minCount = options.minSup * index.NumTransactions();
+  Log("minCount=%lf\n", minCount);
+
+  DurationTimer timer;
+
+  const bool writeItemSets = !options.countItemSetsOnly;
+  PatternOutputStream output;
+  shared_ptr<ItemSetTrie> patterns;
+  if (writeItemSets) {
+    const string itemSetsFilename = GetOutputItemsetsFileName(options.outputFilePrefix);
+    shared_ptr<ostream> stream = std::make_shared<std::ofstream>(itemSetsFilename);
+    if (!stream->good()) {
+      cerr << "FAIL: Can't open " << itemSetsFilename << " for PatternStreamWriter output!" << endl;
+      exit(-1);
+    }
+    output = PatternOutputStream(stream, &index);
+    patterns = make_shared<ItemSetTrie>();
+    output.RecordPatterns(patterns);
+    output.UseMinedCounts();
+  }
+
+  MineEclat(index, minCount, output, options.numThreads);
+  output.Close();
+
+  Log("Eclat generated %lld patterns in %.3lfs%s\n",
+      output.GetNumPatterns(), timer.Seconds(),
+      (!writeItemSets ? " (not saved to disk)" : ""));
+
+  if (!writeItemSets) {
+    Log("Skipping rule generation because itemsets weren't saved to disk to generate from\n");
+    return;
+  }
+  long numRules = 0;
+  Log("Generating rules...\n");
+  timer.Reset();
+  GenerateRules(*patterns, index.NumTransactions(), &index, 0.9, 1.0, numRules,
+                options.outputFilePrefix, options.countRulesOnly, options.numThreads);
+  Log("Generated %d rules in %.3lfs...\n", numRules, timer.Seconds());
+}
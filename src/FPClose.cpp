@@ -0,0 +1,245 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "FPTree.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+#include "CFITree.h"
+#include "debug.h"
+#include "FPNode.h"
+#include "ItemSetTrie.h"
+#include "PatternStream.h"
+#include "utils.h"
+
+using namespace std;
+
+// Closed and maximal frequent itemset mining, after Grahne and Zhu's FPClose
+// and FPMax. The recursion is FPGrowth's, with three changes:
+//
+// * The items which are in every path of a conditional pattern base are in
+//   every transaction containing the prefix, so they're moved into the
+//   prefix rather than branched on.
+// * Each tree's items are mined in reverse of the tree's order, least
+//   frequent first. An itemset found in one item's branch contains that
+//   item, and none of the items mined after it have it in their
+//   conditional trees, so no itemset found later can be a superset of one
+//   found earlier. Each candidate need only be checked against the
+//   itemsets already found, which are kept in a CFITree.
+// * A prefix which is subsumed by an itemset already found has no closed
+//   (or maximal) itemsets in its branch, so the branch is pruned.
+struct ClosedMiner {
+  ClosedMiner(unsigned aNumItems, double aMinCount, bool aMaximal,
+              PatternOutputStream& aOutput)
+    : found(aNumItems),
+      minCount(aMinCount),
+      maximal(aMaximal),
+      output(aOutput) {}
+
+  // Closed or maximal itemsets found so far.
+  CFITree found;
+  // Each item's position in the order of the initial tree.
+  ItemMap<unsigned> globalRank;
+  double minCount;
+  bool maximal;
+  PatternOutputStream& output;
+  // Scratch space for the ranks of an itemset.
+  vector<int> ranks;
+};
+
+// Returns aItems' global ranks, in increasing order, in aMiner.ranks.
+static void GetRanks(const vector<Item>& aItems, ClosedMiner& aMiner) {
+  aMiner.ranks.clear();
+  for (const Item item : aItems) {
+    aMiner.ranks.push_back((int)aMiner.globalRank.Get(item));
+  }
+  sort(aMiner.ranks.begin(), aMiner.ranks.end());
+}
+
+// Returns the items in aTree with count at least aMinCount, in the order
+// aTree's paths are sorted in, given the rank of each item in the order of
+// the tree aTree was constructed from, and sets aRank to each item's
+// position in that order.
+static vector<Item> GetTreeOrder(FPTree* aTree,
+                                 const ItemMap<unsigned>& aParentRank,
+                                 double aMinCount,
+                                 ItemMap<unsigned>& aRank) {
+  // ConstructConditionalTree sorts paths in non-increasing order of
+  // frequency, keeping the parent tree's order for equal frequencies.
+  ItemMap<unsigned>& freq = aTree->FrequencyTable();
+  vector<Item> items;
+  ItemMap<FPNode*>::Iterator itr = aTree->HeaderTable().GetIterator();
+  while (itr.HasNext()) {
+    const Item item = itr.GetKey();
+    if (freq.Get(item, 0) >= aMinCount) {
+      items.push_back(item);
+    }
+    itr.Next();
+  }
+  sort(items.begin(), items.end(), [&](const Item a, const Item b) {
+    const unsigned fa = freq.Get(a);
+    const unsigned fb = freq.Get(b);
+    return fa > fb || (fa == fb && aParentRank.Get(a) < aParentRank.Get(b));
+  });
+  for (unsigned i = 0; i < items.size(); i++) {
+    aRank.Set(items[i], i);
+  }
+  return items;
+}
+
+static void MineClosed(FPTree* aTree,
+                       const ItemMap<unsigned>& aParentRank,
+                       vector<Item>& aPrefix,
+                       ClosedMiner& aMiner) {
+  ItemMap<unsigned> rank;
+  const vector<Item> items = GetTreeOrder(aTree, aParentRank, aMiner.minCount, rank);
+  for (auto itr = items.rbegin(); itr != items.rend(); itr++) {
+    const Item item = *itr;
+    const int count = (int)aTree->FrequencyTable().Get(item);
+    const size_t prefixSize = aPrefix.size();
+    aPrefix.push_back(item);
+
+    FPTree subtree;
+    ConstructConditionalTree(aTree->HeaderTable().Get(item), &subtree,
+                             aMiner.minCount, UINT32_MAX, &aPrefix);
+
+    if (aMiner.maximal) {
+      // Every itemset in this branch is a subset of the prefix plus the
+      // frequent items in the conditional tree.
+      vector<Item> tail = aPrefix;
+      ItemMap<FPNode*>::Iterator header = subtree.HeaderTable().GetIterator();
+      while (header.HasNext()) {
+        if (subtree.FrequencyTable().Get(header.GetKey(), 0) >= aMiner.minCount) {
+          tail.push_back(header.GetKey());
+        }
+        header.Next();
+      }
+      GetRanks(tail, aMiner);
+      if (!aMiner.found.HasSuperset(aMiner.ranks.data(), aMiner.ranks.size(), 0)) {
+        if (subtree.IsEmpty() || subtree.HasSinglePath()) {
+          // The tail is maximal; its count is that of its least frequent
+          // item, the deepest node of the path.
+          int tailCount = count;
+          for (FPNode* n = subtree.GetRoot()->FirstChild(); n; n = n->FirstChild()) {
+            tailCount = (int)n->count;
+          }
+          aMiner.found.Insert(aMiner.ranks.data(), aMiner.ranks.size(), tailCount);
+          aMiner.output.Write(tail, tailCount);
+        } else {
+          MineClosed(&subtree, rank, aPrefix, aMiner);
+        }
+      }
+    } else {
+      GetRanks(aPrefix, aMiner);
+      if (!aMiner.found.HasSuperset(aMiner.ranks.data(), aMiner.ranks.size(), count)) {
+        aMiner.found.Insert(aMiner.ranks.data(), aMiner.ranks.size(), count);
+        aMiner.output.Write(aPrefix, count);
+        if (!subtree.IsEmpty()) {
+          MineClosed(&subtree, rank, aPrefix, aMiner);
+        }
+      }
+    }
+
+    aPrefix.resize(prefixSize);
+  }
+}
+
+// Mines the closed, or if aMaximal is true the maximal, itemsets with count
+// at least aMinCount in aTree into aOutput.
+void MineClosedItemSets(FPTree* aTree,
+                        double aMinCount,
+                        bool aMaximal,
+                        PatternOutputStream& aOutput) {
+  // The initial tree's paths are sorted in non-increasing order of
+  // frequency, tie breaking on item id.
+  vector<Item> items;
+  ItemMap<unsigned>& freq = aTree->FrequencyTable();
+  ItemMap<FPNode*>::Iterator itr = aTree->HeaderTable().GetIterator();
+  while (itr.HasNext()) {
+    items.push_back(itr.GetKey());
+    itr.Next();
+  }
+  sort(items.begin(), items.end(), [&](const Item a, const Item b) {
+    const unsigned fa = freq.Get(a);
+    const unsigned fb = freq.Get(b);
+    return fa > fb || (fa == fb && a.GetId() < b.GetId());
+  });
+
+  // The frequent itemsets found so far are subset checked as the mining
+  // proceeds, so the tree is mined on one thread.
+  ClosedMiner miner((unsigned)items.size(), aMinCount, aMaximal, aOutput);
+  for (unsigned i = 0; i < items.size(); i++) {
+    miner.globalRank.Set(items[i], i);
+  }
+  vector<Item> prefix;
+  MineClosed(aTree, miner.globalRank, prefix, miner);
+}
+
+void MineClosedFPTree(FPTree* fptree,
+                      double minSup,
+                      bool maximal,
+                      const std::string& itemSetsOuputFilename,
+                      const std::string& rulesOuputFilename,
+                      DataSet* index,
+                      bool countItemSetsOnly,
+                      bool countRulesOnly,
+                      unsigned numThreads) {
+  if (!fptree) {
+    return;
+  }
+
+  const double minCount = minSup * index->NumTransactions();
+  Log("minCount=%lf\n", minCount);
+
+  DurationTimer timer;
+
+  bool writeItemSets = !countItemSetsOnly;
+
+  PatternOutputStream output;
+  shared_ptr<ItemSetTrie> patterns;
+  if (writeItemSets) {
+    shared_ptr<ostream> stream = std::make_shared<std::ofstream>(itemSetsOuputFilename);
+    if (!stream->good()) {
+      cerr << "FAIL: Can't open " << itemSetsOuputFilename << " for PatternStreamWriter output!" << endl;
+      exit(-1);
+    }
+    output = PatternOutputStream(stream, index);
+    patterns = make_shared<ItemSetTrie>();
+    output.RecordPatterns(patterns);
+    output.UseMinedCounts();
+  }
+
+  MineClosedItemSets(fptree, minCount, maximal, output);
+  output.Close();
+
+  Log("%s generated %lld %s itemsets in %.3lfs%s\n",
+      (maximal ? "FPMax" : "FPClose"), output.GetNumPatterns(),
+      (maximal ? "maximal" : "closed"), timer.Seconds(),
+      (!writeItemSets ? " (not saved to disk)" : ""));
+
+  if (!writeItemSets) {
+    Log("Skipping rule generation because itemsets weren't saved to disk to generate from\n");
+  } else {
+    long numRules = 0;
+    Log("Generating rules...\n");
+    DurationTimer timer;
+    GenerateRules(*patterns, index->NumTransactions(), index, 0.9, 1.0,
+                  numRules, rulesOuputFilename, countRulesOnly, numThreads);
+    Log("Generated %d rules in %.3lfs...\n", numRules, timer.Seconds());
+  }
+  Log("-----------------------------------------------\n");
+}
@@ -19,42 +19,259 @@
 
 using namespace std;
 
-FPNode::~FPNode() {
-  if (!IsRoot()) {
+FPNode::FPNode(FPTree* aTree,
+               Item aItem,
+               FPNode* aParent,
+               unsigned aCount,
+               unsigned aDepth)
+  : item(aItem)
+  , count(aCount)
+  , next(nullptr)
+  , prev(nullptr)
+  , parent(aParent)
+  , depth(aDepth)
+  , mNextLeaf(nullptr)
+  , mPrevLeaf(nullptr)
+  , mIsInLeafList(false)
+  , mTree(aTree)
+{
+  // All nodes initially have no children, so are leaves to start with.
+  Leaves().Prepend(this);
+}
+
+void FPTree::EnableFPArray(const std::vector<Item>& aItems) {
+  ASSERT(IsEmpty());
+  mFPArrayItems = aItems;
+  for (uint32_t slot = 0; slot < aItems.size(); slot++) {
+    const uint32_t index = aItems[slot].GetIndex();
+    if (index >= mFPArraySlots.size()) {
+      mFPArraySlots.resize(index + 1);
+    }
+    mFPArraySlots[index] = slot;
+  }
+  mFPArray.assign(aItems.size() * aItems.size(), 0);
+}
+
+void FPTree::AddToFPArray(const std::vector<Item>& aTxn, unsigned aCount) {
+  const size_t numItems = mFPArrayItems.size();
+  for (size_t i = 1; i < aTxn.size(); i++) {
+    unsigned* row = &mFPArray[mFPArraySlots[aTxn[i].GetIndex()] * numItems];
+    for (size_t j = 0; j < i; j++) {
+      row[mFPArraySlots[aTxn[j].GetIndex()]] += aCount;
+    }
+  }
+}
+
+void FPTree::FreeSubtree(FPNode* aNode) {
+  if (!aNode->IsRoot()) {
     // This is a regular node, it's also appears in the linked list in
     // the header table. Remove node from the header table.
-    if (!prev) {
+    if (!aNode->prev) {
       // This node is the first entry in header table.
-      if (next) {
+      if (aNode->next) {
         // We have a next, set the first entry to that.
-        HeaderTable().Set(item, next);
-        next->prev = nullptr;
+        mHeaderTable.Set(aNode->item, aNode->next);
+        aNode->next->prev = nullptr;
       } else {
         // No next, just erase the entry for this item.
-        HeaderTable().Erase(item);
+        mHeaderTable.Erase(aNode->item);
       }
     } else {
-      if (next) {
-        next->prev = prev;
+      if (aNode->next) {
+        aNode->next->prev = aNode->prev;
+      }
+      aNode->prev->next = aNode->next;
+    }
+    if (aNode->IsLeaf()) {
+      mLeaves.Erase(aNode);
+      ASSERT(!aNode->mIsInLeafList);
+    }
+    if (aNode->count) {
+      aNode->Decrement(aNode->count);
+    }
+  }
+  // Free our child trees.
+  for (FPNode* child : aNode->children) {
+    FreeSubtree(child);
+  }
+  aNode->children.Clear(mArena);
+  mArena.FreeNode(aNode);
+}
+
+void FPChildList::Add(FPNode* aChild, FPNodeArena& aArena) {
+  ASSERT(!Get(aChild->item));
+  if (IsInline()) {
+    if (mSize < kInlineChildren) {
+      mInline.ids[mSize] = aChild->item.GetId();
+      mInline.nodes[mSize] = aChild;
+      mSize++;
+      return;
+    }
+    Grow(aArena);
+  } else if ((mSize + 1) * 4 > mCapacity * 3) {
+    Grow(aArena);
+  }
+  InsertIntoTable(aChild);
+  mSize++;
+}
+
+void FPChildList::InsertIntoTable(FPNode* aChild) {
+  unsigned slot = SlotFor(aChild->item.GetId());
+  while (mTable[slot]) {
+    slot = (slot + 1) & (mCapacity - 1);
+  }
+  mTable[slot] = aChild;
+}
+
+void FPChildList::Grow(FPNodeArena& aArena) {
+  // The inline storage shares memory with the table pointer, so take a copy
+  // of the inline children before we overwrite it.
+  FPNode* inlineNodes[kInlineChildren];
+  FPNode** oldSlots = mTable;
+  unsigned numOldSlots = mCapacity;
+  const unsigned oldCapacity = mCapacity;
+  if (IsInline()) {
+    for (unsigned i = 0; i < mSize; i++) {
+      inlineNodes[i] = mInline.nodes[i];
+    }
+    oldSlots = inlineNodes;
+    numOldSlots = mSize;
+  }
+  mCapacity = IsInline() ? kInlineChildren * 4 : mCapacity * 2;
+  mTable = aArena.AllocateTable(mCapacity);
+  for (unsigned i = 0; i < numOldSlots; i++) {
+    if (oldSlots[i]) {
+      InsertIntoTable(oldSlots[i]);
+    }
+  }
+  if (oldCapacity) {
+    aArena.FreeTable(oldSlots, oldCapacity);
+  }
+}
+
+void FPChildList::Remove(Item aItem) {
+  const int id = aItem.GetId();
+  if (IsInline()) {
+    for (unsigned i = 0; i < mSize; i++) {
+      if (mInline.ids[i] == id) {
+        mSize--;
+        mInline.ids[i] = mInline.ids[mSize];
+        mInline.nodes[i] = mInline.nodes[mSize];
+        return;
       }
-      prev->next = next;
     }
-    if (IsLeaf()) {
-      ASSERT(leafToken.IsInList());
-      Leaves().Erase(leafToken);
-      ASSERT(!leafToken.IsInList());
+    ASSERT(false);
+    return;
+  }
+  const unsigned mask = mCapacity - 1;
+  unsigned slot = SlotFor(id);
+  while (mTable[slot]->item.GetId() != id) {
+    slot = (slot + 1) & mask;
+    ASSERT(mTable[slot]);
+  }
+  // Shift back any entries which probed past the slot we're emptying, so
+  // that lookups don't need tombstones.
+  mTable[slot] = nullptr;
+  for (unsigned next = (slot + 1) & mask; mTable[next]; next = (next + 1) & mask) {
+    const unsigned ideal = SlotFor(mTable[next]->item.GetId());
+    if (((next - ideal) & mask) >= ((next - slot) & mask)) {
+      mTable[slot] = mTable[next];
+      mTable[next] = nullptr;
+      slot = next;
     }
-    if (count) {
-      Decrement(count);
+  }
+  mSize--;
+}
+
+void FPChildList::Clear(FPNodeArena& aArena) {
+  if (!IsInline()) {
+    aArena.FreeTable(mTable, mCapacity);
+  }
+  mCapacity = 0;
+  mSize = 0;
+}
+
+void FPLeafList::Prepend(FPNode* aNode) {
+  ASSERT(!aNode->mIsInLeafList);
+  aNode->mPrevLeaf = nullptr;
+  aNode->mNextLeaf = mHead;
+  if (mHead) {
+    mHead->mPrevLeaf = aNode;
+  } else {
+    mTail = aNode;
+  }
+  mHead = aNode;
+  aNode->mIsInLeafList = true;
+  mSize++;
+}
+
+void FPLeafList::Append(FPNode* aNode) {
+  ASSERT(!aNode->mIsInLeafList);
+  aNode->mNextLeaf = nullptr;
+  aNode->mPrevLeaf = mTail;
+  if (mTail) {
+    mTail->mNextLeaf = aNode;
+  } else {
+    mHead = aNode;
+  }
+  mTail = aNode;
+  aNode->mIsInLeafList = true;
+  mSize++;
+  // Iterators which have run off the end of the list continue with the
+  // appended node.
+  for (Iterator* itr : mIterators) {
+    if (!itr->mNode) {
+      itr->mNode = aNode;
     }
   }
-  // Delete our child trees.
-  map<Item, FPNode*>::iterator itr = children.begin();
-  while (itr != children.end()) {
-    delete itr->second;
-    itr++;
+}
+
+void FPLeafList::Erase(FPNode* aNode) {
+  if (!aNode->mIsInLeafList) {
+    return;
+  }
+  for (Iterator* itr : mIterators) {
+    if (itr->mNode == aNode) {
+      itr->mNode = aNode->mNextLeaf;
+    }
+  }
+  if (aNode->mPrevLeaf) {
+    aNode->mPrevLeaf->mNextLeaf = aNode->mNextLeaf;
+  } else {
+    mHead = aNode->mNextLeaf;
+  }
+  if (aNode->mNextLeaf) {
+    aNode->mNextLeaf->mPrevLeaf = aNode->mPrevLeaf;
+  } else {
+    mTail = aNode->mPrevLeaf;
+  }
+  aNode->mNextLeaf = nullptr;
+  aNode->mPrevLeaf = nullptr;
+  aNode->mIsInLeafList = false;
+  mSize--;
+}
+
+FPLeafList::Iterator* FPLeafList::Begin() {
+  Iterator* itr = new Iterator(mHead, this);
+  mIterators.push_back(itr);
+  return itr;
+}
+
+FPLeafList::Iterator::~Iterator() {
+  vector<Iterator*>& iterators = mList->mIterators;
+  iterators.erase(find(iterators.begin(), iterators.end(), this));
+}
+
+vector<FPNode*> FPNode::SortedChildren() const {
+  vector<FPNode*> sorted;
+  sorted.reserve(children.Size());
+  for (FPNode* child : children) {
+    sorted.push_back(child);
   }
-  children.clear();
+  sort(sorted.begin(), sorted.end(), [](const FPNode* a, const FPNode* b) {
+    return a->item < b->item;
+  });
+  return sorted;
 }
 
 string FPNode::ToString() const {
@@ -63,11 +280,9 @@ string FPNode::ToString() const {
   s.append(":");
   s.append(std::to_string(count));
 
-  map<Item, FPNode*>::const_iterator itr = children.begin();
-  while (itr != children.end()) {
+  for (const FPNode* child : SortedChildren()) {
     s.append(" ");
-    s.append(itr->second->ToString());
-    itr++;
+    s.append(child->ToString());
   }
   s.append(")");
   return s;
@@ -82,11 +297,9 @@ string FPNode::ToString(uint32_t stopDepth) const {
   s.append(":");
   s.append(std::to_string(count));
 
-  map<Item, FPNode*>::const_iterator itr = children.begin();
-  while (itr != children.end()) {
+  for (const FPNode* child : SortedChildren()) {
     s.append(" ");
-    s.append(itr->second->ToString());
-    itr++;
+    s.append(child->ToString());
   }
   s.append(")");
   return s;
@@ -113,10 +326,8 @@ void FPNode::ToFile(char* fn, uint32_t stopDepth) {
 }
 bool FPNode::ToVector(vector<int32_t>* v) const {
   v->push_back(item.IsNull() ? 0 : item.GetId());
-  map<Item, FPNode*>::const_iterator itr = children.begin();
-  while (itr != children.end()) {
-    itr->second->ToVector(v);
-    itr++;
+  for (const FPNode* child : SortedChildren()) {
+    child->ToVector(v);
   }
   return true;
 }
@@ -126,10 +337,8 @@ bool FPNode::ToVector(uint32_t stopDepth, vector<int32_t>* v) const {
     return false;
   }
   v->push_back(item.IsNull() ? 0 : item.GetId());
-  map<Item, FPNode*>::const_iterator itr = children.begin();
-  while (itr != children.end()) {
-    itr->second->ToVector(stopDepth, v);
-    itr++;
+  for (const FPNode* child : SortedChildren()) {
+    child->ToVector(stopDepth, v);
   }
   return true;
 }
@@ -140,10 +349,8 @@ bool FPNode::ToVector(vector<CmpNode>* v) const {
   n.nDepth = depth;
   n.nCount = count;
   v->push_back(n);
-  map<Item, FPNode*>::const_iterator itr = children.begin();
-  while (itr != children.end()) {
-    itr->second->ToVector(v);
-    itr++;
+  for (const FPNode* child : SortedChildren()) {
+    child->ToVector(v);
   }
   return true;
 }
@@ -157,21 +364,16 @@ bool FPNode::ToVector(uint32_t stopDepth, vector<CmpNode>* v) const {
   p.nDepth = depth;
   p.nCount = count;
   v->push_back(p);
-  map<Item, FPNode*>::const_iterator itr = children.begin();
-  while (itr != children.end()) {
-    itr->second->ToVector(stopDepth, v);
-    itr++;
+  for (const FPNode* child : SortedChildren()) {
+    child->ToVector(stopDepth, v);
   }
   return true;
 }
 
 unsigned FPNode::NumNodes() const {
   unsigned n = 1; // for this node...
-  map<Item, FPNode*>::const_iterator itr = children.begin();
-  while (itr != children.end()) {
-    FPNode* node = itr->second;
+  for (const FPNode* node : children) {
     n += node->NumNodes();
-    itr++;
   }
   return n;
 }
@@ -187,9 +389,7 @@ void FPNode::DumpToGraphViz(const char* filename) const {
 }
 
 void FPNode::DumpToGraphViz(FILE* f, string parent) const {
-  map<Item, FPNode*>::const_iterator itr = children.begin();
-  while (itr != children.end()) {
-    FPNode* child = itr->second;
+  for (const FPNode* child : SortedChildren()) {
     string name = (string)child->item;
     string nodeName = parent + "_" + name;
 
@@ -197,7 +397,6 @@ void FPNode::DumpToGraphViz(FILE* f, string parent) const {
 
     fprintf(f, "\t%s -> %s;\n", parent.c_str(), nodeName.c_str());
     child->DumpToGraphViz(f, nodeName);
-    itr++;
   }
 }
 
@@ -234,8 +433,7 @@ void FPNode::SortTransaction(vector<Item>& transaction) {
 
 FPNode* FPNode::GetChild(Item aItem) const
 {
-  map<Item, FPNode*>::const_iterator itr = children.find(aItem);
-  return (itr != children.end()) ? itr->second : nullptr;
+  return children.Get(aItem);
 }
 
 FPNode* FPNode::GetOrCreateChild(Item aItem)
@@ -243,17 +441,17 @@ FPNode* FPNode::GetOrCreateChild(Item aItem)
   FPNode* node = GetChild(aItem);
   if (!node) {
     // Item is not in child list, create a new node for it.
-    node = new FPNode(mTree, aItem, this, 0, depth + 1);
-    ASSERT(node->leafToken.IsInList());
+    node = mTree->CreateNode(aItem, this);
+    ASSERT(node->mIsInLeafList);
 
     if (!IsRoot() && IsLeaf()) {
       // We're about to add a child node, so we'll stop being a leaf.
       // Remove us from the leaves list.
-      ASSERT(leafToken.IsInList());
-      Leaves().Erase(leafToken);
-      ASSERT(!leafToken.IsInList());
+      ASSERT(mIsInLeafList);
+      Leaves().Erase(this);
+      ASSERT(!mIsInLeafList);
     }
-    children[aItem] = node;
+    children.Add(node, mTree->mArena);
     ASSERT(!IsLeaf());
 
     // Add new item to the headerTable.
@@ -298,9 +496,7 @@ void FPNode::Remove(std::vector<Item>::const_iterator aPathBegin,
   FPNode* parent = this;
   for (auto pathItr = aPathBegin; pathItr != aPathEnd; pathItr++) {
     Item item = *pathItr;
-    auto itr = parent->children.find(item);
-    ASSERT(itr != parent->children.end());
-    FPNode* node = itr->second;
+    FPNode* node = parent->children.Get(item);
     ASSERT(node);
 
     ASSERT(node->count >= aCount);
@@ -309,11 +505,11 @@ void FPNode::Remove(std::vector<Item>::const_iterator aPathBegin,
     if (node->count == 0) {
       // End of the line! No more children can have non-zero path.
       ASSERT(node->parent == parent);
-      parent->children.erase(itr);
-      if (parent->children.size() == 0 && !parent->IsRoot()) {
-        parent->leafToken = Leaves().Append(parent);
+      parent->children.Remove(item);
+      if (parent->children.IsEmpty() && !parent->IsRoot()) {
+        Leaves().Append(parent);
       }
-      delete node;
+      mTree->FreeSubtree(node);
       break;
     }
     parent = node;
@@ -349,9 +545,8 @@ void FPNode::AddToHeaderTable(FPNode* node) {
 
 bool FPNode::DoIsSorted() const {
   ASSERT(!IsRoot());
-  map<Item, FPNode*>::const_iterator itr = children.begin();
-  while (itr != children.end()) {
-    Item childItem = itr->first;
+  for (const FPNode* childNode : children) {
+    Item childItem = childNode->item;
     unsigned f = FrequencyTable().Get(item, 0);
     unsigned cf = FrequencyTable().Get(childItem, 0);
     if (cf == f && item.GetId() > childItem.GetId()) {
@@ -362,27 +557,21 @@ bool FPNode::DoIsSorted() const {
       ASSERT(false);
       return false;
     }
-    FPNode* childNode = itr->second;
     if (!childNode->DoIsSorted()) {
       ASSERT(false);
       return false;
     }
-    itr++;
   }
   return true;
 }
 
 bool FPNode::IsSorted() const {
   if (IsRoot()) {
-    map<Item, FPNode*>::const_iterator itr = children.begin();
-    while (itr != children.end()) {
-      Item item = itr->first;
-      FPNode* child = itr->second;
+    for (const FPNode* child : children) {
       if (!child->DoIsSorted()) {
         ASSERT(false);
         return false;
       }
-      itr++;
     }
     return true;
   } else {
@@ -519,7 +708,7 @@ FPNode::FrequencyTableAtLastSort() const {
   return mTree->FrequencyTableAtLastSort();
 }
 
-List<FPNode*>&
+FPLeafList&
 FPNode::Leaves() const {
   ASSERT(mTree);
   return mTree->Leaves();
@@ -16,15 +16,17 @@
 
 #include <iostream>
 #include <memory>
-#include <map>
+#include <vector>
+#include <new>
 
 #include "Item.h"
-#include "List.h"
 #include "ItemMap.h"
+#include "FPNodeArena.h"
 #include "utils.h"
 
 
 class FPNode;
+class FPLeafList;
 
 
 struct ItemComparator {
@@ -67,13 +69,121 @@ struct ItemMapCmp : public ItemComparator {
 
 class FPTree;
 
+// The children of an FPNode. Most nodes have only a few children, so these
+// are stored inline in the node. Once a node's fan out exceeds
+// kInlineChildren, its children are moved into an open addressing hash table
+// keyed by item id, which is allocated from the tree's FPNodeArena.
+// The children are unordered.
+class FPChildList {
+public:
+  static const unsigned kInlineChildren = 4;
+
+  FPChildList()
+    : mSize(0)
+    , mCapacity(0)
+  {
+  }
+
+  unsigned Size() const {
+    return mSize;
+  }
+
+  bool IsEmpty() const {
+    return mSize == 0;
+  }
+
+  // Returns the child for |aItem|, or nullptr if there isn't one.
+  FPNode* Get(Item aItem) const;
+
+  // Adds |aChild|. There must not already be a child for its item.
+  void Add(FPNode* aChild, FPNodeArena& aArena);
+
+  // Removes the child for |aItem|, which must exist.
+  void Remove(Item aItem);
+
+  // Returns the hash table, if any, to |aArena|, and removes all children.
+  void Clear(FPNodeArena& aArena);
+
+  // Forward iterator over the children.
+  class Iterator {
+  public:
+    Iterator(FPNode* const* aPos, FPNode* const* aEnd)
+      : mPos(aPos)
+      , mEnd(aEnd)
+    {
+      SkipEmpty();
+    }
+    FPNode* operator*() const {
+      return *mPos;
+    }
+    Iterator& operator++() {
+      mPos++;
+      SkipEmpty();
+      return *this;
+    }
+    bool operator!=(const Iterator& aOther) const {
+      return mPos != aOther.mPos;
+    }
+  private:
+    void SkipEmpty() {
+      while (mPos != mEnd && !*mPos) {
+        mPos++;
+      }
+    }
+    FPNode* const* mPos;
+    FPNode* const* mEnd;
+  };
+
+  Iterator begin() const {
+    return Iterator(Slots(), Slots() + NumSlots());
+  }
+
+  Iterator end() const {
+    return Iterator(Slots() + NumSlots(), Slots() + NumSlots());
+  }
+
+private:
+  bool IsInline() const {
+    return mCapacity == 0;
+  }
+
+  FPNode* const* Slots() const {
+    return IsInline() ? mInline.nodes : mTable;
+  }
+
+  unsigned NumSlots() const {
+    return IsInline() ? mSize : mCapacity;
+  }
+
+  unsigned SlotFor(int aId) const {
+    return (static_cast<unsigned>(aId) * 2654435761u) & (mCapacity - 1);
+  }
+
+  void InsertIntoTable(FPNode* aChild);
+  void Grow(FPNodeArena& aArena);
+
+  unsigned mSize;
+
+  // Capacity of the hash table, or 0 when the children are stored inline.
+  unsigned mCapacity;
+
+  union {
+    struct {
+      int ids[kInlineChildren];
+      FPNode* nodes[kInlineChildren];
+    } mInline;
+    FPNode** mTable;
+  };
+};
+
 class FPNode {
   friend class FPTree;
+  friend class FPLeafList;
 public:
 
   Item item;
   unsigned count;
-  std::map<Item, FPNode*> children;
+  FPChildList children;
 
   // Next item in the header table list of nodes.
   FPNode* next;
@@ -87,14 +197,8 @@ public:
   // Number of parent nodes. Root is depth 0.
   const unsigned depth;
 
-  // Our token in the leaf list. This enables us to delete the node from
-  // the leaf list in O(1) time.
-  List<FPNode*>::Token leafToken;
-
   void DumpFreq() const;
 
-  ~FPNode();
-
   bool IsRoot() const {
     bool isRoot = item.IsNull();
     ASSERT(isRoot == (depth == 0));
@@ -104,17 +208,21 @@ public:
   unsigned NumNodes() const;
 
   bool IsLeaf() const {
-    bool rv = children.empty();
-    ASSERT(IsRoot() || (rv == leafToken.IsInList()));
+    bool rv = children.IsEmpty();
+    ASSERT(IsRoot() || (rv == mIsInLeafList));
     return rv;
   }
 
   bool IsSorted() const;
 
   FPNode* FirstChild() const {
-    return children.size() > 0 ? children.begin()->second : 0;
+    return !children.IsEmpty() ? *children.begin() : 0;
   }
 
+  // Returns this node's children in item order, for when a traversal must
+  // be in a deterministic order. The child list itself is unordered.
+  std::vector<FPNode*> SortedChildren() const;
+
   void Sort();
   void Sort(ItemComparator* cmp);
 
@@ -147,18 +255,18 @@ public:
   ItemMap<FPNode*>& HeaderTable() const;
   ItemMap<unsigned>& FrequencyTable() const;
   ItemMap<unsigned>& FrequencyTableAtLastSort() const;
-  List<FPNode*>& Leaves() const;
+  FPLeafList& Leaves() const;
 
 private:
 
   bool HasSinglePath() const {
-    if ((!parent || (parent->IsRoot() && parent->children.size() == 1)) && children.size() == 0) {
+    if ((!parent || (parent->IsRoot() && parent->children.Size() == 1)) && children.Size() == 0) {
       return false;
     }
-    if (children.size() == 0) {
+    if (children.Size() == 0) {
       return true;
     }
-    else if (children.size() == 1) {
+    else if (children.Size() == 1) {
       return FirstChild()->HasSinglePath();
     }
     else {
@@ -183,6 +291,7 @@ private:
 
   bool DoIsSorted() const;
 
+  // Nodes are allocated by, and only by, their FPTree's arena.
   // Creates a root node.
   explicit FPNode(FPTree* aTree)
     : count(0)
@@ -190,6 +299,9 @@ private:
     , prev(nullptr)
     , parent(nullptr)
     , depth(0)
+    , mNextLeaf(nullptr)
+    , mPrevLeaf(nullptr)
+    , mIsInLeafList(false)
     , mTree(aTree)
   {
   }
@@ -199,18 +311,7 @@ private:
                   Item aItem,
                   FPNode* aParent,
                   unsigned aCount,
-                  unsigned aDepth)
-    : item(aItem)
-    , count(aCount)
-    , next(nullptr)
-    , prev(nullptr)
-    , parent(aParent)
-    , depth(aDepth)
-    , mTree(aTree)
-  {
-    // All nodes initially have no children, so are leaves to start with.
-    leafToken = Leaves().Prepend(this);
-  }
+                  unsigned aDepth);
 
   // Inserts the items in txn into the tree. Increments the support count by
   // |count|. idx is the index into txn which we're currently adding, idx+1
@@ -221,30 +322,127 @@ private:
 
   void AddToHeaderTable(FPNode* n);
 
+  // Links in the tree's list of leaves.
+  FPNode* mNextLeaf;
+  FPNode* mPrevLeaf;
+  bool mIsInLeafList;
+
   FPTree* mTree;
 };
 
+inline FPNode* FPChildList::Get(Item aItem) const {
+  const int id = aItem.GetId();
+  if (IsInline()) {
+    for (unsigned i = 0; i < mSize; i++) {
+      if (mInline.ids[i] == id) {
+        return mInline.nodes[i];
+      }
+    }
+    return nullptr;
+  }
+  for (unsigned slot = SlotFor(id); mTable[slot]; slot = (slot + 1) & (mCapacity - 1)) {
+    if (mTable[slot]->item.GetId() == id) {
+      return mTable[slot];
+    }
+  }
+  return nullptr;
+}
+
+// Intrusive doubly linked list of an FPTree's leaf nodes. Like List, nodes
+// can be removed from and appended to the list while it's being iterated
+// over; iterators are notified so that they skip removed nodes and reach
+// appended nodes.
+class FPLeafList {
+public:
+  FPLeafList()
+    : mHead(nullptr)
+    , mTail(nullptr)
+    , mSize(0)
+  {
+  }
+
+  unsigned GetSize() const {
+    return mSize;
+  }
+
+  void Append(FPNode* aNode);
+  void Prepend(FPNode* aNode);
+  void Erase(FPNode* aNode);
+
+  // Empties the list without unlinking the nodes, for when they're being
+  // freed in bulk. There must be no live iterators.
+  void Clear() {
+    ASSERT(mIterators.empty());
+    mHead = nullptr;
+    mTail = nullptr;
+    mSize = 0;
+  }
+
+  class Iterator {
+    friend class FPLeafList;
+  public:
+    bool HasNext() const {
+      return mNode != nullptr;
+    }
+
+    FPNode* Next() {
+      ASSERT(HasNext());
+      FPNode* node = mNode;
+      mNode = mNode->mNextLeaf;
+      return node;
+    }
+
+    ~Iterator();
+
+  private:
+    Iterator(FPNode* aNode, FPLeafList* aList)
+      : mNode(aNode)
+      , mList(aList)
+    {
+    }
+    FPNode* mNode;
+    FPLeafList* mList;
+  };
+
+  // Caller must delete iterator when finished with it.
+  Iterator* Begin();
+
+private:
+  FPNode* mHead;
+  FPNode* mTail;
+  unsigned mSize;
+  std::vector<Iterator*> mIterators;
+};
+
 class FPTree {
 public:
 
   FPTree()
-    : mRoot(new FPNode(this))
+    : mRoot(new (mArena.AllocateNode()) FPNode(this))
   {
   }
 
-  ~FPTree()
-  {
-    // Note: We must explicitly delete this here so that the destruction
-    // of the tree is performed before the other fields on the tree are
-    // destroyed, as the FPNode's destructors use data stored on the FPTree.
-    mRoot = nullptr;
+  // All nodes are freed in bulk when the arena is destroyed.
+  ~FPTree() {}
+
+  // Removes everything from the tree, keeping the memory it used for the
+  // nodes and tables to build the next tree in.
+  void Clear() {
+    mArena.Reset();
+    mRoot = new (mArena.AllocateNode()) FPNode(this);
+    mHeaderTable.Clear();
+    mLeaves.Clear();
+    mFreq.Clear();
+    mFreqAtLastSort.Clear();
+    mFPArrayItems.clear();
+    mFPArray.clear();
   }
 
   FPNode* GetRoot() const { return mRoot; }
   ItemMap<FPNode*>& HeaderTable() { return mHeaderTable; }
   ItemMap<unsigned>& FrequencyTable() { return mFreq; }
   ItemMap<unsigned>& FrequencyTableAtLastSort() { return mFreqAtLastSort; }
-  List<FPNode*>& Leaves() { return mLeaves; }
+  FPLeafList& Leaves() { return mLeaves; }
 
   bool HasSinglePath() const {
     return mRoot->HasSinglePath();
@@ -255,10 +453,36 @@ public:
   }
 
   void Insert(const std::vector<Item>& txn, unsigned count) {
+    if (HasFPArray()) {
+      AddToFPArray(txn, count);
+    }
     mRoot->Insert(txn.begin(), txn.end(), count);
   }
   void Insert(const std::vector<Item>& txn) {
-    mRoot->Insert(txn);
+    Insert(txn, 1);
+  }
+
+  // Starts keeping the tree's FP-array, as in FP-Growth*. For each pair of
+  // aItems, this holds the total count of the transactions inserted with
+  // one of the pair above the other. The frequencies of the items in an
+  // item's conditional pattern base can then be read from its row, rather
+  // than counted by walking the tree. Only aItems may be inserted after, and
+  // the tree must be empty.
+  void EnableFPArray(const std::vector<Item>& aItems);
+
+  bool HasFPArray() const {
+    return !mFPArrayItems.empty();
+  }
+
+  // The items of the FP-array, in the order of the entries of its rows.
+  const std::vector<Item>& FPArrayItems() const {
+    return mFPArrayItems;
+  }
+
+  // Returns aItem's row of the FP-array, whose j'th entry is the count of
+  // the transactions inserted with FPArrayItems()[j] above aItem.
+  const unsigned* FPArrayRow(Item aItem) const {
+    return &mFPArray[mFPArraySlots[aItem.GetIndex()] * mFPArrayItems.size()];
   }
 
   void Remove(const std::vector<Item>& path) {
@@ -317,9 +541,24 @@ public:
   }
 
 private:
-  AutoPtr<FPNode> mRoot;
+  friend class FPNode;
+
+  FPNode* CreateNode(Item aItem, FPNode* aParent) {
+    return new (mArena.AllocateNode()) FPNode(this, aItem, aParent, 0, aParent->depth + 1);
+  }
+
+  // Unlinks |aNode| and its descendants from the header table, leaf list and
+  // frequency table, and returns them to the arena.
+  void FreeSubtree(FPNode* aNode);
+
+  void AddToFPArray(const std::vector<Item>& aTxn, unsigned aCount);
+
+  // Must be declared before mRoot, so that it is constructed first.
+  FPNodeArena mArena;
+
+  FPNode* mRoot;
   ItemMap<FPNode*> mHeaderTable;
-  List<FPNode*> mLeaves;
+  FPLeafList mLeaves;
 
   // Current frequency table. This is updated as we add items to the tree.
   ItemMap<unsigned> mFreq;
@@ -328,6 +567,12 @@ private:
   // We keep this separate from the current frequency table in |freq| so that
   // we sort consistently during insertion.
   ItemMap<unsigned> mFreqAtLastSort; // iList;
+
+  // FP-array items, each item's index in them, indexed by item index, and
+  // the square array of counts, row by row.
+  std::vector<Item> mFPArrayItems;
+  std::vector<uint32_t> mFPArraySlots;
+  std::vector<unsigned> mFPArray;
 };
 
 class TreePathIterator {
@@ -342,5 +587,5 @@ public:
 
 private:
   FPNode* root;
-  std::unique_ptr<List<FPNode*>::Iterator> itr;
+  std::unique_ptr<FPLeafList::Iterator> itr;
 };
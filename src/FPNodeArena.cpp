@@ -0,0 +1,129 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "FPNodeArena.h"
+#include "FPNode.h"
+#include "debug.h"
+
+#include <string.h>
+#include <atomic>
+#include <new>
+
+using namespace std;
+
+static const size_t kFirstBlockNodes = 32;
+static const size_t kMaxBlockNodes = 4096;
+
+static atomic<uint64_t> sNumBlockAllocations(0);
+
+static unsigned Log2(unsigned aPowerOfTwo) {
+  unsigned log = 0;
+  while ((1u << log) < aPowerOfTwo) {
+    log++;
+  }
+  return log;
+}
+
+FPNodeArena::FPNodeArena()
+  : mNextNodeBlock(0),
+    mNodeCursor(nullptr),
+    mNodeEnd(nullptr),
+    mNextBlockNodes(kFirstBlockNodes),
+    mFreeNodes(nullptr) {
+}
+
+FPNodeArena::~FPNodeArena() {
+  for (void* block : mBlocks) {
+    ::operator delete(block);
+  }
+}
+
+void* FPNodeArena::AllocateBlock(size_t aSize) {
+  void* block = ::operator new(aSize);
+  mBlocks.push_back(block);
+  sNumBlockAllocations++;
+  return block;
+}
+
+uint64_t FPNodeArena::NumBlockAllocations() {
+  return sNumBlockAllocations;
+}
+
+void* FPNodeArena::AllocateNode() {
+  if (mFreeNodes) {
+    FreeEntry* entry = mFreeNodes;
+    mFreeNodes = entry->next;
+    return entry;
+  }
+  if (mNodeCursor == mNodeEnd) {
+    if (mNextNodeBlock == mNodeBlocks.size()) {
+      const size_t size = mNextBlockNodes * sizeof(FPNode);
+      mNodeBlocks.push_back(Block{AllocateBlock(size), size});
+      if (mNextBlockNodes < kMaxBlockNodes) {
+        mNextBlockNodes *= 2;
+      }
+    }
+    const Block& block = mNodeBlocks[mNextNodeBlock++];
+    mNodeCursor = static_cast<char*>(block.memory);
+    mNodeEnd = mNodeCursor + block.size;
+  }
+  void* node = mNodeCursor;
+  mNodeCursor += sizeof(FPNode);
+  return node;
+}
+
+void FPNodeArena::FreeNode(FPNode* aNode) {
+  FreeEntry* entry = reinterpret_cast<FreeEntry*>(aNode);
+  entry->next = mFreeNodes;
+  mFreeNodes = entry;
+}
+
+FPNode** FPNodeArena::AllocateTable(unsigned aCapacity) {
+  const unsigned sizeClass = Log2(aCapacity);
+  ASSERT((1u << sizeClass) == aCapacity);
+  void* table = nullptr;
+  if (sizeClass < mFreeTables.size() && mFreeTables[sizeClass]) {
+    FreeEntry* entry = mFreeTables[sizeClass];
+    mFreeTables[sizeClass] = entry->next;
+    table = entry;
+  } else {
+    table = AllocateBlock(aCapacity * sizeof(FPNode*));
+    mTables.push_back(Block{table, aCapacity});
+  }
+  memset(table, 0, aCapacity * sizeof(FPNode*));
+  return static_cast<FPNode**>(table);
+}
+
+void FPNodeArena::FreeTable(FPNode** aTable, unsigned aCapacity) {
+  const unsigned sizeClass = Log2(aCapacity);
+  if (sizeClass >= mFreeTables.size()) {
+    mFreeTables.resize(sizeClass + 1, nullptr);
+  }
+  FreeEntry* entry = reinterpret_cast<FreeEntry*>(aTable);
+  entry->next = mFreeTables[sizeClass];
+  mFreeTables[sizeClass] = entry;
+}
+
+void FPNodeArena::Reset() {
+  mNextNodeBlock = 0;
+  mNodeCursor = nullptr;
+  mNodeEnd = nullptr;
+  mFreeNodes = nullptr;
+  for (FreeEntry*& list : mFreeTables) {
+    list = nullptr;
+  }
+  for (const Block& table : mTables) {
+    FreeTable(static_cast<FPNode**>(table.memory), static_cast<unsigned>(table.size));
+  }
+}
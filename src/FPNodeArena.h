@@ -0,0 +1,82 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class FPNode;
+
+// Allocates the nodes of an FPTree, and the child hash tables of its high
+// fan out nodes. Memory freed by the tree is recycled by later allocations,
+// and everything is released in bulk when the arena is destroyed, so freeing
+// a tree doesn't need to visit each of its nodes.
+class FPNodeArena {
+public:
+  FPNodeArena();
+  ~FPNodeArena();
+
+  // Returns uninitialized storage for one FPNode.
+  void* AllocateNode();
+  void FreeNode(FPNode* aNode);
+
+  // Returns a zeroed table of |aCapacity| node pointers. |aCapacity| must
+  // be a power of two.
+  FPNode** AllocateTable(unsigned aCapacity);
+  void FreeTable(FPNode** aTable, unsigned aCapacity);
+
+  // Makes all of the arena's memory available for allocation again, without
+  // returning it to the system. Anything allocated before is invalidated.
+  void Reset();
+
+  // Number of blocks allocated from the system by all arenas.
+  static uint64_t NumBlockAllocations();
+
+private:
+  FPNodeArena(const FPNodeArena&) = delete;
+  FPNodeArena& operator=(const FPNodeArena&) = delete;
+
+  void* AllocateBlock(size_t aSize);
+
+  struct FreeEntry {
+    FreeEntry* next;
+  };
+
+  struct Block {
+    void* memory;
+    size_t size;
+  };
+
+  std::vector<void*> mBlocks;
+
+  // Bump allocation region for nodes. Blocks grow geometrically, so that
+  // small conditional trees don't pay for large blocks. After a Reset(), the
+  // node blocks are bumped through again in order before any new block is
+  // allocated.
+  std::vector<Block> mNodeBlocks;
+  size_t mNextNodeBlock;
+  char* mNodeCursor;
+  char* mNodeEnd;
+  size_t mNextBlockNodes;
+  FreeEntry* mFreeNodes;
+
+  // Every table allocated, with its capacity as its size, so Reset() can
+  // return them all to the free lists.
+  std::vector<Block> mTables;
+
+  // Freed tables, indexed by log2 of their capacity.
+  std::vector<FreeEntry*> mFreeTables;
+};
@@ -0,0 +1,220 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "FPTree.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+#include "debug.h"
+#include "FPNode.h"
+#include "ItemSetTrie.h"
+#include "PatternStream.h"
+#include "utils.h"
+
+using namespace std;
+
+// Top-k frequent itemset mining. The recursion is FPGrowth's, but the k most
+// frequent itemsets found so far are kept in a min-heap rather than being
+// output as they're found. Once the heap is full, an itemset must have a
+// count greater than the least in the heap to be one of the k most frequent,
+// so the minimum count which the recursion and ConstructConditionalTree
+// prune with is raised to one more than that. Items are mined most frequent
+// first, so the heap fills with high counts, and the threshold rises, early.
+struct TopKMiner {
+  TopKMiner(unsigned aK, double aMinCount)
+    : k(aK),
+      minCount(aMinCount) {}
+
+  // Offers an itemset to the heap, raising minCount if the heap is full.
+  void Add(const vector<Item>& aItems, unsigned aCount);
+
+  unsigned k;
+  double minCount;
+  // Min-heap on count, of at most k (count, itemset) pairs.
+  vector<pair<unsigned, vector<Item>>> heap;
+};
+
+static bool HeapCmp(const pair<unsigned, vector<Item>>& a,
+                    const pair<unsigned, vector<Item>>& b) {
+  return a.first > b.first;
+}
+
+void TopKMiner::Add(const vector<Item>& aItems, unsigned aCount) {
+  if (aCount < minCount) {
+    return;
+  }
+  if (heap.size() < k) {
+    heap.push_back(make_pair(aCount, aItems));
+    push_heap(heap.begin(), heap.end(), HeapCmp);
+  } else {
+    ASSERT(aCount > heap.front().first);
+    pop_heap(heap.begin(), heap.end(), HeapCmp);
+    heap.back().first = aCount;
+    heap.back().second = aItems;
+    push_heap(heap.begin(), heap.end(), HeapCmp);
+  }
+  if (heap.size() == k) {
+    minCount = max(minCount, (double)heap.front().first + 1);
+  }
+}
+
+// Offers the itemsets made of aPrefix, aNode, and any of the nodes above
+// aNode in a single path up to but excluding aTop. These all have aNode's
+// count, so stop once the heap has no room for that count.
+static void AddNodeCombinations(const FPNode* aNode,
+                                const FPNode* aTop,
+                                vector<Item>& aPrefix,
+                                TopKMiner& aMiner) {
+  if (aNode->count < aMiner.minCount) {
+    return;
+  }
+  if (aTop == aNode) {
+    aMiner.Add(aPrefix, aNode->count);
+    return;
+  }
+  // Without aTop, then with it.
+  const FPNode* next = aTop->FirstChild();
+  AddNodeCombinations(aNode, next, aPrefix, aMiner);
+  aPrefix.push_back(aTop->item);
+  AddNodeCombinations(aNode, next, aPrefix, aMiner);
+  aPrefix.pop_back();
+}
+
+// Offers the itemsets in the single path starting at aTop, whose counts are
+// non-increasing down the path.
+static void AddTopKInPath(const FPNode* aTop,
+                          vector<Item>& aPrefix,
+                          TopKMiner& aMiner) {
+  for (const FPNode* n = aTop; n && n->count >= aMiner.minCount; n = n->FirstChild()) {
+    aPrefix.push_back(n->item);
+    AddNodeCombinations(n, aTop, aPrefix, aMiner);
+    aPrefix.pop_back();
+  }
+}
+
+static void MineTopK(FPTree* aTree, vector<Item>& aPrefix, TopKMiner& aMiner) {
+  if (aTree->HasSinglePath()) {
+    const FPNode* top = aTree->GetRoot()->FirstChild();
+    if (top) {
+      AddTopKInPath(top, aPrefix, aMiner);
+    }
+    return;
+  }
+
+  ItemMap<unsigned>& freq = aTree->FrequencyTable();
+  vector<Item> items;
+  ItemMap<FPNode*>::Iterator itr = aTree->HeaderTable().GetIterator();
+  while (itr.HasNext()) {
+    items.push_back(itr.GetKey());
+    itr.Next();
+  }
+  sort(items.begin(), items.end(), [&](const Item a, const Item b) {
+    return freq.Get(a) > freq.Get(b);
+  });
+
+  for (const Item item : items) {
+    const unsigned count = freq.Get(item);
+    // The remaining items are no more frequent, and the threshold only
+    // rises.
+    if (count < aMiner.minCount) {
+      break;
+    }
+    aPrefix.push_back(item);
+    aMiner.Add(aPrefix, count);
+    FPTree subtree;
+    ConstructConditionalTree(aTree->HeaderTable().Get(item), &subtree,
+                             aMiner.minCount, UINT32_MAX, nullptr);
+    if (!subtree.IsEmpty()) {
+      MineTopK(&subtree, aPrefix, aMiner);
+    }
+    aPrefix.pop_back();
+  }
+}
+
+// Mines the aK most frequent itemsets with count at least aMinCount in
+// aTree into aOutput, in non-increasing order of count. Returns the count
+// threshold the mining finished with.
+double MineTopKItemSets(FPTree* aTree,
+                        unsigned aK,
+                        double aMinCount,
+                        PatternOutputStream& aOutput) {
+  // The threshold rises as itemsets are found, so the tree is mined on one
+  // thread.
+  TopKMiner miner(aK, aMinCount);
+  vector<Item> prefix;
+  MineTopK(aTree, prefix, miner);
+
+  sort_heap(miner.heap.begin(), miner.heap.end(), HeapCmp);
+  for (const auto& itemset : miner.heap) {
+    aOutput.Write(itemset.second, itemset.first);
+  }
+  return miner.minCount;
+}
+
+void MineTopKFPTree(FPTree* fptree,
+                    unsigned k,
+                    double minSup,
+                    const std::string& itemSetsOuputFilename,
+                    const std::string& rulesOuputFilename,
+                    DataSet* index,
+                    bool countItemSetsOnly,
+                    bool countRulesOnly,
+                    unsigned numThreads) {
+  if (!fptree) {
+    return;
+  }
+
+  const double minCount = minSup * index->NumTransactions();
+  Log("minCount=%lf\n", minCount);
+
+  DurationTimer timer;
+
+  bool writeItemSets = !countItemSetsOnly;
+
+  PatternOutputStream output;
+  shared_ptr<ItemSetTrie> patterns;
+  if (writeItemSets) {
+    shared_ptr<ostream> stream = std::make_shared<std::ofstream>(itemSetsOuputFilename);
+    if (!stream->good()) {
+      cerr << "FAIL: Can't open " << itemSetsOuputFilename << " for PatternStreamWriter output!" << endl;
+      exit(-1);
+    }
+    output = PatternOutputStream(stream, index);
+    patterns = make_shared<ItemSetTrie>();
+    output.RecordPatterns(patterns);
+    output.UseMinedCounts();
+  }
+
+  const double finalMinCount = MineTopKItemSets(fptree, k, minCount, output);
+  output.Close();
+
+  Log("Top-k generated %lld itemsets in %.3lfs%s, raising minCount to %lf\n",
+      output.GetNumPatterns(), timer.Seconds(),
+      (!writeItemSets ? " (not saved to disk)" : ""), finalMinCount);
+
+  if (!writeItemSets) {
+    Log("Skipping rule generation because itemsets weren't saved to disk to generate from\n");
+  } else {
+    long numRules = 0;
+    Log("Generating rules...\n");
+    DurationTimer timer;
+    GenerateRules(*patterns, index->NumTransactions(), index, 0.9, 1.0,
+                  numRules, rulesOuputFilename, countRulesOnly, numThreads);
+    Log("Generated %d rules in %.3lfs...\n", numRules, timer.Seconds());
+  }
+  Log("-----------------------------------------------\n");
+}
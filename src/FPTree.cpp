@@ -14,6 +14,7 @@
 
 #include "FPTree.h"
 
+#include <algorithm>
 #include <time.h>
 #include <stdlib.h>
 #include <iostream>
@@ -24,6 +25,7 @@
 #include <math.h>
 #include "utils.h"
 #include "FPNode.h"
+#include "FrozenFPTree.h"
 #include "ItemSet.h"
 #include "InvertedDataSetIndex.h"
 #include "AprioriFilter.h"
@@ -34,9 +36,14 @@
 #include <sstream>
 #include "PatternStream.h"
 #include "WindowIndex.h"
+#include "ItemSetTrie.h"
 #include "DataSetReader.h"
 #include "DataStreamMining.h"
 #include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 #include "CanTreeFunctor.h"
 #include "CPTreeFunctor.h"
@@ -47,28 +54,19 @@
 
 using namespace std;
 
-// Comparison in non-increasing order of frequency, tie-breaking on appearance
-// in dataset order. i.e. items with higher frequency are considered "greater",
-// tie break so that items which were encountered earlier are considered "greater".
-struct FreqCmp : public ItemComparator {
-  FreqCmp(const ItemMap<unsigned>& f) : freq(f) {}
-  bool operator()(const Item a, const Item b) override {
-    ASSERT(freq.Contains(a));
-    ASSERT(freq.Contains(a));
-    return freq.Get(a) > freq.Get(b);
-  }
-  const ItemMap<unsigned>& freq;
-};
-
 void AddPatternsInPath(const FPNode* tree,
                        PatternOutputStream& output,
                        vector<Item>& pattern,
                        unsigned maxNodeDepth = UINT32_MAX,
-                       ItemFilter* filter = nullptr) {
+                       ItemFilter* filter = nullptr,
+                       double minCount = 0) {
   ASSERT(tree != 0);
   ASSERT(!tree->IsRoot());
 
-  if (tree->depth >= maxNodeDepth) {
+  // Counts don't increase down the path, so if this node is infrequent, so
+  // is everything below it. This only happens at the top level of cantree
+  // mode, whose tree can carry items below the minsup.
+  if (tree->depth >= maxNodeDepth || tree->count < minCount) {
     return;
   }
   // tODO: check in options that we're not using tree prunde depth and
@@ -78,8 +76,9 @@ void AddPatternsInPath(const FPNode* tree,
 
   if (shouldInclude) {
     pattern.push_back(tree->item);
-    // Record the pattern including this iten.
-    output.Write(pattern);
+    // Record the pattern including this iten. This node is the deepest in
+    // the pattern, so its count is the pattern's count.
+    output.Write(pattern, tree->count);
     pattern.pop_back();
   }
 
@@ -90,12 +89,12 @@ void AddPatternsInPath(const FPNode* tree,
   }
 
   // Recurse without adding this node's item to prefix.
-  AddPatternsInPath(child, output, pattern, maxNodeDepth, filter);
+  AddPatternsInPath(child, output, pattern, maxNodeDepth, filter, minCount);
 
   if (shouldInclude) {
     // Recurse with adding this node's item to prefix.
     pattern.push_back(tree->item);
-    AddPatternsInPath(child, output, pattern, maxNodeDepth, filter);
+    AddPatternsInPath(child, output, pattern, maxNodeDepth, filter, minCount);
     pattern.pop_back();
   }
 }
@@ -111,82 +110,333 @@ bool VerifySortedByAppearance(vector<Item>& txn) {
   return true;
 }
 
+FPGrowthScratch::FPGrowthScratch(bool aUseFPArrays)
+  : mTotal(0),
+    mUseFPArrays(aUseFPArrays) {
+}
+
+FPGrowthScratch::~FPGrowthScratch() {
+}
+
+FPTree* FPGrowthScratch::TreeAt(unsigned aDepth) {
+  if (aDepth < mTrees.size()) {
+    mTrees[aDepth]->Clear();
+    return mTrees[aDepth].get();
+  }
+  while (mTrees.size() <= aDepth) {
+    mTrees.push_back(unique_ptr<FPTree>(new FPTree()));
+  }
+  return mTrees[aDepth].get();
+}
+
+void FPGrowthScratch::InsertPath(FPTree* aTree, unsigned aCount) {
+  // Sort the items in non-increasing order of frequency in the conditional
+  // pattern base. Items of equal frequency must keep their order in the
+  // parent tree, or an itemset's count can be split between branches of
+  // the conditional tree which the mining never recombines. Paths are
+  // short and nearly sorted already, so a stable insertion sort suits, and
+  // unlike std::stable_sort doesn't allocate.
+  for (size_t k = 1; k < mPath.size(); k++) {
+    const Item item = mPath[k];
+    const unsigned itemCount = mFreq[item.GetIndex()];
+    size_t m = k;
+    for (; m > 0 && mFreq[mPath[m - 1].GetIndex()] < itemCount; m--) {
+      mPath[m] = mPath[m - 1];
+    }
+    mPath[m] = item;
+  }
+  aTree->Insert(mPath, aCount);
+}
+
+void FPGrowthScratch::MaybeEnableFPArray(FPTree* aTree) {
+  if (mUseFPArrays && mKept.size() > 1 && mKept.size() <= kMaxFPArrayItems) {
+    aTree->EnableFPArray(mKept);
+  }
+}
+
+void FPGrowthScratch::ResetFreq() {
+  for (const Item item : mTouched) {
+    mFreq[item.GetIndex()] = 0;
+  }
+  mTouched.clear();
+}
+
+void FPGrowthScratch::Build(FPTree* aTree, double aMinCount, vector<Item>* aClosure) {
+  // Items on every path are in the closure, and are left out of the tree.
+  if (aClosure) {
+    sort(mTouched.begin(), mTouched.end(), AppearanceCmp());
+    for (const Item item : mTouched) {
+      if (mFreq[item.GetIndex()] == mTotal) {
+        aClosure->push_back(item);
+      }
+    }
+  }
+
+  mKept.clear();
+  for (const Item item : mTouched) {
+    const unsigned itemCount = mFreq[item.GetIndex()];
+    if (itemCount >= aMinCount && !(aClosure && itemCount == mTotal)) {
+      mKept.push_back(item);
+    } else {
+      mFreq[item.GetIndex()] = 0;
+    }
+  }
+  if (!aClosure) {
+    MaybeEnableFPArray(aTree);
+  }
+
+  // The items left out now have zero frequency.
+  uint32_t begin = 0;
+  for (size_t i = 0; i < mPathEnds.size(); i++) {
+    // The path was recorded leaf to root.
+    mPath.clear();
+    for (uint32_t j = mPathEnds[i]; j-- > begin;) {
+      const Item item = mPathItems[j];
+      if (mFreq[item.GetIndex()]) {
+        mPath.push_back(item);
+      }
+    }
+    begin = mPathEnds[i];
+    InsertPath(aTree, mPathCounts[i]);
+  }
+
+  ResetFreq();
+  mTotal = 0;
+  mPathItems.clear();
+  mPathEnds.clear();
+  mPathCounts.clear();
+}
+
+void FPGrowthScratch::BuildFromFPArray(FPTree& aParent,
+                                       Item aItem,
+                                       FPTree* aTree,
+                                       double aMinCount) {
+  ASSERT(aParent.HasFPArray());
+  const vector<Item>& items = aParent.FPArrayItems();
+  const unsigned* row = aParent.FPArrayRow(aItem);
+  mKept.clear();
+  for (size_t j = 0; j < items.size(); j++) {
+    if (row[j] && row[j] >= aMinCount) {
+      EnsureFreqSize(items[j]);
+      mFreq[items[j].GetIndex()] = row[j];
+      mTouched.push_back(items[j]);
+      mKept.push_back(items[j]);
+    }
+  }
+  if (mKept.empty()) {
+    return;
+  }
+  MaybeEnableFPArray(aTree);
+
+  for (const FPNode* n = aParent.HeaderTable().Get(aItem); n; n = n->next) {
+    mPath.clear();
+    for (const FPNode* p = n->parent; !p->IsRoot(); p = p->parent) {
+      const uint32_t index = p->item.GetIndex();
+      if (index < mFreq.size() && mFreq[index]) {
+        mPath.push_back(p->item);
+      }
+    }
+    reverse(mPath.begin(), mPath.end());
+    InsertPath(aTree, n->count);
+  }
+  ResetFreq();
+}
+
 void ConstructConditionalTree(const FPNode* node,
                               FPTree* tree,
                               double minCount,
-                              unsigned nodePruneDepth = std::numeric_limits<unsigned>::max()) {
+                              unsigned nodePruneDepth,
+                              vector<Item>* closure,
+                              FPGrowthScratch& scratch) {
   // Create a "projection" of the database, where we only have itemsets
   // from the conditional pattern base in it. We need to count frequencies
-  // of all items in the conditional pattern base for this.
-  ItemMap<unsigned> freq;
-
-  const FPNode* n = node;
-  while (n) {
+  // of all items in the conditional pattern base for this, so each path is
+  // recorded as it's counted, and the tree is built from the record rather
+  // than by walking the paths again.
+  for (const FPNode* n = node; n; n = n->next) {
     if (n->depth >= nodePruneDepth) {
-      n = n->next;
       continue;
     }
-    #ifdef _DEBUG
-    string s = n->item;
-    #endif
-    unsigned count = n->count;
-    //freq[n->item] += count;
-    // Determine the items which are in this path.
-    FPNode* p = n->parent;
-    #ifdef _DEBUG
-    string ps = p ? (string)p->item : "N/A";
-    #endif
-    while (p && !p->IsRoot()) {
-      freq.Set(p->item, freq.Get(p->item, 0) + count);
-      p = p->parent;
+    const unsigned count = n->count;
+    for (const FPNode* p = n->parent; p && !p->IsRoot(); p = p->parent) {
+      scratch.AddToPath(p->item, count);
     }
-    n = n->next;
+    scratch.EndPath(count);
   }
+  scratch.Build(tree, minCount, closure);
+}
 
-  // For each node in the headerTable (that is, for each instance of the
-  // item in the tree).
-  FreqCmp cmp(freq);
-  while (node) {
-    if (node->depth >= nodePruneDepth) {
-      node = node->next;
-      continue;
-    }
-    #ifdef _DEBUG
-    string s = node->item;
-    #endif
-    // Determine the items which are in this path.
-    FPNode* p = node->parent;
-    unsigned count = node->count;
-    vector<Item> path;
-    while (p && !p->IsRoot()) {
-      #ifdef _DEBUG
-      string ps = p->item;
-      #endif
-      if (freq.Get(p->item, 0) >= minCount) {
-        path.insert(path.begin(), p->item);
-      }
-      p = p->parent;
-    }
+void ConstructConditionalTree(const FPNode* node,
+                              FPTree* tree,
+                              double minCount,
+                              unsigned nodePruneDepth,
+                              vector<Item>* closure) {
+  FPGrowthScratch scratch;
+  ConstructConditionalTree(node, tree, minCount, nodePruneDepth, closure, scratch);
+}
 
-    // Ensure items are sorted in non-increasing order of frequency, as
-    // it's recorded in the freq table (the projection of the database).
-    sort(path.begin(), path.end(), cmp);
+void ConstructConditionalTree(const FPNode* node,
+                              FPTree* tree,
+                              double minCount,
+                              unsigned nodePruneDepth = std::numeric_limits<unsigned>::max()) {
+  ConstructConditionalTree(node, tree, minCount, nodePruneDepth, nullptr);
+}
 
-    // Add them to the new tree.
-    tree->Insert(path, count);
+// How many chain entries ahead of the one being walked to prefetch.
+static const unsigned kChainPrefetchDistance = 8;
 
-    node = node->next;
+void ConstructConditionalTree(const FrozenFPTree& frozen,
+                              unsigned headerIndex,
+                              FPTree* tree,
+                              double minCount,
+                              unsigned nodePruneDepth,
+                              FPGrowthScratch& scratch) {
+  const uint32_t* end = frozen.ChainEnd(headerIndex);
+  for (const uint32_t* n = frozen.ChainBegin(headerIndex); n != end; n++) {
+    if (n + kChainPrefetchDistance < end) {
+      frozen.Prefetch(n[kChainPrefetchDistance]);
+    }
+    if (frozen.Depth(*n) >= nodePruneDepth) {
+      continue;
+    }
+    const unsigned count = frozen.Count(*n);
+    for (uint32_t p = frozen.Parent(*n); p != 0; p = frozen.Parent(p)) {
+      scratch.AddToPath(frozen.GetItem(p), count);
+    }
+    scratch.EndPath(count);
   }
+  scratch.Build(tree, minCount, nullptr);
 }
 
 void FPGrowth(FPTree* tree,
               PatternOutputStream& output,
               vector<Item>& pattern,
-              DataSet* index,
               const double minCount,
               unsigned nodePruneDepth = std::numeric_limits<unsigned>::max(),
               ItemFilter* = nullptr);
 
+// As above, with the conditional trees built in |scratch|'s tree for the
+// depth of the recursion, which is the size of |pattern|.
+void FPGrowth(FPTree* tree,
+              PatternOutputStream& output,
+              vector<Item>& pattern,
+              const double minCount,
+              unsigned nodePruneDepth,
+              ItemFilter* filter,
+              FPGrowthScratch& scratch);
+
+// Mines |tree| with the items in its header table shared out amongst
+// |numThreads| worker threads. Unless it's a single path, the tree is first
+// frozen into a FrozenFPTree, and the top level conditional trees are
+// constructed from that, into the first tree of the worker's FPGrowthScratch.
+// Each worker reuses that tree for every item it mines, and mines it as an
+// FPTree, with the deeper conditional trees in the scratch's later trees.
+// Each item's conditional tree is constructed and mined by one worker into
+// its own forked output stream, and the forked streams are joined back into
+// |output| in header table order, so the output is the same as that of a
+// single threaded FPGrowth().
+void ParallelFPGrowth(FPTree* tree,
+                      PatternOutputStream& output,
+                      const double minCount,
+                      unsigned nodePruneDepth,
+                      ItemFilter* filter,
+                      unsigned numThreads) {
+  ASSERT(tree != 0);
+  if (tree->HasSinglePath()) {
+    vector<Item> pattern;
+    FPGrowth(tree, output, pattern, minCount, nodePruneDepth, filter);
+    return;
+  }
+
+  const FrozenFPTree frozen(*tree);
+
+  // Determine the items which have conditional trees to mine up front, so
+  // that the workers can claim them by index.
+  vector<unsigned> tasks;
+  for (unsigned i = 0; i < frozen.NumHeaderItems(); i++) {
+    const Item item = frozen.HeaderItem(i);
+    if (filter && !filter->ShouldKeep(item)) {
+      continue;
+    }
+    // For cantree mode, we can have items in the header table which don't
+    // reach the minsup, so we must avoid creating conditional trees for
+    // them here. The tree's own counts are exact, so the data set needn't
+    // be consulted.
+    if (frozen.HeaderFrequency(i) < minCount) {
+      continue;
+    }
+    tasks.push_back(i);
+  }
+
+  auto mine = [&](unsigned headerIndex,
+                  PatternOutputStream& sink,
+                  vector<Item>& pattern,
+                  FPGrowthScratch& scratch) {
+    FPTree* subtree = scratch.TreeAt(0);
+    ConstructConditionalTree(frozen, headerIndex, subtree, minCount, nodePruneDepth, scratch);
+    pattern.push_back(frozen.HeaderItem(headerIndex));
+    sink.Write(pattern, frozen.HeaderFrequency(headerIndex));
+    if (!subtree->IsEmpty()) {
+      FPGrowth(subtree, sink, pattern, minCount, nodePruneDepth, filter, scratch);
+    }
+    pattern.pop_back();
+  };
+
+  if (numThreads < 2) {
+    vector<Item> pattern;
+    FPGrowthScratch scratch(nodePruneDepth == UINT32_MAX);
+    for (unsigned headerIndex : tasks) {
+      mine(headerIndex, output, pattern, scratch);
+    }
+    return;
+  }
+
+  vector<PatternOutputStream> sinks;
+  sinks.reserve(tasks.size());
+  for (unsigned i = 0; i < tasks.size(); i++) {
+    sinks.push_back(output.Fork());
+  }
+
+  // The workers only read from |frozen|; each conditional tree they create
+  // is private to the worker which created it.
+  atomic<unsigned> nextTask(0);
+  vector<bool> finished(tasks.size(), false);
+  mutex finishedLock;
+  condition_variable finishedCondition;
+  auto worker = [&]() {
+    vector<Item> pattern;
+    FPGrowthScratch scratch(nodePruneDepth == UINT32_MAX);
+    unsigned task;
+    while ((task = nextTask++) < tasks.size()) {
+      mine(tasks[task], sinks[task], pattern, scratch);
+
+      lock_guard<mutex> lock(finishedLock);
+      finished[task] = true;
+      finishedCondition.notify_one();
+    }
+  };
+
+  vector<thread> workers;
+  for (unsigned i = 0; i < numThreads; i++) {
+    workers.push_back(thread(worker));
+  }
+
+  // Join the workers' output in order as it becomes available, so we don't
+  // need to buffer every item's patterns until all workers are finished.
+  for (unsigned task = 0; task < tasks.size(); task++) {
+    {
+      unique_lock<mutex> lock(finishedLock);
+      finishedCondition.wait(lock, [&]() { return finished[task]; });
+    }
+    output.Join(sinks[task]);
+    sinks[task] = PatternOutputStream();
+  }
+
+  for (thread& t : workers) {
+    t.join();
+  }
+}
+
 void MineFPTree(FPTree* fptree,
                 double minSup,
                 const std::string& itemSetsOuputFilename,
@@ -195,7 +445,9 @@ void MineFPTree(FPTree* fptree,
                 uint32_t treePruneDepth,
                 bool countItemSetsOnly,
                 bool countRulesOnly,
-                ItemFilter* filter) {
+                unsigned numThreads,
+                ItemFilter* filter,
+                bool treeMatchesDataSet) {
   if (!fptree) {
     return;
   }
@@ -208,6 +460,7 @@ void MineFPTree(FPTree* fptree,
   bool writeItemSets = !countItemSetsOnly;
 
   PatternOutputStream output;
+  shared_ptr<ItemSetTrie> patterns;
   if (writeItemSets) {
     shared_ptr<ostream> stream = std::make_shared<std::ofstream>(itemSetsOuputFilename);
     if (!stream->good()) {
@@ -215,25 +468,34 @@ void MineFPTree(FPTree* fptree,
       exit(-1);
     }
     output = move(PatternOutputStream(stream, index));
+    // Keep the patterns and their counts in memory for rule generation.
+    patterns = make_shared<ItemSetTrie>();
+    output.RecordPatterns(patterns);
+    // The counts in a pruned tree are only lower bounds, and the item
+    // filter may drop items from the middle of a pattern.
+    if (treeMatchesDataSet && treePruneDepth == UINT32_MAX && !filter) {
+      output.UseMinedCounts();
+    }
   }
 
-  vector<Item> pattern;
-  FPGrowth(fptree, output, pattern, index, minCount, treePruneDepth, filter);
+  const uint64_t blockAllocations = FPNodeArena::NumBlockAllocations();
+  ParallelFPGrowth(fptree, output, minCount, treePruneDepth, filter, numThreads);
   output.Close();
 
   Log("FPGrowth generated %lld patterns in %.3lfs%s\n",
       output.GetNumPatterns(), timer.Seconds(),
       (!writeItemSets ? " (not saved to disk)" : ""));
+  Log("FPGrowth made %llu tree memory allocations\n",
+      (unsigned long long)(FPNodeArena::NumBlockAllocations() - blockAllocations));
 
   if (!writeItemSets) {
     Log("Skipping rule generation because itemsets weren't saved to disk to generate from\n");
   } else {
     long numRules = 0;
-    PatternInputStream input(make_shared<ifstream>(itemSetsOuputFilename));
-    ASSERT(input.IsOpen());
     Log("Generating rules...\n");
     DurationTimer timer;
-    GenerateRules(input, 0.9, 1.0, numRules, index, rulesOuputFilename, countRulesOnly);
+    GenerateRules(*patterns, index->NumTransactions(), index, 0.9, 1.0,
+                  numRules, rulesOuputFilename, countRulesOnly, numThreads);
     Log("Generated %d rules in %.3lfs...\n", numRules, timer.Seconds());
   }
   Log("-----------------------------------------------\n");
@@ -242,15 +504,25 @@ void MineFPTree(FPTree* fptree,
 void FPGrowth(FPTree* tree,
               PatternOutputStream& output,
               vector<Item>& pattern,
-              DataSet* index,
               const double minCount,
               unsigned nodePruneDepth,
               ItemFilter* filter) {
+  FPGrowthScratch scratch(nodePruneDepth == UINT32_MAX);
+  FPGrowth(tree, output, pattern, minCount, nodePruneDepth, filter, scratch);
+}
+
+void FPGrowth(FPTree* tree,
+              PatternOutputStream& output,
+              vector<Item>& pattern,
+              const double minCount,
+              unsigned nodePruneDepth,
+              ItemFilter* filter,
+              FPGrowthScratch& scratch) {
   ASSERT(tree != 0);
   if (tree->HasSinglePath()) {
     FPNode* t = tree->GetRoot()->FirstChild();
     if (t) {
-      AddPatternsInPath(t, output, pattern, nodePruneDepth, filter);
+      AddPatternsInPath(t, output, pattern, nodePruneDepth, filter, minCount);
     }
   } else {
     // For each item in the nodelist, construct a new tree, minus the item.
@@ -271,25 +543,30 @@ void FPGrowth(FPTree* tree,
       // For cantree mode, we can have items in the header table which don't
       // reach the minsup, so we must avoid creating conditional trees for
       // them here.
-      if (index->Count(item) < minCount) {
+      const unsigned itemCount = tree->FrequencyTable().Get(item, 0);
+      if (itemCount < minCount) {
         continue;
       }
 
-      // Construct a new conditional tree.
-      FPTree* subtree = new FPTree();
+      // Construct a new conditional tree, reusing the one last built at
+      // this depth.
+      FPTree* subtree = scratch.TreeAt(static_cast<unsigned>(pattern.size()));
 
       // Note: we don't pass the ItemFilter to ConstructConditionalTree, as we
       // assume that anything above |item| in the tree also will be signalled to
       // be kept by the filter.
-      ConstructConditionalTree(node, subtree, minCount, nodePruneDepth);
+      if (tree->HasFPArray()) {
+        scratch.BuildFromFPArray(*tree, item, subtree, minCount);
+      } else {
+        ConstructConditionalTree(node, subtree, minCount, nodePruneDepth, nullptr, scratch);
+      }
       pattern.push_back(item);
-      output.Write(pattern);
+      output.Write(pattern, itemCount);
       if (!subtree->IsEmpty()) {
         // Recurse.
-        FPGrowth(subtree, output, pattern, index, minCount, nodePruneDepth, filter);
+        FPGrowth(subtree, output, pattern, minCount, nodePruneDepth, filter, scratch);
       }
       pattern.pop_back();
-      delete subtree;
     }
 
   }
@@ -301,6 +578,9 @@ void FPGrowth(FPTree* tree,
 LoadFunctor* CreateLoadFunctor(DataSet* index, FPTree* fptree, Options& options) {
   switch (options.mode) {
     case kFPTree:
+    case kFPClose:
+    case kFPMax:
+    case kTopK:
       return new FPTreeFunctor(fptree,
                                options.logTreeTxn,
                                0,
@@ -420,12 +700,13 @@ void FPTreeMiner(Options& options) {
 
   Log("\nLoading dataset into tree...\n");
   AutoPtr<DataSet> index = 0;
-  auto reader = make_unique<DataSetReader>(make_unique<ifstream>(options.inputFileName));
+  auto reader = OpenDataSetReader(options.inputFileName, options.pipelineIngest);
   if (isStreaming) {
     index = new WindowIndex(move(reader), NULL, options.blockSize);
   } else {
     index = new InvertedDataSetIndex(move(reader));
   }
+  index->EnableCountCache((size_t)options.countCacheMB << 20);
   FPTree* fptree = CreateFPTree(index, options);
   if (!fptree) {
     return;
@@ -446,7 +727,27 @@ void FPTreeMiner(Options& options) {
   string itemSetsOuputFilename = GetOutputItemsetsFileName(options.outputFilePrefix);
   string rulesOutputFilename = GetOutputRuleFileName(options.outputFilePrefix);
 
-  if (!isStreaming) {
+  if (options.mode == kFPClose || options.mode == kFPMax) {
+    MineClosedFPTree(fptree,
+                     options.minSup,
+                     options.mode == kFPMax,
+                     itemSetsOuputFilename,
+                     rulesOutputFilename,
+                     index,
+                     options.countItemSetsOnly,
+                     options.countRulesOnly,
+                     options.numThreads);
+  } else if (options.mode == kTopK) {
+    MineTopKFPTree(fptree,
+                   options.topK,
+                   options.minSup,
+                   itemSetsOuputFilename,
+                   rulesOutputFilename,
+                   index,
+                   options.countItemSetsOnly,
+                   options.countRulesOnly,
+                   options.numThreads);
+  } else if (!isStreaming) {
     // In the streaming case we mine during load. In the non streaming case
     // we need to mine at the end of loading the data set.
     MineFPTree(fptree,
@@ -456,7 +757,10 @@ void FPTreeMiner(Options& options) {
                index,
                options.treePruneDepth,
                options.countItemSetsOnly,
-               options.countRulesOnly);
+               options.countRulesOnly,
+               options.numThreads,
+               nullptr,
+               true);
   }
   delete fptree;
 }
@@ -481,6 +785,13 @@ void TreeMetricsLogger::OnTxn() {
   }
 }
 
+// Modes whose tree is sorted by the frequencies counted in a pass of the
+// data set before loading.
+static bool SortsByInitialFrequency(eRunModeType aMode) {
+  return aMode == kFPTree || aMode == kFPClose || aMode == kFPMax ||
+         aMode == kTopK;
+}
+
 FPTreeFunctor::FPTreeFunctor(FPTree* aTree,
                              const std::vector<unsigned>& aTxnNums,
                              int aBlockSize,
@@ -498,11 +809,15 @@ FPTreeFunctor::FPTreeFunctor(FPTree* aTree,
 }
 
 void FPTreeFunctor::OnStartLoad(unique_ptr<DataSetReader>& aReader) {
-  if (mOptions.mode != kFPTree) {
+  if (!SortsByInitialFrequency(mOptions.mode)) {
     return;
   }
 
-  // Make a pass of the data set to determine item frequencies.
+  // Binary data sets store the item frequencies up front, otherwise make a
+  // pass of the data set to determine them.
+  if (aReader->GetItemFrequencies(mInitialFrequencyTable)) {
+    return;
+  }
   vector<Item> transaction;
   mInitialFrequencyTable.Clear();
   aReader->Rewind();
@@ -517,7 +832,7 @@ void FPTreeFunctor::OnStartLoad(unique_ptr<DataSetReader>& aReader) {
 void FPTreeFunctor::OnLoad(const std::vector<Item>& txn) {
   mLogger.OnTxn();
 
-  if (mOptions.mode == kFPTree) {
+  if (SortsByInitialFrequency(mOptions.mode)) {
     // Sort in non-increasing order by (pre-determined) item frequency.
     auto transaction = txn;
 
@@ -525,8 +840,12 @@ void FPTreeFunctor::OnLoad(const std::vector<Item>& txn) {
       Comparator(const ItemMap<unsigned>& f) : freq(f) {}
       bool operator()(const Item a, const Item b) {
         assert(freq.Contains(a));
-        assert(freq.Contains(a));
-        return freq.Get(a) > freq.Get(b);
+        assert(freq.Contains(b));
+        // Tie break on id, so that every transaction is inserted in the
+        // same order.
+        const unsigned fa = freq.Get(a);
+        const unsigned fb = freq.Get(b);
+        return fa > fb || (fa == fb && a.GetId() < b.GetId());
       }
       const ItemMap<unsigned>& freq;
     };
@@ -551,6 +870,7 @@ void FPTreeFunctor::OnLoad(const std::vector<Item>& txn) {
                mOptions.treePruneDepth,
                mOptions.countItemSetsOnly,
                mOptions.countRulesOnly,
+               mOptions.numThreads,
                GetItemFilter());
   }
 }
@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include <memory>
 #include <vector>
 
 #include "InvertedDataSetIndex.h" // For LoadFunctor
@@ -91,7 +92,156 @@ void MineFPTree(FPTree* fptree,
                 uint32_t treePruneDepth,
                 bool countItemSetsOnly,
                 bool countRulesOnly,
-                ItemFilter* filter = nullptr);
+                unsigned numThreads = 1,
+                ItemFilter* filter = nullptr,
+                // True if fptree holds exactly the transactions in index,
+                // so the counts FPGrowth finds are the patterns' counts.
+                bool treeMatchesDataSet = false);
+
+// Mines the closed (or if maximal is true, the maximal) frequent itemsets
+// in fptree, which must be sorted in non-increasing order of frequency with
+// ties broken on item id, as kFPTree mode builds it.
+void MineClosedFPTree(FPTree* fptree,
+                      double minSup,
+                      bool maximal,
+                      const std::string& itemSetsOuputFilename,
+                      const std::string& rulesOuputFilename,
+                      DataSet* index,
+                      bool countItemSetsOnly,
+                      bool countRulesOnly,
+                      unsigned numThreads);
+
+// Mines the k most frequent itemsets in fptree with support at least
+// minSup. fptree must be sorted in non-increasing order of frequency, as
+// kFPTree mode builds it.
+void MineTopKFPTree(FPTree* fptree,
+                    unsigned k,
+                    double minSup,
+                    const std::string& itemSetsOuputFilename,
+                    const std::string& rulesOuputFilename,
+                    DataSet* index,
+                    bool countItemSetsOnly,
+                    bool countRulesOnly,
+                    unsigned numThreads);
+
+// Working memory for constructing conditional trees, and the conditional
+// trees of each depth of the FP-Growth recursion. Reusing one of these for
+// all the conditional trees a thread builds means mining stops allocating
+// once the buffers have grown to fit.
+//
+// If aUseFPArrays is true, the conditional trees built with few enough items
+// for their FP-array to fit in cache keep one, and their own conditional
+// trees can be built with BuildFromFPArray(). The FP-array counts whole
+// paths, so this can't be used when the mining prunes nodes by depth.
+class FPGrowthScratch {
+public:
+  explicit FPGrowthScratch(bool aUseFPArrays = false);
+  ~FPGrowthScratch();
+
+  // Returns the empty conditional tree for recursion depth aDepth. Only one
+  // tree per depth is live at a time, so the tree for aDepth is cleared and
+  // reused from the last time it was returned.
+  FPTree* TreeAt(unsigned aDepth);
+
+  // Records that aItem is in the path of the conditional pattern base
+  // currently being added. Paths are added leaf to root.
+  void AddToPath(Item aItem, unsigned aCount);
+
+  // Finishes the current path, whose count is aCount.
+  void EndPath(unsigned aCount);
+
+  // Inserts the recorded paths into aTree, keeping only the items with a
+  // count in the conditional pattern base of at least aMinCount. If aClosure
+  // is non-null, items on every path are appended to it instead. Resets the
+  // recorded paths.
+  void Build(FPTree* aTree, double aMinCount, std::vector<Item>* aClosure);
+
+  // Builds in aTree the conditional tree of aItem in aParent, which must
+  // have an FP-array. The items' frequencies are read from the FP-array, so
+  // the paths are walked once, and not at all if no item is frequent.
+  void BuildFromFPArray(FPTree& aParent, Item aItem, FPTree* aTree, double aMinCount);
+
+private:
+  // Largest number of items for which a conditional tree keeps an FP-array;
+  // the array of this many items' counts fills 256KB.
+  static const unsigned kMaxFPArrayItems = 256;
+
+  void EnsureFreqSize(Item aItem) {
+    if (aItem.GetIndex() >= mFreq.size()) {
+      mFreq.resize(aItem.GetIndex() + 1, 0);
+    }
+  }
+
+  // Sorts mPath, which has aTree's items in their order in the parent tree,
+  // by frequency, and inserts it into aTree.
+  void InsertPath(FPTree* aTree, unsigned aCount);
+
+  // Starts aTree's FP-array with the items in mKept, if wanted and small
+  // enough.
+  void MaybeEnableFPArray(FPTree* aTree);
+
+  // Resets the frequencies of the items in mTouched.
+  void ResetFreq();
+
+  FPGrowthScratch(const FPGrowthScratch&) = delete;
+  FPGrowthScratch& operator=(const FPGrowthScratch&) = delete;
+
+  std::vector<std::unique_ptr<FPTree>> mTrees;
+
+  // Count of each item in the conditional pattern base, indexed by item
+  // index. The items with non-zero counts are listed in mTouched, so only
+  // they need to be reset.
+  std::vector<unsigned> mFreq;
+  std::vector<Item> mTouched;
+  unsigned mTotal;
+
+  // Whether the conditional trees built get FP-arrays.
+  bool mUseFPArrays;
+
+  // The recorded paths' items, one path after another, with the end offset
+  // and count of each path.
+  std::vector<Item> mPathItems;
+  std::vector<uint32_t> mPathEnds;
+  std::vector<unsigned> mPathCounts;
+
+  std::vector<Item> mPath;
+
+  // The items which will be in the tree being built.
+  std::vector<Item> mKept;
+};
+
+inline void FPGrowthScratch::AddToPath(Item aItem, unsigned aCount) {
+  EnsureFreqSize(aItem);
+  const uint32_t index = aItem.GetIndex();
+  if (mFreq[index] == 0 && aCount) {
+    mTouched.push_back(aItem);
+  }
+  mFreq[index] += aCount;
+  mPathItems.push_back(aItem);
+}
+
+inline void FPGrowthScratch::EndPath(unsigned aCount) {
+  mPathEnds.push_back(static_cast<uint32_t>(mPathItems.size()));
+  mPathCounts.push_back(aCount);
+  mTotal += aCount;
+}
+
+// Builds in tree the conditional tree of the item whose header table chain
+// starts at node. If closure is non-null, the items which are in every path
+// of the conditional pattern base are appended to it, and left out of the
+// tree.
+void ConstructConditionalTree(const FPNode* node,
+                              FPTree* tree,
+                              double minCount,
+                              unsigned nodePruneDepth,
+                              std::vector<Item>* closure);
+
+void ConstructConditionalTree(const FPNode* node,
+                              FPTree* tree,
+                              double minCount,
+                              unsigned nodePruneDepth,
+                              std::vector<Item>* closure,
+                              FPGrowthScratch& scratch);
 
 void FPTreeMiner(Options& options);
 void Test_FPTree();
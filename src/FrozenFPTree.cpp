@@ -0,0 +1,71 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "FrozenFPTree.h"
+
+#include <utility>
+
+#include "FPNode.h"
+#include "ItemMap.h"
+
+using namespace std;
+
+FrozenFPTree::FrozenFPTree(FPTree& aTree) {
+  // Number the nodes in preorder. The stack holds each node to visit with
+  // its parent's number.
+  vector<pair<const FPNode*, uint32_t>> stack;
+  stack.push_back(make_pair(aTree.GetRoot(), 0));
+  while (!stack.empty()) {
+    const FPNode* node = stack.back().first;
+    const uint32_t parent = stack.back().second;
+    stack.pop_back();
+    const uint32_t number = static_cast<uint32_t>(mParents.size());
+    mParents.push_back(parent);
+    mItems.push_back(node->item);
+    mCounts.push_back(node->count);
+    mDepths.push_back(node->depth);
+    for (const FPNode* child : node->children) {
+      stack.push_back(make_pair(child, number));
+    }
+  }
+
+  ItemMap<unsigned> slots;
+  ItemMap<FPNode*>::Iterator itr = aTree.HeaderTable().GetIterator();
+  while (itr.HasNext()) {
+    const Item item = itr.GetKey();
+    slots.Set(item, static_cast<unsigned>(mHeaderItems.size()));
+    mHeaderItems.push_back(item);
+    mHeaderFrequencies.push_back(aTree.FrequencyTable().Get(item, 0));
+    itr.Next();
+  }
+
+  // Lay the chains out one after another by counting sort on header slot,
+  // which keeps each chain in preorder.
+  mHeaderOffsets.assign(mHeaderItems.size() + 1, 0);
+  for (uint32_t n = 1; n < NumNodes(); n++) {
+    if (slots.Contains(mItems[n])) {
+      mHeaderOffsets[slots.Get(mItems[n]) + 1]++;
+    }
+  }
+  for (unsigned i = 0; i < mHeaderItems.size(); i++) {
+    mHeaderOffsets[i + 1] += mHeaderOffsets[i];
+  }
+  mHeaderNodes.resize(mHeaderOffsets.back());
+  vector<uint32_t> cursors(mHeaderOffsets.begin(), mHeaderOffsets.end() - 1);
+  for (uint32_t n = 1; n < NumNodes(); n++) {
+    if (slots.Contains(mItems[n])) {
+      mHeaderNodes[cursors[slots.Get(mItems[n])]++] = n;
+    }
+  }
+}
@@ -0,0 +1,113 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "Item.h"
+
+class FPTree;
+
+#if defined(__GNUC__)
+#define HARM_PREFETCH(addr) __builtin_prefetch(addr)
+#elif defined(_MSC_VER)
+#include <xmmintrin.h>
+#define HARM_PREFETCH(addr) _mm_prefetch(reinterpret_cast<const char*>(addr), _MM_HINT_T0)
+#else
+#define HARM_PREFETCH(addr)
+#endif
+
+// A read only snapshot of an FPTree, laid out for the mining phase. An
+// FPTree's nodes are scattered across its arena in the order they were
+// created, and walking a conditional pattern base chases a pointer per node.
+// Here the nodes are numbered in preorder, and their parents, items, counts
+// and depths are stored in parallel arrays indexed by node number, so a walk
+// up a path only touches those columns, and moves towards the front of them.
+// Each header table chain is a contiguous list of node numbers in preorder.
+//
+// The root is node 0, and is its own parent.
+class FrozenFPTree {
+public:
+  explicit FrozenFPTree(FPTree& aTree);
+
+  // Number of nodes, including the root.
+  uint32_t NumNodes() const {
+    return static_cast<uint32_t>(mParents.size());
+  }
+
+  uint32_t Parent(uint32_t aNode) const {
+    return mParents[aNode];
+  }
+
+  Item GetItem(uint32_t aNode) const {
+    return mItems[aNode];
+  }
+
+  unsigned Count(uint32_t aNode) const {
+    return mCounts[aNode];
+  }
+
+  unsigned Depth(uint32_t aNode) const {
+    return mDepths[aNode];
+  }
+
+  // The items in the tree's header table, in the header table's iteration
+  // order.
+  unsigned NumHeaderItems() const {
+    return static_cast<unsigned>(mHeaderItems.size());
+  }
+
+  Item HeaderItem(unsigned aIndex) const {
+    return mHeaderItems[aIndex];
+  }
+
+  // The tree's frequency table entry for the header item at aIndex.
+  unsigned HeaderFrequency(unsigned aIndex) const {
+    return mHeaderFrequencies[aIndex];
+  }
+
+  // The nodes of the header item at aIndex, in preorder.
+  const uint32_t* ChainBegin(unsigned aIndex) const {
+    return mHeaderNodes.data() + mHeaderOffsets[aIndex];
+  }
+
+  const uint32_t* ChainEnd(unsigned aIndex) const {
+    return mHeaderNodes.data() + mHeaderOffsets[aIndex + 1];
+  }
+
+  // Hints that the columns of aNode will be read soon.
+  void Prefetch(uint32_t aNode) const {
+    HARM_PREFETCH(&mParents[aNode]);
+    HARM_PREFETCH(&mCounts[aNode]);
+    HARM_PREFETCH(&mDepths[aNode]);
+  }
+
+private:
+  FrozenFPTree(const FrozenFPTree&) = delete;
+  FrozenFPTree& operator=(const FrozenFPTree&) = delete;
+
+  std::vector<uint32_t> mParents;
+  std::vector<Item> mItems;
+  std::vector<unsigned> mCounts;
+  std::vector<unsigned> mDepths;
+
+  std::vector<Item> mHeaderItems;
+  std::vector<unsigned> mHeaderFrequencies;
+  // The chain of header item i is mHeaderNodes[mHeaderOffsets[i],
+  // mHeaderOffsets[i + 1]).
+  std::vector<uint32_t> mHeaderOffsets;
+  std::vector<uint32_t> mHeaderNodes;
+};
@@ -19,10 +19,12 @@
 #include <stdint.h>
 #include "FPTree.h"
 #include "DataStreamMining.h"
+#include "BinaryDataSet.h"
 
 using namespace std;
 
 void Apriori(Options& options);
+void Eclat(Options& options);
 
 int main(int argc, const char* argv[]) {
   srand((int)time(0));
@@ -60,6 +62,9 @@ int main(int argc, const char* argv[]) {
       Apriori(options);
       break;
     case kFPTree:
+    case kFPClose:
+    case kFPMax:
+    case kTopK:
     case kCanTree:
     case kCpTree:
     case kCpTreeStream:
@@ -75,6 +80,12 @@ int main(int argc, const char* argv[]) {
     case kDBDD:
       MineDataStream(options);
       break;
+    case kConvert:
+      ConvertDataSet(options);
+      break;
+    case kEclat:
+      Eclat(options);
+      break;
     default:
       cout << "ERROR: No mode specified\n";
   }
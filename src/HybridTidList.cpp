@@ -0,0 +1,568 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "HybridTidList.h"
+#include "debug.h"
+
+#include <string.h>
+#include <algorithm>
+
+using namespace std;
+
+static const uint32_t kBitmapWords = 65536 / 64;
+
+// Array containers holding more than this become bitmaps. Bitmaps shrinking
+// below half of it become arrays again; the gap stops a chunk whose size
+// hovers around the limit flipping back and forth.
+static const uint32_t kMaxArrayCardinality = 4096;
+static const uint32_t kMinBitmapCardinality = kMaxArrayCardinality / 2;
+
+static inline bool TestBit(const uint64_t* aWords, uint32_t aBit) {
+  return (aWords[aBit / 64] >> (aBit % 64)) & 1;
+}
+
+// Mask of the bits [aFirst, aLast] of a word; 0 <= aFirst <= aLast < 64.
+static inline uint64_t RangeMask(uint32_t aFirst, uint32_t aLast) {
+  const uint64_t high = (aLast == 63) ? ~uint64_t(0) : ((uint64_t(1) << (aLast + 1)) - 1);
+  return high & ~((uint64_t(1) << aFirst) - 1);
+}
+
+static uint32_t NumRuns(const uint64_t* aWords) {
+  // A run starts at each set bit whose predecessor isn't set.
+  uint32_t runs = 0;
+  uint64_t carry = 0;
+  for (uint32_t w = 0; w < kBitmapWords; w++) {
+    const uint64_t word = aWords[w];
+    runs += (uint32_t)PopCount64(word & ~((word << 1) | carry));
+    carry = word >> 63;
+  }
+  return runs;
+}
+
+static uint32_t NumRuns(const vector<uint16_t>& aArray) {
+  uint32_t runs = 0;
+  for (size_t i = 0; i < aArray.size(); i++) {
+    if (i == 0 || aArray[i] != aArray[i - 1] + 1) {
+      runs++;
+    }
+  }
+  return runs;
+}
+
+// Array & array. Merges, or gallops through the larger array if the sizes
+// are very different.
+template<class Output>
+static void IntersectArrays(const uint16_t* aA, size_t aNumA,
+                            const uint16_t* aB, size_t aNumB,
+                            Output aOutput) {
+  if (aNumA > aNumB) {
+    swap(aA, aB);
+    swap(aNumA, aNumB);
+  }
+  if (aNumA * 32 < aNumB) {
+    const uint16_t* cursor = aB;
+    const uint16_t* end = aB + aNumB;
+    for (size_t i = 0; i < aNumA && cursor != end; i++) {
+      cursor = lower_bound(cursor, end, aA[i]);
+      if (cursor != end && *cursor == aA[i]) {
+        aOutput(aA[i]);
+      }
+    }
+    return;
+  }
+  size_t i = 0;
+  size_t j = 0;
+  while (i < aNumA && j < aNumB) {
+    if (aA[i] < aB[j]) {
+      i++;
+    } else if (aB[j] < aA[i]) {
+      j++;
+    } else {
+      aOutput(aA[i]);
+      i++;
+      j++;
+    }
+  }
+}
+
+// Array & bitmap.
+template<class Output>
+static void IntersectArrayBitmap(const uint16_t* aArray, size_t aNum,
+                                 const uint64_t* aWords,
+                                 Output aOutput) {
+  for (size_t i = 0; i < aNum; i++) {
+    if (TestBit(aWords, aArray[i])) {
+      aOutput(aArray[i]);
+    }
+  }
+}
+
+// Run & array.
+template<class Output>
+static void IntersectRunArray(const vector<uint16_t>& aRuns,
+                              const uint16_t* aArray, size_t aNum,
+                              Output aOutput) {
+  size_t r = 0;
+  for (size_t i = 0; i < aNum && r < aRuns.size(); i++) {
+    const uint32_t value = aArray[i];
+    while (r < aRuns.size() && uint32_t(aRuns[r]) + aRuns[r + 1] < value) {
+      r += 2;
+    }
+    if (r < aRuns.size() && aRuns[r] <= value) {
+      aOutput(aArray[i]);
+    }
+  }
+}
+
+// Run & run; calls aOutput(start, last) for each overlapping range.
+template<class Output>
+static void IntersectRuns(const vector<uint16_t>& aA,
+                          const vector<uint16_t>& aB,
+                          Output aOutput) {
+  size_t i = 0;
+  size_t j = 0;
+  while (i < aA.size() && j < aB.size()) {
+    const uint32_t aStart = aA[i];
+    const uint32_t aLast = aStart + aA[i + 1];
+    const uint32_t bStart = aB[j];
+    const uint32_t bLast = bStart + aB[j + 1];
+    const uint32_t start = max(aStart, bStart);
+    const uint32_t last = min(aLast, bLast);
+    if (start <= last) {
+      aOutput(start, last);
+    }
+    if (aLast < bLast) {
+      i += 2;
+    } else {
+      j += 2;
+    }
+  }
+}
+
+// Calls aWord(index, word) for the words of the bitmap masked by the runs.
+template<class Output>
+static void MaskBitmapByRuns(const vector<uint16_t>& aRuns,
+                             const uint64_t* aWords,
+                             Output aWord) {
+  for (size_t r = 0; r < aRuns.size(); r += 2) {
+    const uint32_t start = aRuns[r];
+    const uint32_t last = start + aRuns[r + 1];
+    for (uint32_t w = start / 64; w <= last / 64; w++) {
+      const uint32_t first = (w == start / 64) ? start % 64 : 0;
+      const uint32_t end = (w == last / 64) ? last % 64 : 63;
+      aWord(w, aWords[w] & RangeMask(first, end));
+    }
+  }
+}
+
+HybridTidList::HybridTidList()
+  : mCount(0) {
+}
+
+void HybridTidList::Clear() {
+  mContainers.clear();
+  mCount = 0;
+}
+
+HybridTidList::Container* HybridTidList::Find(uint16_t aKey) {
+  return const_cast<Container*>(static_cast<const HybridTidList*>(this)->Find(aKey));
+}
+
+const HybridTidList::Container* HybridTidList::Find(uint16_t aKey) const {
+  // Tids are mostly added in increasing order, so check the last first.
+  if (!mContainers.empty() && mContainers.back().key == aKey) {
+    return &mContainers.back();
+  }
+  auto itr = lower_bound(mContainers.begin(), mContainers.end(), aKey,
+                         [](const Container& c, uint16_t key) {
+                           return c.key < key;
+                         });
+  return (itr != mContainers.end() && itr->key == aKey) ? &(*itr) : nullptr;
+}
+
+HybridTidList::Container& HybridTidList::FindOrInsert(uint16_t aKey) {
+  Container* existing = Find(aKey);
+  if (existing) {
+    return *existing;
+  }
+  auto itr = lower_bound(mContainers.begin(), mContainers.end(), aKey,
+                         [](const Container& c, uint16_t key) {
+                           return c.key < key;
+                         });
+  Container c;
+  c.key = aKey;
+  c.type = kArrayContainer;
+  c.cardinality = 0;
+  return *mContainers.insert(itr, move(c));
+}
+
+void HybridTidList::ToBitmap(Container& aContainer) {
+  if (aContainer.type == kBitmapContainer) {
+    return;
+  }
+  unique_ptr<uint64_t[], BitmapWordsDeleter> words(AllocateBitmapWords(kBitmapWords));
+  if (aContainer.type == kArrayContainer) {
+    for (const uint16_t low : aContainer.values) {
+      words[low / 64] |= uint64_t(1) << (low % 64);
+    }
+  } else {
+    for (size_t r = 0; r < aContainer.values.size(); r += 2) {
+      const uint32_t start = aContainer.values[r];
+      const uint32_t last = start + aContainer.values[r + 1];
+      for (uint32_t w = start / 64; w <= last / 64; w++) {
+        const uint32_t first = (w == start / 64) ? start % 64 : 0;
+        const uint32_t end = (w == last / 64) ? last % 64 : 63;
+        words[w] |= RangeMask(first, end);
+      }
+    }
+  }
+  vector<uint16_t>().swap(aContainer.values);
+  aContainer.bitmap = move(words);
+  aContainer.type = kBitmapContainer;
+}
+
+void HybridTidList::ToArray(Container& aContainer) {
+  if (aContainer.type == kArrayContainer) {
+    return;
+  }
+  vector<uint16_t> array;
+  array.reserve(aContainer.cardinality);
+  if (aContainer.type == kBitmapContainer) {
+    const uint64_t* words = aContainer.bitmap.get();
+    for (uint32_t w = 0; w < kBitmapWords; w++) {
+      uint64_t word = words[w];
+      while (word) {
+        const uint32_t bit = (uint32_t)PopCount64((word & (0 - word)) - 1);
+        array.push_back(static_cast<uint16_t>(w * 64 + bit));
+        word &= word - 1;
+      }
+    }
+    aContainer.bitmap.reset();
+  } else {
+    for (size_t r = 0; r < aContainer.values.size(); r += 2) {
+      const uint32_t start = aContainer.values[r];
+      const uint32_t last = start + aContainer.values[r + 1];
+      for (uint32_t low = start; low <= last; low++) {
+        array.push_back(static_cast<uint16_t>(low));
+      }
+    }
+  }
+  aContainer.values.swap(array);
+  aContainer.type = kArrayContainer;
+}
+
+void HybridTidList::Add(uint32_t aTid) {
+  const uint16_t low = aTid & 0xffff;
+  Container& c = FindOrInsert(static_cast<uint16_t>(aTid >> 16));
+  if (c.type == kRunContainer) {
+    if (c.cardinality < kMaxArrayCardinality) {
+      ToArray(c);
+    } else {
+      ToBitmap(c);
+    }
+  }
+  if (c.type == kArrayContainer) {
+    auto itr = lower_bound(c.values.begin(), c.values.end(), low);
+    if (itr != c.values.end() && *itr == low) {
+      return;
+    }
+    if (c.cardinality < kMaxArrayCardinality) {
+      c.values.insert(itr, low);
+      c.cardinality++;
+      mCount++;
+      return;
+    }
+    ToBitmap(c);
+  }
+  uint64_t& word = c.bitmap[low / 64];
+  const uint64_t bit = uint64_t(1) << (low % 64);
+  if (!(word & bit)) {
+    word |= bit;
+    c.cardinality++;
+    mCount++;
+  }
+}
+
+void HybridTidList::Remove(uint32_t aTid) {
+  const uint16_t low = aTid & 0xffff;
+  Container* c = Find(static_cast<uint16_t>(aTid >> 16));
+  if (!c) {
+    return;
+  }
+  if (c->type == kRunContainer) {
+    if (c->cardinality <= kMaxArrayCardinality) {
+      ToArray(*c);
+    } else {
+      ToBitmap(*c);
+    }
+  }
+  if (c->type == kArrayContainer) {
+    auto itr = lower_bound(c->values.begin(), c->values.end(), low);
+    if (itr == c->values.end() || *itr != low) {
+      return;
+    }
+    c->values.erase(itr);
+  } else {
+    uint64_t& word = c->bitmap[low / 64];
+    const uint64_t bit = uint64_t(1) << (low % 64);
+    if (!(word & bit)) {
+      return;
+    }
+    word &= ~bit;
+  }
+  c->cardinality--;
+  mCount--;
+  if (c->cardinality == 0) {
+    mContainers.erase(mContainers.begin() + (c - mContainers.data()));
+  } else if (c->type == kBitmapContainer &&
+             c->cardinality < kMinBitmapCardinality) {
+    ToArray(*c);
+  }
+}
+
+bool HybridTidList::Contains(uint32_t aTid) const {
+  const uint16_t low = aTid & 0xffff;
+  const Container* c = Find(static_cast<uint16_t>(aTid >> 16));
+  if (!c) {
+    return false;
+  }
+  switch (c->type) {
+    case kArrayContainer:
+      return binary_search(c->values.begin(), c->values.end(), low);
+    case kBitmapContainer:
+      return TestBit(c->bitmap.get(), low);
+    case kRunContainer: {
+      // Find the last run starting at or before low.
+      size_t lo = 0;
+      size_t hi = c->values.size() / 2;
+      while (lo < hi) {
+        const size_t mid = (lo + hi) / 2;
+        if (c->values[2 * mid] <= low) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+      if (lo == 0) {
+        return false;
+      }
+      const size_t r = 2 * (lo - 1);
+      return uint32_t(low) <= uint32_t(c->values[r]) + c->values[r + 1];
+    }
+  }
+  return false;
+}
+
+void HybridTidList::Optimize() {
+  for (Container& c : mContainers) {
+    const uint32_t runs = (c.type == kBitmapContainer) ? NumRuns(c.bitmap.get())
+                        : (c.type == kArrayContainer) ? NumRuns(c.values)
+                        : (uint32_t)c.values.size() / 2;
+    const size_t runBytes = 4 * size_t(runs);
+    const size_t arrayBytes = 2 * size_t(c.cardinality);
+    const size_t bitmapBytes = kBitmapWords * sizeof(uint64_t);
+    if (runBytes < min(arrayBytes, bitmapBytes)) {
+      if (c.type == kRunContainer) {
+        continue;
+      }
+      if (c.type == kBitmapContainer) {
+        ToArray(c);
+      }
+      vector<uint16_t> pairs;
+      pairs.reserve(2 * runs);
+      for (size_t i = 0; i < c.values.size(); i++) {
+        if (i == 0 || c.values[i] != c.values[i - 1] + 1) {
+          pairs.push_back(c.values[i]);
+          pairs.push_back(0);
+        } else {
+          pairs.back()++;
+        }
+      }
+      c.values.swap(pairs);
+      c.type = kRunContainer;
+    } else if (c.cardinality <= kMaxArrayCardinality) {
+      ToArray(c);
+      c.values.shrink_to_fit();
+    } else {
+      ToBitmap(c);
+    }
+  }
+  mContainers.shrink_to_fit();
+}
+
+size_t HybridTidList::MemoryUsage() const {
+  size_t bytes = sizeof(*this) + mContainers.capacity() * sizeof(Container);
+  for (const Container& c : mContainers) {
+    bytes += c.values.capacity() * sizeof(uint16_t);
+    if (c.bitmap) {
+      bytes += kBitmapWords * sizeof(uint64_t);
+    }
+  }
+  return bytes;
+}
+
+uint32_t HybridTidList::ContainerIntersectionCount(const Container& aA,
+                                                   const Container& aB) {
+  // Order the pair so that we only need to handle each combination once.
+  if (aA.type > aB.type) {
+    return ContainerIntersectionCount(aB, aA);
+  }
+  uint32_t count = 0;
+  auto countValue = [&count](uint16_t) {
+    count++;
+  };
+  if (aA.type == kArrayContainer) {
+    switch (aB.type) {
+      case kArrayContainer:
+        IntersectArrays(aA.values.data(), aA.values.size(),
+                        aB.values.data(), aB.values.size(), countValue);
+        break;
+      case kBitmapContainer:
+        IntersectArrayBitmap(aA.values.data(), aA.values.size(),
+                             aB.bitmap.get(), countValue);
+        break;
+      case kRunContainer:
+        IntersectRunArray(aB.values, aA.values.data(), aA.values.size(), countValue);
+        break;
+    }
+  } else if (aA.type == kBitmapContainer) {
+    if (aB.type == kBitmapContainer) {
+      const uint64_t* rows[] = {aA.bitmap.get(), aB.bitmap.get()};
+      return (uint32_t)AndPopCount(rows, 2, kBitmapWords);
+    }
+    MaskBitmapByRuns(aB.values, aA.bitmap.get(),
+                     [&count](uint32_t, uint64_t word) {
+                       count += (uint32_t)PopCount64(word);
+                     });
+  } else {
+    IntersectRuns(aA.values, aB.values,
+                  [&count](uint32_t start, uint32_t last) {
+                    count += last - start + 1;
+                  });
+  }
+  return count;
+}
+
+bool HybridTidList::IntersectContainers(const Container& aA,
+                                        const Container& aB,
+                                        Container& aOut) {
+  if (aA.type > aB.type) {
+    return IntersectContainers(aB, aA, aOut);
+  }
+  aOut.key = aA.key;
+  aOut.values.clear();
+  aOut.bitmap.reset();
+  auto appendValue = [&aOut](uint16_t value) {
+    aOut.values.push_back(value);
+  };
+  if (aA.type == kArrayContainer) {
+    aOut.type = kArrayContainer;
+    switch (aB.type) {
+      case kArrayContainer:
+        IntersectArrays(aA.values.data(), aA.values.size(),
+                        aB.values.data(), aB.values.size(), appendValue);
+        break;
+      case kBitmapContainer:
+        IntersectArrayBitmap(aA.values.data(), aA.values.size(),
+                             aB.bitmap.get(), appendValue);
+        break;
+      case kRunContainer:
+        IntersectRunArray(aB.values, aA.values.data(), aA.values.size(), appendValue);
+        break;
+    }
+    aOut.cardinality = (uint32_t)aOut.values.size();
+  } else if (aA.type == kBitmapContainer) {
+    aOut.type = kBitmapContainer;
+    aOut.bitmap.reset(AllocateBitmapWords(kBitmapWords));
+    uint64_t* out = aOut.bitmap.get();
+    uint32_t cardinality = 0;
+    if (aB.type == kBitmapContainer) {
+      const uint64_t* a = aA.bitmap.get();
+      const uint64_t* b = aB.bitmap.get();
+      for (uint32_t w = 0; w < kBitmapWords; w++) {
+        out[w] = a[w] & b[w];
+        cardinality += (uint32_t)PopCount64(out[w]);
+      }
+    } else {
+      MaskBitmapByRuns(aB.values, aA.bitmap.get(),
+                       [out, &cardinality](uint32_t w, uint64_t word) {
+                         out[w] |= word;
+                         cardinality += (uint32_t)PopCount64(word);
+                       });
+    }
+    aOut.cardinality = cardinality;
+    if (cardinality <= kMaxArrayCardinality) {
+      ToArray(aOut);
+    }
+  } else {
+    aOut.type = kRunContainer;
+    uint32_t cardinality = 0;
+    IntersectRuns(aA.values, aB.values,
+                  [&aOut, &cardinality](uint32_t start, uint32_t last) {
+                    aOut.values.push_back(static_cast<uint16_t>(start));
+                    aOut.values.push_back(static_cast<uint16_t>(last - start));
+                    cardinality += last - start + 1;
+                  });
+    aOut.cardinality = cardinality;
+  }
+  return aOut.cardinality != 0;
+}
+
+uint32_t HybridTidList::IntersectionCount(const HybridTidList& aA,
+                                          const HybridTidList& aB) {
+  uint32_t count = 0;
+  size_t i = 0;
+  size_t j = 0;
+  while (i < aA.mContainers.size() && j < aB.mContainers.size()) {
+    const Container& a = aA.mContainers[i];
+    const Container& b = aB.mContainers[j];
+    if (a.key < b.key) {
+      i++;
+    } else if (b.key < a.key) {
+      j++;
+    } else {
+      count += ContainerIntersectionCount(a, b);
+      i++;
+      j++;
+    }
+  }
+  return count;
+}
+
+void HybridTidList::Intersect(const HybridTidList& aA,
+                              const HybridTidList& aB,
+                              HybridTidList& aOut) {
+  ASSERT(&aOut != &aA && &aOut != &aB);
+  aOut.Clear();
+  size_t i = 0;
+  size_t j = 0;
+  Container scratch;
+  while (i < aA.mContainers.size() && j < aB.mContainers.size()) {
+    const Container& a = aA.mContainers[i];
+    const Container& b = aB.mContainers[j];
+    if (a.key < b.key) {
+      i++;
+    } else if (b.key < a.key) {
+      j++;
+    } else {
+      if (IntersectContainers(a, b, scratch)) {
+        aOut.mCount += scratch.cardinality;
+        aOut.mContainers.push_back(move(scratch));
+        scratch = Container();
+      }
+      i++;
+      j++;
+    }
+  }
+}
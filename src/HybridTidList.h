@@ -0,0 +1,144 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "BitmapKernels.h"
+
+// Compressed set of transaction ids, in the style of a Roaring bitmap.
+//
+// Tids are split into chunks of 65536 by their high 16 bits, and each
+// non-empty chunk is stored in whichever container suits its density:
+//  - array: a sorted array of the tids' low 16 bits, for sparse chunks,
+//  - bitmap: 65536 bits, for dense chunks,
+//  - run: sorted (start, length - 1) pairs, for chunks of consecutive tids.
+// So an item which appears in a handful of transactions costs a few bytes,
+// rather than a bit for every transaction in the data set.
+//
+// Add() and Remove() keep chunks in array or bitmap form; Optimize()
+// converts chunks to runs where that's smaller, once the list is built.
+class HybridTidList {
+public:
+  HybridTidList();
+  HybridTidList(HybridTidList&& aOther) = default;
+  HybridTidList& operator=(HybridTidList&& aOther) = default;
+
+  void Add(uint32_t aTid);
+  void Remove(uint32_t aTid);
+  bool Contains(uint32_t aTid) const;
+
+  // Number of tids in the list.
+  uint32_t Count() const {
+    return mCount;
+  }
+
+  bool IsEmpty() const {
+    return mCount == 0;
+  }
+
+  void Clear();
+
+  // Converts each chunk to its most compact container.
+  void Optimize();
+
+  // Approximate heap and object memory used, in bytes.
+  size_t MemoryUsage() const;
+
+  // Calls aFunction(tid) for each tid in the list, in increasing order.
+  template<class Function>
+  void ForEach(Function aFunction) const;
+
+  // Returns the number of tids in both lists.
+  static uint32_t IntersectionCount(const HybridTidList& aA, const HybridTidList& aB);
+
+  // Stores the tids in both lists into aOut.
+  static void Intersect(const HybridTidList& aA,
+                        const HybridTidList& aB,
+                        HybridTidList& aOut);
+
+private:
+  HybridTidList(const HybridTidList&) = delete;
+  HybridTidList& operator=(const HybridTidList&) = delete;
+
+  enum eContainerType : uint8_t {
+    kArrayContainer,
+    kBitmapContainer,
+    kRunContainer,
+  };
+
+  struct Container {
+    uint16_t key;
+    eContainerType type;
+    uint32_t cardinality;
+    // Sorted low 16 bits for array containers, (start, length - 1) pairs for
+    // run containers.
+    std::vector<uint16_t> values;
+    std::unique_ptr<uint64_t[], BitmapWordsDeleter> bitmap;
+  };
+
+  // Returns the container for aKey, or nullptr.
+  Container* Find(uint16_t aKey);
+  const Container* Find(uint16_t aKey) const;
+  Container& FindOrInsert(uint16_t aKey);
+
+  static void ToBitmap(Container& aContainer);
+  static void ToArray(Container& aContainer);
+  static uint32_t ContainerIntersectionCount(const Container& aA, const Container& aB);
+  // Returns false if the intersection is empty.
+  static bool IntersectContainers(const Container& aA,
+                                  const Container& aB,
+                                  Container& aOut);
+
+  std::vector<Container> mContainers;
+  uint32_t mCount;
+};
+
+template<class Function>
+void HybridTidList::ForEach(Function aFunction) const {
+  for (const Container& c : mContainers) {
+    const uint32_t high = uint32_t(c.key) << 16;
+    switch (c.type) {
+      case kArrayContainer:
+        for (const uint16_t low : c.values) {
+          aFunction(high | low);
+        }
+        break;
+      case kBitmapContainer:
+        for (uint32_t w = 0; w < 1024; w++) {
+          uint64_t word = c.bitmap[w];
+          while (word) {
+            // Index of the lowest set bit.
+            const uint32_t bit = (uint32_t)PopCount64((word & (0 - word)) - 1);
+            aFunction(high | (w * 64 + bit));
+            word &= word - 1;
+          }
+        }
+        break;
+      case kRunContainer:
+        for (size_t r = 0; r < c.values.size(); r += 2) {
+          const uint32_t start = c.values[r];
+          const uint32_t end = start + c.values[r + 1];
+          for (uint32_t low = start; low <= end; low++) {
+            aFunction(high | low);
+          }
+        }
+        break;
+    }
+  }
+}
@@ -16,7 +16,7 @@
 #include "InvertedDataSetIndex.h"
 #include "WindowIndex.h"
 #include "ItemSet.h"
-#include "TidList.h"
+#include "BitmapKernels.h"
 #include "debug.h"
 #include "utils.h"
 #include "DataSetReader.h"
@@ -52,11 +52,16 @@ bool InvertedDataSetIndex::Load() {
   cout << "Loading data set" << endl;
   DurationTimer timer;
 
-  mInvertedIndex.clear();
+  mCounts.clear();
+  mBitmapRow.clear();
+  mBitmap.reset();
+  mRowWords = 0;
+  mTransactions.clear();
   mItems.clear();
   mNumTransactions = 0;
   mTxnId = 0;
   mLoaded = false;
+  InvalidateCountCache();
 
   if (!mReader->IsGood()) {
     cerr << "ERROR: Can't read input;failing!" << endl;
@@ -72,10 +77,11 @@ bool InvertedDataSetIndex::Load() {
     ++mNumTransactions;
     ++mTxnId;
     for (unsigned i = 0; i < transaction.size(); ++i) {
-      Item item = transaction[i];
-      int id = item.GetId();
-      TidList& tidList = mInvertedIndex[id];
-      tidList.Set(mTxnId, true);
+      const uint32_t index = transaction[i].GetIndex();
+      if (index >= mTransactions.size()) {
+        mTransactions.resize(index + 1);
+      }
+      mTransactions[index].push_back(mTxnId - 1);
     }
     if (mFunctor) {
       mFunctor->OnLoad(transaction);
@@ -83,13 +89,15 @@ bool InvertedDataSetIndex::Load() {
   }
 
   // Initialize the set of items.
-  map<int, TidList>::iterator itr = mInvertedIndex.begin();
-  while (itr != mInvertedIndex.end()) {
-    Item i((*itr).first);
-    mItems.insert(i);
-    itr++;
+  mCounts.resize(mTransactions.size(), 0);
+  for (uint32_t index = 0; index < mTransactions.size(); index++) {
+    mCounts[index] = (unsigned)mTransactions[index].size();
+    if (mCounts[index]) {
+      mItems.insert(Item::FromIndex(index));
+    }
   }
-  ASSERT(mItems.size() == GetNumItems());
+
+  BuildBitmaps();
 
   mLoaded = true;
   if (mFunctor) {
@@ -98,7 +106,7 @@ bool InvertedDataSetIndex::Load() {
 
   cout << "Loading took " << timer.Seconds() << "s.\n";
   cout << "Num transactions: " << mNumTransactions << "\n";
-  cout << "Num items: " << mInvertedIndex.size() << "\n";
+  cout << "Num items: " << mItems.size() << "\n";
 
   return true;
 }
@@ -107,63 +115,184 @@ bool InvertedDataSetIndex::IsLoaded() const {
   return mLoaded;
 }
 
-void InvertedDataSetIndex::GetTidLists(const ItemSet& aItemSet,
-                                       vector<const TidList*>& aTidLists) const {
-  set<Item>::const_iterator itr = aItemSet.mItems.begin();
-  while (itr != aItemSet.mItems.end()) {
-    int itemId = *itr;
-    map<int, TidList>::const_iterator t = mInvertedIndex.find(itemId);
-    if (t != mInvertedIndex.end()) {
-      aTidLists.push_back(&(t->second));
+const uint32_t InvertedDataSetIndex::kNoRow;
+
+void InvertedDataSetIndex::BuildBitmaps() {
+  mBitmapRow.assign(mTransactions.size(), kNoRow);
+  uint32_t numRows = 0;
+  for (uint32_t index = 0; index < mTransactions.size(); index++) {
+    if (mCounts[index] && (uint64_t)mCounts[index] * 32 >= mNumTransactions) {
+      mBitmapRow[index] = numRows++;
+    }
+  }
+  if (!numRows) {
+    return;
+  }
+  mRowWords = BitmapRowWords(mNumTransactions);
+  mBitmap.reset(AllocateBitmapWords(numRows * mRowWords));
+  for (uint32_t index = 0; index < mTransactions.size(); index++) {
+    if (mBitmapRow[index] == kNoRow) {
+      continue;
+    }
+    uint64_t* row = mBitmap.get() + mBitmapRow[index] * mRowWords;
+    for (const uint32_t tid : mTransactions[index]) {
+      row[tid / 64] |= uint64_t(1) << (tid % 64);
     }
-    itr++;
+    // The bitmap row replaces the transaction list.
+    vector<uint32_t>().swap(mTransactions[index]);
   }
 }
 
 // Counts the number of transactions which contain all items in the Itemset.
-// Works by getting the TidLists of all the items, then ANDing them together,
-// and counting the bits set.
-int InvertedDataSetIndex::Count(const ItemSet& aItemSet) const {
+// Items not in the index are ignored. If all the items have bitmap rows,
+// we AND the rows together and count the bits set. Otherwise we test each
+// transaction in the shortest transaction list against the other items.
+int InvertedDataSetIndex::CountItemSet(const ItemSet& aItemSet) const {
+  const unsigned kMaxStackItems = 32;
+  const size_t size = aItemSet.Size();
+  uint32_t stackIndices[kMaxStackItems];
+  const uint64_t* stackRows[kMaxStackItems];
+  vector<uint32_t> heapIndices;
+  vector<const uint64_t*> heapRows;
+  uint32_t* indices = stackIndices;
+  const uint64_t** rows = stackRows;
+  if (size > kMaxStackItems) {
+    heapIndices.resize(size);
+    heapRows.resize(size);
+    indices = heapIndices.data();
+    rows = heapRows.data();
+  }
 
-  vector<const TidList*> tidLists;
-  GetTidLists(aItemSet, tidLists);
+  unsigned numItems = 0;
+  unsigned numRows = 0;
+  for (const Item item : aItemSet.mItems) {
+    if (!Contains(item)) {
+      continue;
+    }
+    const uint32_t index = item.GetIndex();
+    indices[numItems++] = index;
+    if (mBitmapRow[index] != kNoRow) {
+      rows[numRows++] = mBitmap.get() + mBitmapRow[index] * mRowWords;
+    }
+  }
 
-  if (tidLists.empty()) {
+  if (numItems == 0) {
     return 0;
   }
+  if (numItems == 1) {
+    return mCounts[indices[0]];
+  }
+  if (numRows == numItems) {
+    return (int)AndPopCount(rows, numRows, mRowWords);
+  }
+  return CountSparse(indices, numItems);
+}
+
+int InvertedDataSetIndex::CountSparse(const uint32_t* aItemIndices,
+                                      unsigned aNumItems) const {
+  // Drive the count from the item with the shortest transaction list.
+  unsigned shortest = aNumItems;
+  for (unsigned i = 0; i < aNumItems; i++) {
+    const uint32_t index = aItemIndices[i];
+    if (mBitmapRow[index] == kNoRow &&
+        (shortest == aNumItems ||
+         mCounts[index] < mCounts[aItemIndices[shortest]])) {
+      shortest = i;
+    }
+  }
+  ASSERT(shortest < aNumItems);
+  const vector<uint32_t>& driver = mTransactions[aItemIndices[shortest]];
+
+  // Position in each other item's transaction list; transactions are
+  // visited in increasing order, so each list is only scanned forward.
+  const unsigned kMaxStackItems = 32;
+  size_t stackCursors[kMaxStackItems] = {0};
+  vector<size_t> heapCursors;
+  size_t* cursors = stackCursors;
+  if (aNumItems > kMaxStackItems) {
+    heapCursors.resize(aNumItems, 0);
+    cursors = heapCursors.data();
+  }
 
   int count = 0;
-  const TidList* first = tidLists[0];
+  for (const uint32_t tid : driver) {
+    bool inAll = true;
+    for (unsigned i = 0; i < aNumItems && inAll; i++) {
+      if (i == shortest) {
+        continue;
+      }
+      const uint32_t index = aItemIndices[i];
+      if (mBitmapRow[index] != kNoRow) {
+        const uint64_t* row = mBitmap.get() + mBitmapRow[index] * mRowWords;
+        inAll = (row[tid / 64] >> (tid % 64)) & 1;
+        continue;
+      }
+      const vector<uint32_t>& other = mTransactions[index];
+      size_t& cursor = cursors[i];
+      cursor = lower_bound(other.begin() + cursor, other.end(), tid) - other.begin();
+      if (cursor == other.size()) {
+        // No later transaction contains this item.
+        return count;
+      }
+      inAll = other[cursor] == tid;
+    }
+    if (inAll) {
+      count++;
+    }
+  }
+  return count;
+}
 
-  vector<vector<unsigned>*> firstTidlist = first->mChunks;
+vector<uint32_t> InvertedDataSetIndex::GetTransactionIds(const Item& aItem) const {
+  vector<uint32_t> tids;
+  if (!Contains(aItem)) {
+    return tids;
+  }
+  tids.reserve(mCounts[aItem.GetIndex()]);
+  ForEachTransaction(aItem.GetIndex(), [&tids](uint32_t tid) {
+    tids.push_back(tid);
+  });
+  return tids;
+}
 
-  // For each chunk in the first TID list...
-  for (unsigned f = 0; f < firstTidlist.size(); f++) {
-    // Extract the vector of chunks.
-    vector<unsigned>* chunks = firstTidlist[f];
-    if (!chunks) {
-      continue;
+void InvertedDataSetIndex::GetTransactionLengths(const vector<int>& aItemIds,
+                                                 vector<uint32_t>& aLengths) const {
+  aLengths.assign(mNumTransactions, 0);
+  for (const int id : aItemIds) {
+    const Item item(id);
+    if (Contains(item)) {
+      ForEachTransaction(item.GetIndex(), [&aLengths](uint32_t tid) {
+        aLengths[tid]++;
+      });
     }
+  }
+}
 
-    // Logical AND it with the corresponding bitset from the TidList
-    // for all other itemsets.
-    for (unsigned i = 0; i < chunks->size(); ++i) {
-      unsigned chunk = chunks->at(i);
-      if (chunk) {
-        for (unsigned t = 1; t < tidLists.size(); t++) {
-          chunk &= tidLists[t]->GetChunk(f, i);
-        }
-      }
-      // Count the bits set, the number of transactions in which all the
-      // items in itemset occur.
-      count += PopulationCount(chunk);
+void InvertedDataSetIndex::GetTransactions(const vector<int>& aItemIds,
+                                           vector<uint32_t>& aOffsets,
+                                           vector<int>& aItems) const {
+  // Count each transaction's items, then fill in the items in increasing
+  // order of id.
+  vector<uint32_t> lengths;
+  GetTransactionLengths(aItemIds, lengths);
+  aOffsets.assign(mNumTransactions + 1, 0);
+  for (unsigned tid = 0; tid < mNumTransactions; tid++) {
+    aOffsets[tid + 1] = aOffsets[tid] + lengths[tid];
+  }
+  aItems.resize(aOffsets[mNumTransactions]);
+  vector<uint32_t> next(aOffsets.begin(), aOffsets.end() - 1);
+  for (const int id : aItemIds) {
+    const Item item(id);
+    if (Contains(item)) {
+      ForEachTransaction(item.GetIndex(), [&aItems, &next, id](uint32_t tid) {
+        aItems[next[tid]++] = id;
+      });
     }
   }
-  return count;
 }
 
 int InvertedDataSetIndex::Count(const Item& aItem) const {
-  return Count(ItemSet(aItem));
+  return Contains(aItem) ? mCounts[aItem.GetIndex()] : 0;
 }
 
 const set<Item>& InvertedDataSetIndex::GetItems() const {
@@ -172,14 +301,22 @@ const set<Item>& InvertedDataSetIndex::GetItems() const {
 }
 
 int IntersectionSize(const ItemSet& aItem1, const ItemSet& aItem2) {
-  set<Item>::const_iterator itr = aItem1.mItems.begin();
-  set<Item>::const_iterator end = aItem1.mItems.end();
+  // Both are sorted in the same order, so count the matches in a merge.
+  ItemSet::const_iterator a = aItem1.mItems.begin();
+  ItemSet::const_iterator aEnd = aItem1.mItems.end();
+  ItemSet::const_iterator b = aItem2.mItems.begin();
+  ItemSet::const_iterator bEnd = aItem2.mItems.end();
   int count = 0;
-  while (itr != end) {
-    if (aItem2.mItems.find(*itr) != aItem2.mItems.end()) {
+  while (a != aEnd && b != bEnd) {
+    if (*a == *b) {
       count++;
+      a++;
+      b++;
+    } else if (*a < *b) {
+      a++;
+    } else {
+      b++;
     }
-    itr++;
   }
   return count;
 }
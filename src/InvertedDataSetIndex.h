@@ -21,12 +21,12 @@
 #include <memory>
 
 #include "CoocurrenceGraph.h"
+#include "CountCache.h"
 #include "Options.h"
 #include "utils.h"
 #include "ItemSet.h"
 #include "DataSetReader.h"
-
-class TidList;
+#include "BitmapKernels.h"
 
 // Uncomment to stress test indexes in their static Test() functions
 // by loading Kosarak. It takes a while, so it's not on by default.
@@ -62,6 +62,18 @@ protected:
   LoadFunctor* mFunctor;
   std::unique_ptr<DataSetReader> mReader;
 
+  // Counts the number of transactions which contain all items in the
+  // itemset, without consulting the count cache.
+  virtual int CountItemSet(const ItemSet& aItemSet) const = 0;
+
+  // Discards cached counts. Data sets must call this whenever the
+  // transactions they hold change.
+  void InvalidateCountCache() {
+    if (mCountCache) {
+      mCountCache->Invalidate();
+    }
+  }
+
 public:
 
   void SetLoadListener(LoadFunctor* aListener) {
@@ -87,7 +99,30 @@ public:
                        LoadFunctor* aFunctor,
                        unsigned aNumItems = 100);
 
-  virtual int Count(const ItemSet& aItemSet) const = 0;
+  // Caches the counts of itemsets with more than one item, using at most
+  // about aMaxBytes of memory. Pass 0 to disable the cache.
+  void EnableCountCache(size_t aMaxBytes) {
+    mCountCache.reset(aMaxBytes ? new CountCache(aMaxBytes) : nullptr);
+  }
+
+  // Returns nullptr if the count cache isn't enabled.
+  const CountCache* GetCountCache() const {
+    return mCountCache.get();
+  }
+
+  int Count(const ItemSet& aItemSet) const {
+    // Single items' counts are already cheap to look up.
+    if (!mCountCache || aItemSet.Size() < 2) {
+      return CountItemSet(aItemSet);
+    }
+    const CountCache::Key key(aItemSet);
+    int count = 0;
+    if (!mCountCache->Lookup(key, count)) {
+      count = CountItemSet(aItemSet);
+      mCountCache->Insert(key, count);
+    }
+    return count;
+  }
   virtual int Count(const Item& aItem) const = 0;
 
   double Support(const ItemSet& aItemSet) const {
@@ -111,6 +146,9 @@ public:
 
   // Returns true if the dataset has finished loading.
   virtual bool IsLoaded() const = 0;
+
+private:
+  std::unique_ptr<CountCache> mCountCache;
 };
 
 class InvertedDataSetIndex : public DataSet {
@@ -120,7 +158,7 @@ public:
 
   bool Load() override;
 
-  int Count(const ItemSet& aItemSet) const override;
+  using DataSet::Count;
   int Count(const Item& aItem) const override;
 
   unsigned NumTransactions() const  override {
@@ -131,28 +169,89 @@ public:
   }
   const std::set<Item>& GetItems() const;
   unsigned GetNumItems() const {
-    return (unsigned)mInvertedIndex.size();
+    return (unsigned)mItems.size();
   }
 
   bool IsLoaded() const override;
 
+  // Returns the numbers of the transactions containing aItem, in
+  // increasing order.
+  std::vector<uint32_t> GetTransactionIds(const Item& aItem) const;
+
+  // Sets aLengths[t] to the number of the items with the given ids in
+  // transaction t, without building the transactions.
+  void GetTransactionLengths(const std::vector<int>& aItemIds,
+                             std::vector<uint32_t>& aLengths) const;
+
+  // Builds the transactions, keeping only the items with the given ids, in
+  // compressed row form: transaction t's item ids are aItems[aOffsets[t]]
+  // up to aItems[aOffsets[t + 1]], in increasing order. aItemIds must be in
+  // increasing order.
+  void GetTransactions(const std::vector<int>& aItemIds,
+                       std::vector<uint32_t>& aOffsets,
+                       std::vector<int>& aItems) const;
+
 protected:
 
-  // Maps Item Id to list of transactions containing that item.
-  std::map<int, TidList> mInvertedIndex;
+  // Calls aCallback(tid) for each transaction containing the item with
+  // index aIndex, in increasing order.
+  template<class Callback>
+  void ForEachTransaction(uint32_t aIndex, const Callback& aCallback) const {
+    if (mBitmapRow[aIndex] == kNoRow) {
+      for (const uint32_t tid : mTransactions[aIndex]) {
+        aCallback(tid);
+      }
+      return;
+    }
+    const uint64_t* row = mBitmap.get() + mBitmapRow[aIndex] * mRowWords;
+    for (size_t w = 0; w < mRowWords; w++) {
+      for (uint64_t word = row[w]; word; word &= word - 1) {
+        // Index of the lowest set bit.
+        const uint32_t bit = (uint32_t)PopCount64((word & (0 - word)) - 1);
+        aCallback((uint32_t)(w * 64 + bit));
+      }
+    }
+  }
+
+  int CountItemSet(const ItemSet& aItemSet) const override;
+
+  // Converts the transaction lists of items which appear in enough
+  // transactions into bitmap rows.
+  void BuildBitmaps();
+
+  // Returns true if the item is in the index.
+  bool Contains(const Item& aItem) const {
+    return !aItem.IsNull() &&
+           aItem.GetIndex() < mCounts.size() &&
+           mCounts[aItem.GetIndex()] != 0;
+  }
+
+  // Counts the transactions containing all of the given items, where at
+  // least one of them is stored as a transaction list.
+  int CountSparse(const uint32_t* aItemIndices, unsigned aNumItems) const;
+
+  // Number of transactions each item appears in, indexed by item index.
+  std::vector<unsigned> mCounts;
+
+  // Items which appear in at least 1/32 of transactions are stored as a row
+  // of a dense bitmap, with one bit per transaction, as that's no larger
+  // than storing their transaction list. The bitmap is ANDed and counted
+  // with SIMD kernels. mBitmapRow maps item index to row, or kNoRow.
+  static const uint32_t kNoRow = 0xffffffff;
+  std::vector<uint32_t> mBitmapRow;
+  std::unique_ptr<uint64_t[], BitmapWordsDeleter> mBitmap;
+  size_t mRowWords = 0;
+
+  // Sorted transaction numbers (starting at 0) containing each item that
+  // doesn't have a bitmap row, indexed by item index.
+  std::vector<std::vector<uint32_t>> mTransactions;
+
   unsigned mNumTransactions = 0;
   unsigned mTxnId = 0;
   bool mLoaded = false;
 
   // Stores each item in the data set.
   std::set<Item> mItems;
-
-  void GetTidLists(const ItemSet& aItemSet,
-                   std::vector<const TidList*>& aTidLists) const;
-
-  void GetTidLists(const ItemSet& aItemSet,
-                   std::vector<int>** aShortestTidList,
-                   std::vector<std::vector<int>*>& aTidLists);
 };
 
 int IntersectionSize(const ItemSet& aItem1, const ItemSet& aItem2);
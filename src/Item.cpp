@@ -15,18 +15,16 @@
 #include "debug.h"
 #include "utils.h"
 #include "Item.h"
-#include "ItemMap.h"
+#include "ItemDictionary.h"
 
-#include <map>
 #include <iostream>
 #include <bitset>
 #include <math.h>
+#include <string.h>
 
 using namespace std;
 
-map<string, int> gItemNameToId;
-ItemMap<string> gIdToItemName;
-static int gItemIdCount = 1;
+static ItemDictionary gItemDictionary;
 
 static Item::CompareMode sCmpMode = Item::INSERTION_ORDER_COMPARE;
 
@@ -35,14 +33,6 @@ void Item::SetCompareMode(CompareMode aMode) {
   sCmpMode = aMode;
 }
 
-Item::Item()
-  : mId(0) {
-}
-
-Item::Item(int aItemId)
-  : mId(aItemId) {
-}
-
 Item::Item(const char* aName) {
   string name(aName);
   Init(name);
@@ -52,32 +42,43 @@ Item::Item(const string& aName) {
   Init(aName);
 }
 
-void Item::Init(const string& aName) {
-  string name = TrimWhiteSpace(aName);
-  int itemId = gItemNameToId[name];
-  if (itemId == 0) {
-    itemId = gItemIdCount++;
-    gItemNameToId[name] = itemId;
-    gIdToItemName.Set(Item(itemId), name);
-  }
-  mId = itemId;
+Item::Item(const char* aName, size_t aLength)
+  : mId(gItemDictionary.Intern(aName, aLength)) {
 }
 
-Item::~Item() {
-
+void Item::Init(const string& aName) {
+  const string name = TrimWhiteSpace(aName);
+  mId = gItemDictionary.Intern(name.data(), name.size());
 }
 
 Item::operator string() const {
-  if (mId == 0 || !gIdToItemName.Contains(*this)) {
+  if (!gItemDictionary.Contains(mId)) {
+    return "null";
+  }
+  return string(gItemDictionary.GetName(mId), gItemDictionary.GetNameLength(mId));
+}
+
+const char* Item::GetName() const {
+  if (!gItemDictionary.Contains(mId)) {
     return "null";
   }
-  return gIdToItemName.Get(*this);
+  return gItemDictionary.GetName(mId);
+}
+
+size_t Item::GetNameLength() const {
+  if (!gItemDictionary.Contains(mId)) {
+    return 4;
+  }
+  return gItemDictionary.GetNameLength(mId);
 }
 
 void Item::ResetBaseId() {
-  gItemNameToId.clear();
-  gItemIdCount = 1;
-  gIdToItemName.Clear();
+  gItemDictionary.Reset();
+}
+
+/* static */
+unsigned Item::NumItems() {
+  return static_cast<unsigned>(gItemDictionary.Size());
 }
 
 // Operator less than...
@@ -90,10 +91,12 @@ bool Item::operator<(Item const aItem) const {
   switch (sCmpMode) {
     case INSERTION_ORDER_COMPARE:
       return mId < other;
-    case ALPHABETIC_COMPARE:
-      string us = operator string();
-      string them = aItem;
-      return us < them;
+    case ALPHABETIC_COMPARE: {
+      const size_t usLength = GetNameLength();
+      const size_t themLength = aItem.GetNameLength();
+      const int cmp = memcmp(GetName(), aItem.GetName(), min(usLength, themLength));
+      return cmp < 0 || (cmp == 0 && usLength < themLength);
+    }
   }
   return false;
 }
@@ -16,25 +16,26 @@
 #define __ITEM_H__
 
 #include <string>
+#include <stddef.h>
 #include "debug.h"
 #include <stdint.h>
 
 // Represents a single item. Internally stored as an int.
 class Item {
 public:
-  Item();
+  Item()
+    : mId(0) {}
   Item(const std::string& aName);
   Item(const char* aName);
-  Item(int aItemId);
-  ~Item();
+  // Interns the name in [aName, aName + aLength), which must already have
+  // had any surrounding whitespace trimmed.
+  Item(const char* aName, size_t aLength);
+  Item(int aItemId)
+    : mId(aItemId) {}
 
   bool operator==(Item i) const {
     return mId == i.mId;
   }
-  Item& operator=(const Item& i) {
-    mId = i.mId;
-    return *this;
-  }
   bool operator<(const Item i) const;
   operator int() const {
     return mId;
@@ -66,6 +67,9 @@ public:
   // it to make an impact though!
   static void ResetBaseId();
 
+  // Number of items interned; their ids are 1 to NumItems().
+  static unsigned NumItems();
+
   // Sets the comparison mode to either alphabetic or insertion/encounter-order
   // mode. In insertion order mode, an item encountered before another item is
   // considered "less than" that item. Note alphabetic mode is much slower.
@@ -75,7 +79,10 @@ public:
   };
   static void SetCompareMode(CompareMode aMode);
 
+  // Returns the item's name. The returned string is owned by the item
+  // dictionary, and remains valid until ResetBaseId() is called.
   const char* GetName() const;
+  size_t GetNameLength() const;
 
 private:
   void Init(const std::string& aName);
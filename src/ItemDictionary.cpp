@@ -0,0 +1,230 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ItemDictionary.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+static const uint32_t kInitialTableCapacity = 16;
+static const size_t kNameBlockSize = 64 * 1024;
+
+// FNV-1a, followed by a 64 bit finalizer so that both the high bits (which
+// select the shard) and the low bits (which select the slot) are well mixed.
+static inline uint64_t HashName(const char* aName, size_t aLength) {
+  uint64_t h = 14695981039346656037ull;
+  for (size_t i = 0; i < aLength; i++) {
+    h ^= static_cast<uint8_t>(aName[i]);
+    h *= 1099511628211ull;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+ItemDictionary::Table::Table(uint32_t aCapacity)
+  : mask(aCapacity - 1),
+    slots(new atomic<uint64_t>[aCapacity]) {
+  for (uint32_t i = 0; i < aCapacity; i++) {
+    slots[i].store(0, memory_order_relaxed);
+  }
+}
+
+ItemDictionary::ItemDictionary()
+  : mNextId(1),
+    mNumPublished(0) {
+  for (uint32_t i = 0; i < kMaxSegments; i++) {
+    mSegments[i].store(nullptr, memory_order_relaxed);
+  }
+  InitShards();
+}
+
+ItemDictionary::~ItemDictionary() {
+  for (uint32_t i = 0; i < kMaxSegments; i++) {
+    delete[] mSegments[i].load(memory_order_relaxed);
+  }
+}
+
+void ItemDictionary::InitShards() {
+  for (Shard& shard : mShards) {
+    shard.tables.clear();
+    shard.blocks.clear();
+    shard.cursor = nullptr;
+    shard.end = nullptr;
+    shard.count = 0;
+    shard.tables.emplace_back(new Table(kInitialTableCapacity));
+    shard.table.store(shard.tables.back().get(), memory_order_release);
+  }
+}
+
+void ItemDictionary::Reset() {
+  for (uint32_t i = 0; i < kMaxSegments; i++) {
+    delete[] mSegments[i].load(memory_order_relaxed);
+    mSegments[i].store(nullptr, memory_order_relaxed);
+  }
+  InitShards();
+  mNextId.store(1, memory_order_release);
+  mNumPublished.store(0, memory_order_release);
+}
+
+bool ItemDictionary::Contains(int aId) const {
+  if (aId <= 0) {
+    return false;
+  }
+  const uint32_t id = static_cast<uint32_t>(aId);
+  return id <= mNumPublished.load(memory_order_acquire);
+}
+
+void ItemDictionary::Publish(uint32_t aId) {
+  // Wait for the threads interning lower ids to publish them. They hold
+  // other shards' locks, and don't wait on this one, so this ends; a lower
+  // id in this shard was published before its thread let go of the lock.
+  uint32_t expected = aId - 1;
+  while (!mNumPublished.compare_exchange_weak(expected, aId,
+                                              memory_order_release,
+                                              memory_order_relaxed)) {
+    expected = aId - 1;
+    this_thread::yield();
+  }
+}
+
+int ItemDictionary::Probe(const Table* aTable,
+                          uint32_t aHash,
+                          const char* aName,
+                          size_t aLength) const {
+  uint32_t index = aHash & aTable->mask;
+  while (true) {
+    const uint64_t slot = aTable->slots[index].load(memory_order_acquire);
+    if (!slot) {
+      return 0;
+    }
+    if (static_cast<uint32_t>(slot >> 32) == aHash) {
+      const int id = static_cast<int>(slot & 0xffffffff);
+      const Entry& entry = GetEntry(id);
+      if (entry.length == aLength && memcmp(entry.name, aName, aLength) == 0) {
+        return id;
+      }
+    }
+    index = (index + 1) & aTable->mask;
+  }
+}
+
+int ItemDictionary::Find(const char* aName, size_t aLength) const {
+  const uint64_t hash = HashName(aName, aLength);
+  const Shard& shard = mShards[hash >> (64 - kShardBits)];
+  return Probe(shard.table.load(memory_order_acquire),
+               static_cast<uint32_t>(hash), aName, aLength);
+}
+
+int ItemDictionary::Intern(const char* aName, size_t aLength) {
+  const uint64_t hash = HashName(aName, aLength);
+  const uint32_t slotHash = static_cast<uint32_t>(hash);
+  Shard& shard = mShards[hash >> (64 - kShardBits)];
+  int id = Probe(shard.table.load(memory_order_acquire), slotHash, aName, aLength);
+  if (id) {
+    return id;
+  }
+
+  lock_guard<mutex> lock(shard.lock);
+  // Another thread may have inserted the name since we looked.
+  id = Probe(shard.table.load(memory_order_relaxed), slotHash, aName, aLength);
+  if (id) {
+    return id;
+  }
+  Table* table = shard.table.load(memory_order_relaxed);
+  if (2 * (shard.count + 1) > table->mask + 1) {
+    Grow(shard);
+    table = shard.table.load(memory_order_relaxed);
+  }
+
+  const uint32_t newId = mNextId.fetch_add(1, memory_order_relaxed);
+  Entry* entry = EnsureSegment(newId);
+  entry->name = CopyName(shard, aName, aLength);
+  entry->length = static_cast<uint32_t>(aLength);
+
+  // The id is published before the slot, so an id a reader finds is
+  // always covered by Size().
+  Publish(newId);
+
+  // Publishing the slot makes the entry visible to readers.
+  uint32_t index = slotHash & table->mask;
+  while (table->slots[index].load(memory_order_relaxed)) {
+    index = (index + 1) & table->mask;
+  }
+  table->slots[index].store((uint64_t(slotHash) << 32) | newId,
+                            memory_order_release);
+  shard.count++;
+  return static_cast<int>(newId);
+}
+
+ItemDictionary::Entry* ItemDictionary::EnsureSegment(uint32_t aId) {
+  const uint32_t segmentIndex = aId >> kSegmentBits;
+  if (segmentIndex >= kMaxSegments) {
+    cerr << "ERROR: Too many distinct items in data set; failing!" << endl;
+    exit(-1);
+  }
+  Entry* segment = mSegments[segmentIndex].load(memory_order_acquire);
+  if (!segment) {
+    lock_guard<mutex> lock(mSegmentLock);
+    segment = mSegments[segmentIndex].load(memory_order_relaxed);
+    if (!segment) {
+      segment = new Entry[kSegmentSize]();
+      mSegments[segmentIndex].store(segment, memory_order_release);
+    }
+  }
+  return &segment[aId & (kSegmentSize - 1)];
+}
+
+const char* ItemDictionary::CopyName(Shard& aShard,
+                                     const char* aName,
+                                     size_t aLength) {
+  const size_t size = aLength + 1;
+  if (size_t(aShard.end - aShard.cursor) < size) {
+    const size_t blockSize = max(size, kNameBlockSize);
+    aShard.blocks.emplace_back(new char[blockSize]);
+    aShard.cursor = aShard.blocks.back().get();
+    aShard.end = aShard.cursor + blockSize;
+  }
+  char* name = aShard.cursor;
+  memcpy(name, aName, aLength);
+  name[aLength] = 0;
+  aShard.cursor += size;
+  return name;
+}
+
+void ItemDictionary::Grow(Shard& aShard) {
+  const Table* old = aShard.table.load(memory_order_relaxed);
+  const uint32_t capacity = 2 * (old->mask + 1);
+  unique_ptr<Table> table(new Table(capacity));
+  for (uint32_t i = 0; i <= old->mask; i++) {
+    const uint64_t slot = old->slots[i].load(memory_order_relaxed);
+    if (!slot) {
+      continue;
+    }
+    uint32_t index = static_cast<uint32_t>(slot >> 32) & table->mask;
+    while (table->slots[index].load(memory_order_relaxed)) {
+      index = (index + 1) & table->mask;
+    }
+    table->slots[index].store(slot, memory_order_relaxed);
+  }
+  aShard.table.store(table.get(), memory_order_release);
+  aShard.tables.push_back(move(table));
+}
@@ -0,0 +1,136 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Maps item names to item ids, and ids back to names.
+//
+// Ids are assigned sequentially from 1, in the order names are first
+// interned. Names are copied into arena storage and never move, so the
+// pointers returned by GetName() stay valid until Reset().
+//
+// Intern() and the lookups are thread safe. Names are hashed to one of a
+// number of shards, each of which is an open addressing hash table. Reads
+// don't take locks; only inserting a new name locks its shard, so threads
+// interning different names rarely contend. Reset() is not thread safe.
+class ItemDictionary {
+public:
+  ItemDictionary();
+  ~ItemDictionary();
+
+  // Returns the id of the name [aName, aName + aLength), assigning the next
+  // id if the name hasn't been seen before.
+  int Intern(const char* aName, size_t aLength);
+
+  // Returns the id of the name, or 0 if it hasn't been interned.
+  int Find(const char* aName, size_t aLength) const;
+
+  // Returns true if |aId| has been assigned to a name.
+  bool Contains(int aId) const;
+
+  // Returns the null terminated name of the item with id |aId|. The item
+  // must have been interned.
+  const char* GetName(int aId) const {
+    return GetEntry(aId).name;
+  }
+
+  size_t GetNameLength(int aId) const {
+    return GetEntry(aId).length;
+  }
+
+  // Number of names interned. The entries of ids up to Size() are
+  // written, so their names can be read.
+  size_t Size() const {
+    return mNumPublished.load(std::memory_order_acquire);
+  }
+
+  // Forgets all names, and restarts id assignment from 1.
+  void Reset();
+
+private:
+  ItemDictionary(const ItemDictionary&) = delete;
+  ItemDictionary& operator=(const ItemDictionary&) = delete;
+
+  struct Entry {
+    const char* name;
+    uint32_t length;
+  };
+
+  // Slots pack the name's hash into the high 32 bits and its id into the low
+  // 32 bits, so that most mismatches are rejected without reading the name.
+  // A zero slot is empty.
+  struct Table {
+    explicit Table(uint32_t aCapacity);
+    uint32_t mask;
+    std::unique_ptr<std::atomic<uint64_t>[]> slots;
+  };
+
+  struct Shard {
+    std::mutex lock;
+    std::atomic<Table*> table;
+    uint32_t count = 0;
+    // Tables replaced by larger ones. Readers may still be probing them, so
+    // they live until Reset().
+    std::vector<std::unique_ptr<Table>> tables;
+    // Storage for names; blocks are never reallocated.
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* cursor = nullptr;
+    char* end = nullptr;
+  };
+
+  static const unsigned kShardBits = 6;
+  static const unsigned kNumShards = 1u << kShardBits;
+  static const unsigned kSegmentBits = 14;
+  static const uint32_t kSegmentSize = 1u << kSegmentBits;
+  static const uint32_t kMaxSegments = 1u << 16;
+
+  const Entry& GetEntry(int aId) const {
+    const uint32_t id = static_cast<uint32_t>(aId);
+    const Entry* segment =
+      mSegments[id >> kSegmentBits].load(std::memory_order_acquire);
+    return segment[id & (kSegmentSize - 1)];
+  }
+
+  // Returns the id stored in |aTable| for the name, or 0.
+  int Probe(const Table* aTable,
+            uint32_t aHash,
+            const char* aName,
+            size_t aLength) const;
+
+  Entry* EnsureSegment(uint32_t aId);
+  const char* CopyName(Shard& aShard, const char* aName, size_t aLength);
+  void Grow(Shard& aShard);
+  void InitShards();
+
+  // Marks newly written ids as readable through Size() and Contains().
+  // Ids are published in order, once the lower ids have been.
+  void Publish(uint32_t aId);
+
+  Shard mShards[kNumShards];
+  std::atomic<uint32_t> mNextId;
+  // Ids [1, mNumPublished] have their entries written. Ids are assigned
+  // before their entries are written, so mNextId can run ahead of this.
+  std::atomic<uint32_t> mNumPublished;
+
+  // Id to name table, allocated a segment at a time so that it never moves.
+  std::atomic<Entry*> mSegments[kMaxSegments];
+  std::mutex mSegmentLock;
+};
@@ -22,6 +22,107 @@
 
 using namespace std;
 
+SortedItemArray::SortedItemArray(const SortedItemArray& aOther) {
+  operator=(aOther);
+}
+
+SortedItemArray::SortedItemArray(SortedItemArray&& aOther) {
+  operator=(move(aOther));
+}
+
+SortedItemArray& SortedItemArray::operator=(const SortedItemArray& aOther) {
+  if (this == &aOther) {
+    return *this;
+  }
+  mSize = 0;
+  reserve(aOther.mSize);
+  copy(aOther.begin(), aOther.end(), Data());
+  mSize = aOther.mSize;
+  mHashSum = aOther.mHashSum;
+  return *this;
+}
+
+SortedItemArray& SortedItemArray::operator=(SortedItemArray&& aOther) {
+  if (this == &aOther) {
+    return *this;
+  }
+  if (!aOther.mHeap) {
+    return operator=(aOther);
+  }
+  // Take the other array's heap storage, and leave it empty and inline.
+  delete[] mHeap;
+  mHeap = aOther.mHeap;
+  mCapacity = aOther.mCapacity;
+  mSize = aOther.mSize;
+  mHashSum = aOther.mHashSum;
+  aOther.mHeap = nullptr;
+  aOther.mCapacity = kInlineCapacity;
+  aOther.clear();
+  return *this;
+}
+
+void SortedItemArray::reserve(size_t aCapacity) {
+  if (aCapacity <= mCapacity) {
+    return;
+  }
+  Item* heap = new Item[aCapacity];
+  copy(begin(), end(), heap);
+  delete[] mHeap;
+  mHeap = heap;
+  mCapacity = (uint32_t)aCapacity;
+}
+
+const Item* SortedItemArray::find(Item aItem) const {
+  const Item* first = begin();
+  const Item* last = end();
+  if (mSize <= kInlineCapacity) {
+    // Comparing ids is cheaper than the ordering comparison, and the array
+    // is short, so scan it.
+    const int id = aItem.GetId();
+    for (const Item* i = first; i != last; i++) {
+      if (i->GetId() == id) {
+        return i;
+      }
+    }
+    return last;
+  }
+  const Item* i = lower_bound(first, last, aItem);
+  return (i != last && *i == aItem) ? i : last;
+}
+
+bool SortedItemArray::insert(Item aItem) {
+  Item* first = Data();
+  Item* last = first + mSize;
+  Item* position = lower_bound(first, last, aItem);
+  if (position != last && *position == aItem) {
+    return false;
+  }
+  if (mSize == mCapacity) {
+    const size_t offset = position - first;
+    reserve(mCapacity * 2);
+    first = Data();
+    last = first + mSize;
+    position = first + offset;
+  }
+  copy_backward(position, last, last + 1);
+  *position = aItem;
+  mSize++;
+  mHashSum += HashId(aItem.GetId());
+  return true;
+}
+
+size_t SortedItemArray::erase(Item aItem) {
+  Item* position = const_cast<Item*>(find(aItem));
+  Item* last = Data() + mSize;
+  if (position == last) {
+    return 0;
+  }
+  copy(position + 1, last, position);
+  mSize--;
+  mHashSum -= HashId(aItem.GetId());
+  return 1;
+}
+
 ItemSet::ItemSet() {
 
 }
@@ -38,14 +139,16 @@ ItemSet::ItemSet(const char** aItems, int aNumItems) {
   }
 }
 
+ItemSet::ItemSet(const vector<Item>& aItems) {
+  mItems.reserve(aItems.size());
+  for (const Item item : aItems) {
+    mItems.insert(item);
+  }
+}
+
 
 ItemSet& ItemSet::operator+=(ItemSet& aOther) {
-  set<Item>::const_iterator itr = aOther.mItems.begin();
-  set<Item>::const_iterator end = aOther.mItems.end();
-  while (itr != end) {
-    operator+=(*itr);
-    itr++;
-  }
+  *this = ItemSet(*this, aOther);
   return *this;
 }
 
@@ -59,17 +162,15 @@ ItemSet& ItemSet::operator+=(Item aOther) {
 }
 
 bool ItemSet::operator==(const ItemSet& aOther) const {
-  if (Size() != aOther.Size()) {
+  if (Size() != aOther.Size() || mItems.HashSum() != aOther.mItems.HashSum()) {
     return false;
   }
-  set<Item>::const_iterator thisItr = mItems.begin();
-  set<Item>::const_iterator otherItr = aOther.mItems.begin();
-  while (thisItr != mItems.end()) {
-    if (*thisItr != *otherItr) {
+  // Both are sorted in the same order, so must match item for item.
+  const Item* other = aOther.mItems.begin();
+  for (const Item item : mItems) {
+    if (item.GetId() != (other++)->GetId()) {
       return false;
     }
-    thisItr++;
-    otherItr++;
   }
   return true;
 }
@@ -78,19 +179,13 @@ bool ItemSet::operator==(const vector<Item>& v) const {
   if (Size() != v.size()) {
     return false;
   }
-  auto vs = set<Item>(v.begin(), v.end());
-  return vs == mItems;
+  return *this == ItemSet(v);
 }
 
 ItemSet::operator string() const {
   vector<string> v;
-  set<Item>::const_iterator itr = mItems.begin();
-  set<Item>::const_iterator end = mItems.end();
-  while (itr != end) {
-    Item item = *itr;
-    string s = item;
-    v.push_back(s);
-    itr++;
+  for (const Item item : mItems) {
+    v.push_back(item);
   }
   sort(v.begin(), v.end());
   stringstream ss;
@@ -103,7 +198,6 @@ ItemSet::operator string() const {
   return ss.str();
 }
 
-
 ItemSet::ItemSet(const Item& aItem) {
   operator+=(aItem);
 }
@@ -146,39 +240,46 @@ bool ItemSet::operator<(const ItemSet& aOther) const {
     return true;
   } else if (otherSize < ourSize) {
     return false;
-  } else {
-    // Compare the entries...
-    set<Item>::const_iterator ourItr = mItems.begin();
-    set<Item>::const_iterator ourEnd = mItems.end();
-    set<Item>::const_iterator otherItr = aOther.mItems.begin();
-    while (ourItr != ourEnd) {
-      if ((*ourItr) != (*otherItr)) {
-        return (*ourItr) < (*otherItr);
-      }
-      ourItr++;
-      otherItr++;
+  }
+  // Compare the entries...
+  const Item* other = aOther.mItems.begin();
+  for (const Item item : mItems) {
+    if (item != *other) {
+      return item < *other;
     }
+    other++;
   }
   // Must be identical.
   return false;
 }
 
-void AddToSet(const set<Item>& aSrc, set<Item>& aDst) {
-  set<Item>::const_iterator itr = aSrc.begin();
-  set<Item>::const_iterator end = aSrc.end();
-  while (itr != end) {
-    aDst.insert(*itr);
-    itr++;
-  }
-}
-
-ItemSet::ItemSet(const ItemSet* o) {
-  AddToSet(o->mItems, mItems);
+ItemSet::ItemSet(const ItemSet* o)
+  : mItems(o->mItems) {
 }
 
 ItemSet::ItemSet(const ItemSet& aItemSet1, const ItemSet& aItemSet2) {
-  AddToSet(aItemSet1.mItems, mItems);
-  AddToSet(aItemSet2.mItems, mItems);
+  // Merge the sorted arrays.
+  mItems.reserve(aItemSet1.mItems.size() + aItemSet2.mItems.size());
+  const Item* a = aItemSet1.mItems.begin();
+  const Item* aEnd = aItemSet1.mItems.end();
+  const Item* b = aItemSet2.mItems.begin();
+  const Item* bEnd = aItemSet2.mItems.end();
+  while (a != aEnd && b != bEnd) {
+    if (*a == *b) {
+      mItems.push_back(*a++);
+      b++;
+    } else if (*a < *b) {
+      mItems.push_back(*a++);
+    } else {
+      mItems.push_back(*b++);
+    }
+  }
+  while (a != aEnd) {
+    mItems.push_back(*a++);
+  }
+  while (b != bEnd) {
+    mItems.push_back(*b++);
+  }
 }
 
 ItemSet ItemSet::operator-(Item i) const {
@@ -189,15 +290,7 @@ ItemSet ItemSet::operator-(Item i) const {
 
 vector<Item>
 ItemSet::AsVector() const {
-  vector<Item> v;
-  auto itr = mItems.begin();
-  auto end = mItems.end();
-  while (itr != end) {
-    Item item = *itr;
-    v.push_back(item);
-    itr++;
-  }
-  return v;
+  return vector<Item>(mItems.begin(), mItems.end());
 }
 
 void ItemSet::Clear() {
@@ -205,5 +298,5 @@ void ItemSet::Clear() {
 }
 
 bool ItemSet::Contains(Item& i) const {
-  return mItems.find(i) != mItems.end();
+  return mItems.count(i) != 0;
 }
@@ -16,12 +16,107 @@
 #define __ITEMSET_H__
 
 #include "Item.h"
+#include <stdint.h>
 #include <string>
 #include <set>
 #include <vector>
 
+// The items of an ItemSet, kept sorted by Item::operator< in a contiguous
+// array. Up to kInlineCapacity items are stored inline, so the small
+// itemsets which mining creates most of don't allocate. The sum of the
+// items' hashes is kept up to date as items are added and removed, so that
+// ItemSet::Hash() doesn't need to visit the items.
+class SortedItemArray {
+public:
+  typedef const Item* const_iterator;
+  typedef const Item* iterator;
+
+  static const uint32_t kInlineCapacity = 8;
+
+  SortedItemArray() {}
+  SortedItemArray(const SortedItemArray& aOther);
+  SortedItemArray(SortedItemArray&& aOther);
+  SortedItemArray& operator=(const SortedItemArray& aOther);
+  SortedItemArray& operator=(SortedItemArray&& aOther);
+  ~SortedItemArray() {
+    delete[] mHeap;
+  }
+
+  const Item* begin() const {
+    return Data();
+  }
+  const Item* end() const {
+    return Data() + mSize;
+  }
+  size_t size() const {
+    return mSize;
+  }
+  bool empty() const {
+    return mSize == 0;
+  }
+
+  // Returns end() if aItem isn't present.
+  const Item* find(Item aItem) const;
+  size_t count(Item aItem) const {
+    return find(aItem) != end();
+  }
+
+  // Returns true if aItem wasn't already present.
+  bool insert(Item aItem);
+  // Returns the number of items removed.
+  size_t erase(Item aItem);
+  void clear() {
+    mSize = 0;
+    mHashSum = 0;
+  }
+
+  void reserve(size_t aCapacity);
+
+  // Appends aItem, which must be greater than every item present.
+  void push_back(Item aItem) {
+    ASSERT(empty() || *(end() - 1) < aItem);
+    if (mSize == mCapacity) {
+      reserve(mCapacity * 2);
+    }
+    Data()[mSize++] = aItem;
+    mHashSum += HashId(aItem.GetId());
+  }
+
+  uint64_t HashSum() const {
+    return mHashSum;
+  }
+
+  // Finalizer from the SplitMix64 generator; spreads the bits of an id over
+  // the whole word.
+  static uint64_t Mix64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+
+private:
+  static uint64_t HashId(int aId) {
+    return Mix64((uint64_t)aId);
+  }
+
+  Item* Data() {
+    return mHeap ? mHeap : mInline;
+  }
+  const Item* Data() const {
+    return mHeap ? mHeap : mInline;
+  }
+
+  Item mInline[kInlineCapacity];
+  Item* mHeap = nullptr;
+  uint32_t mSize = 0;
+  uint32_t mCapacity = kInlineCapacity;
+  uint64_t mHashSum = 0;
+};
+
 class ItemSet {
 public:
+  typedef SortedItemArray::const_iterator const_iterator;
+
   ItemSet();
   // Convenience constructors, mostly for testing.
   ItemSet(const char* aItem);
@@ -31,10 +126,16 @@ public:
   ItemSet(const char* aItem1, const char* aItem2, const char* aItem3, const char* aItem4, const char* aItem5);
   ItemSet(const char** aItems, int aNumItems);
   ItemSet(const Item& aItem);
+  // Makes a set of the items in aItems, which may be in any order.
+  explicit ItemSet(const std::vector<Item>& aItems);
   // Merges two itemsets.
   ItemSet(const ItemSet& aItemSet1, const ItemSet& aItemSet2);
   // Clones an itemset.
   ItemSet(const ItemSet* o);
+  ItemSet(const ItemSet& o) = default;
+  ItemSet(ItemSet&& o) = default;
+  ItemSet& operator=(const ItemSet& o) = default;
+  ItemSet& operator=(ItemSet&& o) = default;
   ~ItemSet();
 
   bool IsNull() const {
@@ -58,9 +159,14 @@ public:
 
   bool Contains(Item&) const;
 
+  // Hash of the items' ids. Doesn't depend on the order the items are
+  // stored in, so it's the same whichever Item comparison mode is in use.
+  uint64_t Hash() const {
+    return SortedItemArray::Mix64(mItems.HashSum() + mItems.size());
+  }
 
-  std::set<Item> mItems;
+  SortedItemArray mItems;
 
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,116 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ItemSetTrie.h"
+#include "debug.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// Copies the ids of aItemSet's items into aIds in increasing order; items
+// are stored in the current Item comparison order, which may not be id
+// order. Returns the number of ids.
+static size_t GetSortedIds(const ItemSet& aItemSet, int* aIds) {
+  size_t n = 0;
+  for (const Item item : aItemSet.mItems) {
+    aIds[n++] = item.GetId();
+  }
+  sort(aIds, aIds + n);
+  return n;
+}
+
+ItemSetTrie::ItemSetTrie() {
+  Node root = {kRoot, 0, -1};
+  mNodes.push_back(root);
+}
+
+void ItemSetTrie::Insert(const ItemSet& aItemSet, int aCount) {
+  const unsigned kMaxStackItems = 32;
+  int stackIds[kMaxStackItems];
+  vector<int> heapIds;
+  int* ids = stackIds;
+  if (aItemSet.Size() > (int)kMaxStackItems) {
+    heapIds.resize(aItemSet.Size());
+    ids = heapIds.data();
+  }
+  Insert(ids, GetSortedIds(aItemSet, ids), aCount);
+}
+
+void ItemSetTrie::Insert(const int* aIds, size_t aNumIds, int aCount) {
+  ASSERT(aNumIds > 0);
+  ASSERT(aCount >= 0);
+  uint32_t node = kRoot;
+  for (size_t i = 0; i < aNumIds; i++) {
+    const uint32_t next = (uint32_t)mNodes.size();
+    auto result = mEdges.emplace(EdgeKey(node, aIds[i]), next);
+    if (result.second) {
+      Node child = {node, aIds[i], -1};
+      mNodes.push_back(child);
+    }
+    node = result.first->second;
+  }
+  if (mNodes[node].count < 0) {
+    mOrder.push_back(node);
+  }
+  mNodes[node].count = aCount;
+}
+
+int ItemSetTrie::Find(const ItemSet& aItemSet) const {
+  const unsigned kMaxStackItems = 32;
+  int stackIds[kMaxStackItems];
+  vector<int> heapIds;
+  int* ids = stackIds;
+  if (aItemSet.Size() > (int)kMaxStackItems) {
+    heapIds.resize(aItemSet.Size());
+    ids = heapIds.data();
+  }
+  const size_t numIds = GetSortedIds(aItemSet, ids);
+  if (!numIds) {
+    return -1;
+  }
+  uint32_t node = kRoot;
+  for (size_t i = 0; i < numIds; i++) {
+    auto itr = mEdges.find(EdgeKey(node, ids[i]));
+    if (itr == mEdges.end()) {
+      return -1;
+    }
+    node = itr->second;
+  }
+  return mNodes[node].count;
+}
+
+void ItemSetTrie::GetIds(uint32_t aNode, vector<int>& aIds) const {
+  aIds.clear();
+  for (uint32_t node = aNode; node != kRoot; node = mNodes[node].parent) {
+    aIds.push_back(mNodes[node].itemId);
+  }
+  reverse(aIds.begin(), aIds.end());
+}
+
+void ItemSetTrie::Append(const ItemSetTrie& aOther) {
+  vector<int> ids;
+  for (const uint32_t node : aOther.mOrder) {
+    aOther.GetIds(node, ids);
+    Insert(ids.data(), ids.size(), aOther.mNodes[node].count);
+  }
+}
+
+ItemSet ItemSetTrie::Get(size_t aIndex) const {
+  ItemSet itemset;
+  for (uint32_t node = mOrder[aIndex]; node != kRoot; node = mNodes[node].parent) {
+    itemset.Add(Item(mNodes[node].itemId));
+  }
+  return itemset;
+}
@@ -0,0 +1,79 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "ItemSet.h"
+
+// Stores mined itemsets with their absolute counts, so that rule generation
+// can look up the support of a rule's antecedent and consequent without
+// going back to the data set.
+//
+// Itemsets are stored as paths of item ids in increasing id order. Each
+// node's children are found through one hash table keyed by (parent node,
+// item id), so a lookup costs one probe per item. Itemsets are also kept
+// in insertion order, so they can be written out in the order they were
+// mined.
+class ItemSetTrie {
+public:
+  ItemSetTrie();
+
+  // Adds aItemSet, or updates its count if it's already in the trie.
+  void Insert(const ItemSet& aItemSet, int aCount);
+  // As above, for the itemset of the aNumIds item ids in increasing order.
+  void Insert(const int* aIds, size_t aNumIds, int aCount);
+
+  // Returns the count of aItemSet, or -1 if it's not in the trie.
+  int Find(const ItemSet& aItemSet) const;
+
+  // Inserts the itemsets in aOther, in the order they were inserted there.
+  void Append(const ItemSetTrie& aOther);
+
+  // Number of itemsets inserted.
+  size_t Size() const {
+    return mOrder.size();
+  }
+
+  // Returns the aIndex'th inserted itemset, and its count.
+  ItemSet Get(size_t aIndex) const;
+  int GetCount(size_t aIndex) const {
+    return mNodes[mOrder[aIndex]].count;
+  }
+
+private:
+  static const uint32_t kRoot = 0;
+
+  struct Node {
+    uint32_t parent;
+    int itemId;
+    // -1 for nodes which are only a prefix of inserted itemsets.
+    int count;
+  };
+
+  static uint64_t EdgeKey(uint32_t aParent, int aItemId) {
+    return (uint64_t(aParent) << 32) | uint32_t(aItemId);
+  }
+
+  void GetIds(uint32_t aNode, std::vector<int>& aIds) const;
+
+  std::vector<Node> mNodes;
+  std::unordered_map<uint64_t, uint32_t> mEdges;
+  // Nodes of the inserted itemsets, in insertion order.
+  std::vector<uint32_t> mOrder;
+};
@@ -0,0 +1,139 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+MappedFile::MappedFile()
+  : mData(nullptr),
+    mSize(0),
+    mIsOpen(false)
+#ifdef _WIN32
+  , mFile(INVALID_HANDLE_VALUE),
+    mMapping(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile() {
+  Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const string& aFileName) {
+  Close();
+  HANDLE file = CreateFileA(aFileName.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) {
+    CloseHandle(file);
+    return false;
+  }
+  mFile = file;
+  mIsOpen = true;
+  if (size.QuadPart == 0) {
+    // Can't map an empty file.
+    return true;
+  }
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping) {
+    Close();
+    return false;
+  }
+  mMapping = mapping;
+  mData = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  if (!mData) {
+    Close();
+    return false;
+  }
+  mSize = static_cast<size_t>(size.QuadPart);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (mData) {
+    UnmapViewOfFile(mData);
+  }
+  if (mMapping) {
+    CloseHandle(mMapping);
+  }
+  if (mFile != INVALID_HANDLE_VALUE) {
+    CloseHandle(mFile);
+  }
+  mData = nullptr;
+  mSize = 0;
+  mMapping = nullptr;
+  mFile = INVALID_HANDLE_VALUE;
+  mIsOpen = false;
+}
+
+#else
+
+bool MappedFile::Open(const string& aFileName) {
+  Close();
+  int fd = open(aFileName.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return false;
+  }
+  mIsOpen = true;
+  if (st.st_size == 0) {
+    // Can't map an empty file.
+    close(fd);
+    return true;
+  }
+  void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping holds its own reference to the file.
+  close(fd);
+  if (data == MAP_FAILED) {
+    mIsOpen = false;
+    return false;
+  }
+  // We read through the file once from start to end, so let the kernel
+  // read ahead aggressively.
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+  mData = static_cast<const char*>(data);
+  mSize = st.st_size;
+  return true;
+}
+
+void MappedFile::Close() {
+  if (mData) {
+    munmap(const_cast<char*>(mData), mSize);
+  }
+  mData = nullptr;
+  mSize = 0;
+  mIsOpen = false;
+}
+
+#endif
@@ -0,0 +1,54 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <string>
+
+// Read only memory mapping of an entire file.
+class MappedFile {
+public:
+  MappedFile();
+  ~MappedFile();
+
+  // Maps |aFileName| into memory. Returns false if the file can't be opened
+  // or mapped. An empty file opens successfully, with a null Data().
+  bool Open(const std::string& aFileName);
+  void Close();
+
+  bool IsOpen() const {
+    return mIsOpen;
+  }
+
+  const char* Data() const {
+    return mData;
+  }
+
+  size_t Size() const {
+    return mSize;
+  }
+
+private:
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* mData;
+  size_t mSize;
+  bool mIsOpen;
+#ifdef _WIN32
+  void* mFile;
+  void* mMapping;
+#endif
+};
@@ -25,12 +25,12 @@
 using namespace std;
 
 static Item GetItemWithLowestSupport(ItemSet& aItemSet, InvertedDataSetIndex& aIndex) {
-  set<Item>::const_iterator itr = aItemSet.mItems.begin();
-  set<Item>::const_iterator end = aItemSet.mItems.end();
+  ItemSet::const_iterator itr = aItemSet.mItems.begin();
+  ItemSet::const_iterator end = aItemSet.mItems.end();
   ASSERT(itr != end);
   Item item;
   Item minimum = *itr;
-  int lowest = aIndex.Count(item);
+  int lowest = aIndex.Count(minimum);
   itr++;
   while (itr != end) {
     item = *itr;
@@ -52,33 +52,31 @@ double factorial(double n) {
   return r;
 }
 
-double lfactorial(int n) {
-  double r = 0;
-  for (int i = 2; i <= n; i++) {
-    r += log((double)i);
+LogFactorialTable::LogFactorialTable(int aMaxN)
+  : mTable(max(aMaxN, 1) + 1, 0.0) {
+  for (size_t i = 2; i < mTable.size(); i++) {
+    mTable[i] = mTable[i - 1] + log((double)i);
   }
-  return r;
-}
-
-static double pval(int AB, int A, int B, int N) {
-  double logsum = lfactorial(B)
-                  + lfactorial(N - B)
-                  + lfactorial(A)
-                  + lfactorial(N - A)
-                  - lfactorial(AB)
-                  - lfactorial(B - AB)
-                  - lfactorial(A - AB)
-                  - lfactorial(N - A - B + AB)
-                  - lfactorial(N);
-  return exp(logsum);
 }
 
-int MinAbsSup(int A, int B, int N, double E) {
+int MinAbsSup(int A, int B, int N, double E, const LogFactorialTable& aTable) {
+  // Sum the hypergeometric probabilities of AB co-occurrences, from the
+  // fewest possible, until the tail reaches E. The terms of each
+  // probability which don't depend on AB are summed once.
+  const double logNumerator = aTable.Get(B)
+                              + aTable.Get(N - B)
+                              + aTable.Get(A)
+                              + aTable.Get(N - A)
+                              - aTable.Get(N);
   int limit = min(A, B);
   double sum = 0;
   int AB = max(0, A + B - N);
   for (; AB < limit; AB++) {
-    sum += pval(AB, A, B, N);
+    sum += exp(logNumerator
+               - aTable.Get(AB)
+               - aTable.Get(B - AB)
+               - aTable.Get(A - AB)
+               - aTable.Get(N - A - B + AB));
     if (sum > E) {
       return AB;
     }
@@ -86,14 +84,33 @@ int MinAbsSup(int A, int B, int N, double E) {
   return limit;
 }
 
-bool MinAbsSupFilter::Filter(ItemSet& aItemSet) const {
+int MinAbsSup(int A, int B, int N, double E) {
+  return MinAbsSup(A, B, N, E, LogFactorialTable(N));
+}
+
+int MinAbsSupFilter::GetThreshold(int aA, int aB) const {
+  const uint64_t key = (uint64_t(min(aA, aB)) << 32) | uint32_t(max(aA, aB));
+  {
+    lock_guard<mutex> lock(mThresholdsLock);
+    auto itr = mThresholds.find(key);
+    if (itr != mThresholds.end()) {
+      return itr->second;
+    }
+  }
+  // Computed outside the lock; threads racing on the same key compute the
+  // same value.
+  const int threshold = MinAbsSup(aA, aB, mIndex.NumTransactions(), 0.999,
+                                  mLogFactorials);
+  lock_guard<mutex> lock(mThresholdsLock);
+  mThresholds[key] = threshold;
+  return threshold;
+}
+
+bool MinAbsSupFilter::Filter(ItemSet& aItemSet, int& aCount) const {
   // Get constituent item with lowest support
   Item a = GetItemWithLowestSupport(aItemSet, mIndex);
   ItemSet b = aItemSet - a;
-  double minAbsSupValue = MinAbsSup(mIndex.Count(a),
-                                    mIndex.Count(b),
-                                    mIndex.NumTransactions(),
-                                    0.999);
-  return mIndex.Count(aItemSet) > minAbsSupValue;
+  const int minAbsSupValue = GetThreshold(mIndex.Count(a), mIndex.Count(b));
+  aCount = mIndex.Count(aItemSet);
+  return aCount > minAbsSupValue;
 }
-
@@ -53,6 +53,11 @@ static Mode sTypes[] = {
   {"DDTreeStream", kDDTreeStream},
   {"SSDD", kSSDD},
   {"DBDD", kDBDD},
+  {"convert", kConvert},
+  {"eclat", kEclat},
+  {"fpclose", kFPClose},
+  {"fpmax", kFPMax},
+  {"topk", kTopK},
 };
 
 eRunModeType GetRunMode(string& mode) {
@@ -73,6 +78,36 @@ string GetRunMode(eRunModeType kMode) {
   return "Error!";
 }
 
+struct AprioriCounting {
+  const char* name;
+  eAprioriCountingType type;
+};
+
+static AprioriCounting sAprioriCountingTypes[] = {
+  {"auto", kAutoCounting},
+  {"vertical", kVerticalCounting},
+  {"horizontal", kHorizontalCounting},
+};
+
+static bool GetAprioriCounting(const string& aName, eAprioriCountingType& aOutType) {
+  for (unsigned i = 0; i < ARRAY_LENGTH(sAprioriCountingTypes); ++i) {
+    if (aName == sAprioriCountingTypes[i].name) {
+      aOutType = sAprioriCountingTypes[i].type;
+      return true;
+    }
+  }
+  return false;
+}
+
+static const char* GetAprioriCountingName(eAprioriCountingType aType) {
+  for (unsigned i = 0; i < ARRAY_LENGTH(sAprioriCountingTypes); ++i) {
+    if (sAprioriCountingTypes[i].type == aType) {
+      return sAprioriCountingTypes[i].name;
+    }
+  }
+  return "Error!";
+}
+
 static bool ModeRequiresBlockSize(eRunModeType aMode) {
   switch (aMode) {
     case kFPTree:
@@ -272,14 +307,24 @@ bool ParseArgs(int argc, const char* argv[], Options& options) {
     return false;
   }
 
-  // Minsup, required for all modes except minabssup.
+  // Minsup, required for all modes except minabssup, convert and topk.
   if (options.mode == kMinAbssup) {
     if (args.find("-minsup") != args.end()) {
       cerr << "Fail: Don't need to specify a -minsup in in minabssup mode." << endl;
       return false;
     }
   }
-  if (!ParseDouble("minsup", args, options.minSup, true, 0)) {
+  if (!ParseDouble("minsup", args, options.minSup,
+                   options.mode != kMinAbssup && options.mode != kConvert &&
+                   options.mode != kTopK, 0)) {
+    return false;
+  }
+
+  if (!ParseInt("k", args, options.topK, options.mode == kTopK, 0)) {
+    return false;
+  }
+  if (options.mode == kTopK && options.topK < 1) {
+    cerr << "Fail: -k must be 1 or more." << endl;
     return false;
   }
 
@@ -298,6 +343,24 @@ bool ParseArgs(int argc, const char* argv[], Options& options) {
 
   options.countRulesOnly = ParseBoolArg("count-rules-only", args);
   options.countItemSetsOnly = ParseBoolArg("count-itemsets-only", args);
+  options.pipelineIngest = ParseBoolArg("pipeline-ingest", args);
+
+  if (!ParseInt("count-cache-mb", args, options.countCacheMB, false, DefaultCountCacheMB)) {
+    return false;
+  }
+  if (options.countCacheMB < 0) {
+    cerr << "Fail: -count-cache-mb must be 0 or more." << endl;
+    return false;
+  }
+
+  if (args.find("-apriori-counting") != args.end()) {
+    const string value = args["-apriori-counting"];
+    args.erase("-apriori-counting");
+    if (!GetAprioriCounting(value, options.aprioriCounting)) {
+      cerr << "Fail: -apriori-counting must be one of auto, vertical or horizontal." << endl;
+      return false;
+    }
+  }
 
   if (ModeRequiresCPSortInterval(options.mode) &&
       !ParseInt("cp-sort-interval", args, options.cpSortInterval, true, 0)) {
@@ -480,7 +543,7 @@ void PrintUsage() {
 
   cout << "Parameters:\n\n";
 
-  cout << "-i <input CSV file name> (*)\n";
+  cout << "-i <input CSV or binary data set file name> (*)\n";
   cout << "-m <mode> ; one of {";
   for (unsigned j = 0; j < ARRAY_LENGTH(sTypes); ++j) {
     cout << GetRunMode(sTypes[j].type) << ((j + 1 != ARRAY_LENGTH(sTypes)) ? ", " : "}\n");
@@ -488,12 +551,16 @@ void PrintUsage() {
   cout << "-o <output prefix> ; prepended to output files, can include a directory path. (*)\n";
   cout << "-minconf <c> ; sets minconf for rule pruning to c, optional, default=0.9.\n";
   cout << "-minlift <l> ; sets minlift for rule pruning to l, optional, default=1.0.\n";
-  cout << "-minsup <s> ; sets minimum support. Required for apriori or tree based mining.\n";
+  cout << "-minsup <s> ; sets minimum support. Required for apriori or tree based mining. In topk mode, optional, and a lower bound on the support of the itemsets mined.\n";
+  cout << "-k <n> ; sets the number of itemsets to mine in topk mode. Required for topk.\n";
   cout << "-automatic-ssdd-structural-drift-threshold ; sets automatic ssdd structural drift threshold. Required for SSDD mining.\n";
   cout << "-blockSize <s> ; sets blockSize. Required for stream based mining. (default 10000).\n";
   cout << "-n <threads> ; sets number of threads. Default=1, 0=autodetect, or specify number of threads to use. Note: not all algorithms are parallelized.\n";
   cout << "-count-rules-only ; only counts the rules, doesn't write them to disk.\n";
   cout << "-count-itemsets-only ; doesn't write itemsets or rules to disk, just counts itemsets.\n";
+  cout << "-count-cache-mb <m> ; memory for caching itemset counts during rule generation, in megabytes. Default=64, 0 disables the cache.\n";
+  cout << "-apriori-counting <auto|vertical|horizontal> ; how apriori counts candidates: by intersecting each candidate's transactions, in one pass over the data per generation, or choosing per generation by estimated cost. Default=auto.\n";
+  cout << "-pipeline-ingest ; parses the input on a background thread, overlapping parsing with index and tree updates and mining.\n";
   cout << "-cp-sort-interval <n> ; number of transactions between resorting tree in cptree mode.\n";
   cout << "-disc-sort-interval <n> ; number of transactions between resorting tree in disctree mode.\n";
   cout << "-log-tree-metrics=n1,n2,n,,, ; log tree size on transaction n1, n2, etc.\n";
@@ -509,7 +576,10 @@ void PrintUsage() {
   cout << GetOutputItemsetsFileName(string("<output prefix>"))
        << " - itemsets produced by run, with stats.\n";
   cout << GetOutputRuleFileName(string("<output prefix>"))
-       << " - rules produced by run, with stats.\n\n";
+       << " - rules produced by run, with stats.\n";
+  cout << GetOutputBinaryDataSetFileName(string("<output prefix>"))
+       << " - binary data set produced by convert mode. Pass this as the\n"
+       << "  input file to subsequent runs to skip parsing the CSV file.\n\n";
 }
 
 string GetTimeStr(time_t& t) {
@@ -525,12 +595,22 @@ void ShowOptions(Options& options) {
   Log("Output rules file: %s\n", GetOutputRuleFileName(options.outputFilePrefix).c_str());
   Log("Start time: %s\n", GetTimeStr(options.startTime).c_str());
   Log("Mode: %s\n", GetRunMode(options.mode).c_str());
-  if (options.mode == kApriori || options.mode == kFPTree) {
+  if (options.mode == kApriori || options.mode == kFPTree ||
+      options.mode == kEclat || options.mode == kFPClose ||
+      options.mode == kFPMax || options.mode == kTopK) {
     Log("Minsup: %lf\n", options.minSup);
   }
+  if (options.mode == kTopK) {
+    Log("Top k: %d\n", options.topK);
+  }
   Log("MinConf: %lf\n", options.minConf);
   Log("MinLift: %lf\n", options.minLift);
   //  if (options.mode == kExtrapTreeStream)
   //  Log("ExtrapMethod: &d", options.useKernelRegression);
   Log("Num threads: %u\n", options.numThreads);
+  Log("Pipeline ingest: %s\n", options.pipelineIngest ? "yes" : "no");
+  Log("Count cache: %dMB\n", options.countCacheMB);
+  if (options.mode == kApriori) {
+    Log("Apriori counting: %s\n", GetAprioriCountingName(options.aprioriCounting));
+  }
 }
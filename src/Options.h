@@ -38,10 +38,24 @@ enum eRunModeType {
   kDDTreeStream,
   kSSDD, // Structural Stream Drift Detector
   kDBDD, // Distribution Based Drift Detector
+  kConvert, // Convert data set to binary format
+  kEclat,
+  kFPClose, // Closed itemsets, mined from an FPTree
+  kFPMax, // Maximal itemsets, mined from an FPTree
+  kTopK, // The k most frequent itemsets, mined from an FPTree
+};
+
+// How Apriori counts the candidates in each generation.
+enum eAprioriCountingType {
+  kAutoCounting, // Choose per generation, by estimated cost.
+  kVerticalCounting, // Intersect the candidate's items' transactions.
+  kHorizontalCounting, // Count every candidate in one pass over the data.
 };
 
 std::string GetRunMode(eRunModeType kMode);
 
+static const int32_t DefaultCountCacheMB = 64;
+
 class Options {
 public:
 
@@ -59,6 +73,11 @@ public:
           int aBlockSize)
     : mode(aMode),
       minSup(aMinSup),
+      numThreads(1),
+      pipelineIngest(false),
+      countCacheMB(DefaultCountCacheMB),
+      aprioriCounting(kAutoCounting),
+      topK(0),
       cpSortInterval(aCpSortInterval),
       spoSortThreshold(aSpoSortThreshold),
       ExtrapSortThreshold(aExtrapSortThreshold),
@@ -85,6 +104,13 @@ public:
   double minLift;
   double minSup;
   int32_t numThreads;
+  // Parse the input on a background thread while mining.
+  bool pipelineIngest;
+  // Memory budget for caching itemset counts, in megabytes; 0 disables it.
+  int32_t countCacheMB;
+  eAprioriCountingType aprioriCounting;
+  // Number of itemsets to mine in topk mode.
+  int32_t topK;
   time_t startTime;
   bool countRulesOnly;
   bool countItemSetsOnly;
@@ -156,6 +182,10 @@ inline std::string GetOutputRuleFileName(std::string prefix, int i) {
   return prefix + ".rules.conf.lift.support-" + std::to_string(i) + ".csv";
 }
 
+inline std::string GetOutputBinaryDataSetFileName(std::string prefix) {
+  return prefix + ".harmbin";
+}
+
 std::string GetTimeStr(time_t& t);
 
 bool InitLog(Options& options);
@@ -14,48 +14,179 @@
 
 #include "PatternStream.h"
 #include "InvertedDataSetIndex.h"
+#include "ItemSetTrie.h"
 #include "utils.h"
 #include <stdio.h>
 #include <time.h>
+#include <string.h>
+#include <algorithm>
 #include <string>
 
 using namespace std;
 
+// Output is written to the stream in chunks of about this size.
+static const size_t kOutputBufferSize = 256 * 1024;
+
+// The items' names, and their ranks in alphabetical order of name, indexed
+// by item id. Patterns are written with their items sorted by name, and
+// sorting the ids by rank does that without converting each item to a
+// string. Shared, read only, by a stream and its forks.
+struct PatternNameTable {
+  explicit PatternNameTable(unsigned aNumItems);
+
+  unsigned NumItems() const {
+    return static_cast<unsigned>(ranks.size()) - 1;
+  }
+
+  vector<const char*> names;
+  vector<uint32_t> lengths;
+  vector<uint32_t> ranks;
+};
+
+PatternNameTable::PatternNameTable(unsigned aNumItems)
+  : names(aNumItems + 1, "")
+  , lengths(aNumItems + 1, 0)
+  , ranks(aNumItems + 1, 0)
+{
+  vector<int> order;
+  order.reserve(aNumItems);
+  for (unsigned id = 1; id <= aNumItems; id++) {
+    names[id] = Item(id).GetName();
+    lengths[id] = static_cast<uint32_t>(Item(id).GetNameLength());
+    order.push_back(id);
+  }
+  // The same order as comparing the names as std::strings.
+  sort(order.begin(), order.end(), [&](int a, int b) {
+    const int cmp = memcmp(names[a], names[b], min(lengths[a], lengths[b]));
+    return cmp < 0 || (cmp == 0 && lengths[a] < lengths[b]);
+  });
+  for (uint32_t rank = 0; rank < order.size(); rank++) {
+    ranks[order[rank]] = rank;
+  }
+}
+
+// Sorts a pattern's few ids with an insertion sort, which doesn't allocate.
+template<typename Less>
+static void SortIds(int* ids, size_t numIds, Less less) {
+  for (size_t i = 1; i < numIds; i++) {
+    const int id = ids[i];
+    size_t j = i;
+    for (; j > 0 && less(id, ids[j - 1]); j--) {
+      ids[j] = ids[j - 1];
+    }
+    ids[j] = id;
+  }
+}
+
 PatternOutputStream::PatternOutputStream(shared_ptr<ostream> _stream,
                                          DataSet* _index)
   : index(_index)
-  , numPatterns(0)
   , stream(move(_stream))
+  , names(make_shared<PatternNameTable>(Item::NumItems()))
+  , numPatterns(0)
+{
+  output.reserve(kOutputBufferSize);
+}
+
+PatternOutputStream::PatternOutputStream(PatternOutputStream&& other)
+  : index(other.index)
+  , stream(move(other.stream))
+  , forked(other.forked)
+  , output(move(other.output))
+  , names(move(other.names))
+  , ids(move(other.ids))
+  , patterns(move(other.patterns))
+  , useMinedCounts(other.useMinedCounts)
+  , numPatterns(other.numPatterns)
 {
+  other.output.clear();
 }
 
 PatternOutputStream&
 PatternOutputStream::operator=(PatternOutputStream&& other)
 {
+  Flush();
   index = other.index;
   stream = move(other.stream);
+  forked = other.forked;
+  output = move(other.output);
+  other.output.clear();
+  names = move(other.names);
+  ids = move(other.ids);
+  patterns = move(other.patterns);
+  useMinedCounts = other.useMinedCounts;
   numPatterns = other.numPatterns;
   return *this;
 }
 
-void PatternOutputStream::Write(const vector<Item>& pattern) {
-  if (pattern.size() == 0) {
+PatternOutputStream::~PatternOutputStream() {
+  Flush();
+}
+
+void PatternOutputStream::RecordPatterns(shared_ptr<ItemSetTrie> _patterns) {
+  patterns = move(_patterns);
+}
+
+PatternOutputStream PatternOutputStream::Fork() const {
+  PatternOutputStream forked;
+  if (!IsFakeWriter()) {
+    forked.forked = true;
+    forked.index = index;
+    forked.names = names;
+    forked.useMinedCounts = useMinedCounts;
+    if (patterns) {
+      forked.patterns = make_shared<ItemSetTrie>();
+    }
+  }
+  return forked;
+}
+
+void PatternOutputStream::Join(const PatternOutputStream& forked) {
+  numPatterns += forked.numPatterns;
+  if (IsFakeWriter() || !forked.forked) {
     return;
   }
+  output.append(forked.output);
+  if (!this->forked && output.size() >= kOutputBufferSize) {
+    Flush();
+  }
+  if (patterns && forked.patterns) {
+    patterns->Append(*forked.patterns);
+  }
+}
+
+void PatternOutputStream::Write(const vector<Item>& pattern, int count) {
+  Write(pattern.data(), pattern.size(), count);
+}
 
+void PatternOutputStream::Write(const Item* items, size_t numItems, int count) {
+  if (numItems == 0) {
+    return;
+  }
+
+  numPatterns++;
   if (IsFakeWriter()) {
-    numPatterns++;
     return;
   }
 
-  ItemSet itemset;
-  for (int i = pattern.size() - 1; i >= 0; --i) {
-    itemset.Add(pattern[i]);
+  if (!useMinedCounts || count < 0) {
+    // The count must come from the index, which counts ItemSets. The
+    // scratch itemset keeps its storage between patterns.
+    scratch.Clear();
+    for (size_t i = 0; i < numItems; i++) {
+      scratch.Add(items[i]);
+    }
+    count = (index) ? index->Count(scratch) : 0;
+  }
+
+  ids.resize(numItems);
+  for (size_t i = 0; i < numItems; i++) {
+    ids[i] = items[i].GetId();
   }
-  Write(itemset);
+  WriteIds(ids.data(), numItems, count);
 }
 
-void PatternOutputStream::Write(const ItemSet& itemset) {
+void PatternOutputStream::Write(const ItemSet& itemset, int count) {
   if (itemset.IsNull()) {
     return;
   }
@@ -65,12 +196,61 @@ void PatternOutputStream::Write(const ItemSet& itemset) {
     return;
   }
 
-  string s = itemset;
-  double sup = (index) ? index->Support(itemset) : 0;
-  (*stream) << s << "," << sup << "\n";
+  if (!useMinedCounts || count < 0) {
+    count = (index) ? index->Count(itemset) : 0;
+  }
+  ASSERT(!index || count == index->Count(itemset));
+  ids.clear();
+  for (const Item item : itemset.mItems) {
+    ids.push_back(item.GetId());
+  }
+  WriteIds(ids.data(), ids.size(), count);
+}
+
+void PatternOutputStream::WriteIds(int* ids, size_t numIds, int count) {
+  if (patterns) {
+    SortIds(ids, numIds, [](int a, int b) { return a < b; });
+    patterns->Insert(ids, numIds, count);
+  }
+
+  // Items may have been added since the name table was made.
+  int maxId = 0;
+  for (size_t i = 0; i < numIds; i++) {
+    maxId = max(maxId, ids[i]);
+  }
+  if (!names || (unsigned)maxId > names->NumItems()) {
+    names = make_shared<PatternNameTable>(Item::NumItems());
+  }
+
+  const vector<uint32_t>& ranks = names->ranks;
+  SortIds(ids, numIds, [&](int a, int b) { return ranks[a] < ranks[b]; });
+  for (size_t i = 0; i < numIds; i++) {
+    if (i > 0) {
+      output.push_back(' ');
+    }
+    output.append(names->names[ids[i]], names->lengths[ids[i]]);
+  }
+
+  // Formatted as operator<< formats a double by default.
+  const double sup = (index) ? (double)count / (double)index->NumTransactions() : 0;
+  char buf[32];
+  const int length = snprintf(buf, sizeof(buf), ",%g\n", sup);
+  output.append(buf, length);
+
+  if (!forked && output.size() >= kOutputBufferSize) {
+    Flush();
+  }
+}
+
+void PatternOutputStream::Flush() {
+  if (stream && !output.empty()) {
+    stream->write(output.data(), output.size());
+    output.clear();
+  }
 }
 
 void PatternOutputStream::Close() {
+  Flush();
   ASSERT(IsFakeWriter() || !stream || stream->good());
   if (stream) {
     stream->flush();
@@ -16,13 +16,17 @@
 #define __PATTERN_STREAM_H__
 
 #include <fstream>
+#include <sstream>
 #include <vector>
 #include <memory>
+#include <string>
 #include <stdint.h>
 #include "ItemSet.h"
 
 class PatternStreamWriter;
 class DataSet;
+class ItemSetTrie;
+struct PatternNameTable;
 
 class PatternOutputStream {
 public:
@@ -34,11 +38,43 @@ public:
   // Creates a PatternOutputStream that writes (patterns,count) to _stream.
   PatternOutputStream(std::shared_ptr<std::ostream> _stream, DataSet* index);
 
+  PatternOutputStream(PatternOutputStream&& other);
   PatternOutputStream& operator=(PatternOutputStream&& other);
 
-  // Synchronously writes pattern to stream.
-  void Write(const ItemSet& pattern);
-  void Write(const std::vector<Item>& pattern);
+  // Writes out anything still buffered.
+  ~PatternOutputStream();
+
+  // Creates a stream which buffers its patterns in memory, so that it can be
+  // written to by another thread and later appended to this stream by Join().
+  // Forking a fake stream creates another fake stream.
+  PatternOutputStream Fork() const;
+
+  // Appends the patterns buffered in a stream created by Fork() to this
+  // stream. Not thread safe; only the thread that owns this stream may
+  // call Join().
+  void Join(const PatternOutputStream& forked);
+
+  // Also stores each pattern written, with its count, in |patterns|.
+  // Streams forked from this one record into their own trie, which Join()
+  // appends to this one.
+  void RecordPatterns(std::shared_ptr<ItemSetTrie> patterns);
+
+  // Trust the counts passed to Write() rather than counting each pattern
+  // in the index. Only valid when the miner's counts are taken over the
+  // same transactions as the index holds.
+  void UseMinedCounts() {
+    useMinedCounts = true;
+  }
+
+  // Writes pattern to the stream's output buffer, which is written to the
+  // stream once it's large, and on Close(). |count| is the number of
+  // transactions the miner found the pattern in, or -1 if unknown.
+  void Write(const ItemSet& pattern, int count = -1);
+  void Write(const std::vector<Item>& pattern, int count = -1);
+  // As above, for the pattern of the distinct items [items, items +
+  // numItems), in any order. This formats the pattern straight from the
+  // item ids, without allocating.
+  void Write(const Item* items, size_t numItems, int count = -1);
 
   int64_t GetNumPatterns() const {
     return numPatterns;
@@ -48,10 +84,27 @@ public:
 
 private:
 
-  bool IsFakeWriter() const { return !stream && !index; }
+  bool IsFakeWriter() const { return !stream && !index && !forked; }
+
+  // Formats the pattern of the |numIds| item ids in |ids| into |output|, and
+  // records it. Reorders |ids|.
+  void WriteIds(int* ids, size_t numIds, int count);
+
+  // Writes |output| to |stream|.
+  void Flush();
 
   DataSet* index = nullptr;
   std::shared_ptr<std::ostream> stream;
+  // True for a stream created by Fork(), whose output stays in |output|
+  // until it's joined.
+  bool forked = false;
+  std::string output;
+  std::shared_ptr<const PatternNameTable> names;
+  std::vector<int> ids;
+  // Holds patterns written from item spans while the index counts them.
+  ItemSet scratch;
+  std::shared_ptr<ItemSetTrie> patterns;
+  bool useMinedCounts = false;
   unsigned numPatterns = 0;
 };
 
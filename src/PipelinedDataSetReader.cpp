@@ -0,0 +1,138 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "PipelinedDataSetReader.h"
+
+using namespace std;
+
+PipelinedDataSetReader::PipelinedDataSetReader(unique_ptr<DataSetReader> aSource,
+                                               unsigned aBatchSize,
+                                               unsigned aNumBatches)
+  : mSource(move(aSource)),
+    mBatchSize(max(aBatchSize, 1u)),
+    mRing(max(aNumBatches, 1u)),
+    mProduced(0),
+    mConsumed(0) {
+  for (Batch& batch : mRing) {
+    batch.transactions.resize(mBatchSize);
+  }
+}
+
+PipelinedDataSetReader::~PipelinedDataSetReader() {
+  Stop();
+}
+
+bool PipelinedDataSetReader::IsGood() {
+  return mSource->IsGood();
+}
+
+bool PipelinedDataSetReader::Rewind() {
+  Stop();
+  return mSource->Rewind();
+}
+
+bool PipelinedDataSetReader::GetItemFrequencies(ItemMap<unsigned>& aOutFrequencies) {
+  // The source can't be used while the parser thread is reading it.
+  Stop();
+  return mSource->GetItemFrequencies(aOutFrequencies);
+}
+
+void PipelinedDataSetReader::Start() {
+  mProduced = 0;
+  mConsumed = 0;
+  mNextInBatch = 0;
+  mFinished = false;
+  mStop = false;
+  mStarted = true;
+  mParser = thread(&PipelinedDataSetReader::ParseLoop, this);
+}
+
+void PipelinedDataSetReader::Stop() {
+  if (!mStarted) {
+    return;
+  }
+  {
+    lock_guard<mutex> lock(mMutex);
+    mStop = true;
+  }
+  mCanProduce.notify_one();
+  mParser.join();
+  mStarted = false;
+}
+
+void PipelinedDataSetReader::ParseLoop() {
+  const uint64_t ringSize = mRing.size();
+  while (true) {
+    const uint64_t produced = mProduced.load(memory_order_relaxed);
+    {
+      unique_lock<mutex> lock(mMutex);
+      mCanProduce.wait(lock, [&]() {
+        return mStop || produced - mConsumed.load(memory_order_acquire) < ringSize;
+      });
+      if (mStop) {
+        return;
+      }
+    }
+    Batch& batch = mRing[produced % ringSize];
+    batch.count = 0;
+    batch.isLast = false;
+    while (batch.count < mBatchSize) {
+      if (!mSource->GetNext(batch.transactions[batch.count])) {
+        batch.isLast = true;
+        break;
+      }
+      batch.count++;
+    }
+    {
+      lock_guard<mutex> lock(mMutex);
+      mProduced.store(produced + 1, memory_order_release);
+    }
+    mCanConsume.notify_one();
+    if (batch.isLast) {
+      return;
+    }
+  }
+}
+
+bool PipelinedDataSetReader::GetNext(vector<Item>& aTransaction) {
+  aTransaction.clear();
+  if (!mStarted) {
+    Start();
+  }
+  while (!mFinished) {
+    const uint64_t consumed = mConsumed.load(memory_order_relaxed);
+    if (mProduced.load(memory_order_acquire) == consumed) {
+      unique_lock<mutex> lock(mMutex);
+      mCanConsume.wait(lock, [&]() {
+        return mProduced.load(memory_order_acquire) != consumed;
+      });
+    }
+    Batch& batch = mRing[consumed % mRing.size()];
+    if (mNextInBatch < batch.count) {
+      // Swap rather than copy; the parser thread reuses the storage of the
+      // vector we hand back.
+      swap(aTransaction, batch.transactions[mNextInBatch]);
+      mNextInBatch++;
+      return true;
+    }
+    mFinished = batch.isLast;
+    mNextInBatch = 0;
+    {
+      lock_guard<mutex> lock(mMutex);
+      mConsumed.store(consumed + 1, memory_order_release);
+    }
+    mCanProduce.notify_one();
+  }
+  return false;
+}
@@ -0,0 +1,87 @@
+// Copyright 2014, Chris Pearce & Yun Sing Koh
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "DataSetReader.h"
+
+// Reads transactions from another DataSetReader on a background thread, so
+// that reading and parsing the input overlaps with whatever the caller does
+// with each transaction; updating the index, inserting into the tree and
+// mining.
+//
+// Parsed transactions are handed over in batches through a bounded single
+// producer, single consumer ring. When the ring is full the parser thread
+// blocks until the consumer catches up, so memory use stays bounded no
+// matter how far ahead parsing could run.
+//
+// The source is read by a single thread so that items are still interned
+// in the order they first appear in the data set, and so are assigned the
+// same ids as when the source is read directly.
+class PipelinedDataSetReader : public DataSetReader {
+public:
+  PipelinedDataSetReader(std::unique_ptr<DataSetReader> aSource,
+                         unsigned aBatchSize = 256,
+                         unsigned aNumBatches = 16);
+  ~PipelinedDataSetReader();
+
+  bool IsGood() override;
+
+  bool Rewind() override;
+
+  bool GetNext(std::vector<Item>& aTransaction) override;
+
+  bool GetItemFrequencies(ItemMap<unsigned>& aOutFrequencies) override;
+
+private:
+  struct Batch {
+    std::vector<std::vector<Item>> transactions;
+    size_t count = 0;
+    // True if the source has no more transactions after this batch.
+    bool isLast = false;
+  };
+
+  void Start();
+  void Stop();
+  void ParseLoop();
+
+  std::unique_ptr<DataSetReader> mSource;
+  const unsigned mBatchSize;
+
+  std::vector<Batch> mRing;
+  // Number of batches produced and consumed. The producer owns slot
+  // mProduced % size until it's published, the consumer owns slot
+  // mConsumed % size until it's released.
+  std::atomic<uint64_t> mProduced;
+  std::atomic<uint64_t> mConsumed;
+
+  std::mutex mMutex;
+  std::condition_variable mCanProduce;
+  std::condition_variable mCanConsume;
+  bool mStop = false;
+
+  std::thread mParser;
+  bool mStarted = false;
+
+  // Consumer's position in the batch at mConsumed.
+  size_t mNextInBatch = 0;
+  bool mFinished = false;
+};
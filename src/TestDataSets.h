@@ -17,7 +17,24 @@
 #include <string>
 #include <memory>
 #include <sstream>
+#include <utility>
+#include <vector>
 #include "DataSetReader.h"
+#include "FPNode.h"
+#include "FPTree.h"
+#include "InvertedDataSetIndex.h"
+#include "ItemSetTrie.h"
+#include "Options.h"
+#include "PatternStream.h"
+
+extern FPTree* CreateFPTree(DataSet* aDataSet, Options& options);
+
+extern void ParallelFPGrowth(FPTree* tree,
+                             PatternOutputStream& output,
+                             const double minCount,
+                             unsigned nodePruneDepth,
+                             ItemFilter* filter,
+                             unsigned numThreads);
 
 std::unique_ptr<DataSetReader> Test1DataSetReader()
 {
@@ -245,3 +262,44 @@ std::unique_ptr<DataSetReader> UCIZooDataSetReader()
     "wren,hair=0,feathers=1,eggs=1,milk=0,airbourne=1,aquatic=0,predactor=0,toothed=0,backbone=1,breathes=1,venomous=0,fins=0,legs=2,tail=1,domestic=0,catsize=0,type=2\n";
   return std::make_unique<DataSetReader>(std::make_unique<std::istringstream>(data));
 }
+
+// The UCI zoo data set in an InvertedDataSetIndex, and an FPTree of it built
+// for aMode, for testing the mining modes against FP-Growth.
+class UCIZooFixture {
+public:
+  explicit UCIZooFixture(eRunModeType aMode)
+    : index(UCIZooDataSetReader())
+  {
+    Item::SetCompareMode(Item::ALPHABETIC_COMPARE);
+    Options options(0, aMode, 0, 0, 0, 0, 0, 0, 0);
+    tree = CreateFPTree(&index, options);
+    index.Load();
+  }
+
+  ~UCIZooFixture() {
+    delete tree;
+  }
+
+  // The itemsets with count at least aMinCount, and their counts, as mined
+  // by FP-Growth.
+  std::vector<std::pair<ItemSet, int>> FrequentItemSets(double aMinCount) {
+    PatternOutputStream output(std::make_shared<std::ostringstream>(), &index);
+    std::shared_ptr<ItemSetTrie> patterns(std::make_shared<ItemSetTrie>());
+    output.RecordPatterns(patterns);
+    output.UseMinedCounts();
+    ParallelFPGrowth(tree, output, aMinCount, UINT32_MAX, nullptr, 1);
+    output.Close();
+    std::vector<std::pair<ItemSet, int>> itemsets;
+    for (size_t i = 0; i < patterns->Size(); i++) {
+      itemsets.push_back(std::make_pair(patterns->Get(i), patterns->GetCount(i)));
+    }
+    return itemsets;
+  }
+
+  InvertedDataSetIndex index;
+  FPTree* tree;
+
+private:
+  UCIZooFixture(const UCIZooFixture&) = delete;
+  UCIZooFixture& operator=(const UCIZooFixture&) = delete;
+};
@@ -39,7 +39,7 @@ bool VariableWindowDataSet::Load() {
   return false;
 }
 
-int VariableWindowDataSet::Count(const ItemSet& aItemSet) const {
+int VariableWindowDataSet::CountItemSet(const ItemSet& aItemSet) const {
   auto& items = aItemSet.mItems;
 
   // Find item with the shortest tidlist.
@@ -133,6 +133,7 @@ void VariableWindowDataSet::Append(const Transaction& transaction) {
     chunk.set(bit_num, 1);
   }
   transactions.push_back(transaction);
+  InvalidateCountCache();
 }
 
 const Transaction& VariableWindowDataSet::Front() {
@@ -175,4 +176,5 @@ void VariableWindowDataSet::Pop() {
     first_chunk_start_tid += chunk_size;
   }
   transactions.pop_front();
+  InvalidateCountCache();
 }
@@ -31,7 +31,7 @@ public:
 
   // DataSet overrides.
   bool Load() override; // Not implemented.
-  int Count(const ItemSet& aItemSet) const override;
+  using DataSet::Count;
   int Count(const Item& aItem) const override;
   unsigned NumTransactions() const override;
   bool IsLoaded() const override; // Not implemented.
@@ -47,6 +47,10 @@ public:
   // Size (in bits) for each bitset chunk in the inverted index.
   static const uint32_t chunk_size = 128;
 
+protected:
+
+  int CountItemSet(const ItemSet& aItemSet) const override;
+
 private:
 
   // Number of items that we reserve space for in the inverted index.
@@ -20,6 +20,7 @@
 
 #include <time.h>
 #include <stdlib.h>
+#include <algorithm>
 
 #include "Item.h"
 #include "ItemSet.h"
@@ -45,18 +46,6 @@ WindowIndex::WindowIndex(std::unique_ptr<DataSetReader> aReader,
 }
 
 WindowIndex::~WindowIndex() {
-  for (unsigned i = 0; i < mIndex.size(); ++i) {
-    delete mIndex[i];
-  }
-  mIndex.clear();
-}
-
-static inline unsigned GetChunkIndex(unsigned aTid, unsigned aWindowLength) {
-  return (aTid % aWindowLength) / (8 * sizeof(unsigned));
-}
-
-static inline unsigned GetChunkBitNum(unsigned aTid, unsigned aWindowLength) {
-  return (aTid % aWindowLength) % (8 * sizeof(unsigned));
 }
 
 void WindowIndex::Set(unsigned aTid, Item aItem, bool aValue) {
@@ -64,62 +53,20 @@ void WindowIndex::Set(unsigned aTid, Item aItem, bool aValue) {
   if (index >= mIndex.size()) {
     mIndex.resize(index + 1);
   }
-  if (!mIndex[index]) {
-    unsigned len = mMaxLength / (8 * sizeof(unsigned)) + 1;
-    mIndex[index] = new unsigned[len];
-    if (!mIndex[index]) {
-      cerr << "Malloc failure constructing WindowIndex" << endl;
-      exit(-1);
-    }
-    memset(mIndex[index], 0, sizeof(unsigned) * len);
-  }
-  unsigned* tidlist = mIndex[index];
-  unsigned chunkIndex = GetChunkIndex(aTid, mMaxLength);
-  unsigned bitNum = GetChunkBitNum(aTid, mMaxLength);
-  ASSERT(bitNum < 32);
-  unsigned chunk = tidlist[chunkIndex];
-  unsigned chunkBefore = chunk;
+  const unsigned position = aTid % mMaxLength;
   if (aValue) {
-    chunk |= (1u << bitNum);
+    mIndex[index].Add(position);
   } else {
-    chunk &= (~0 - (1u << bitNum));
+    mIndex[index].Remove(position);
   }
-  tidlist[chunkIndex] = chunk;
-  if ((chunkBefore == 0 || chunk == 0) &&
-      chunkBefore != chunk) {
-    MarkChunkUsage(aItem, chunkIndex, chunk != 0);
-  }
-  ASSERT(mActiveChunks[aItem.GetIndex()].count(chunkIndex) > 0 == chunk > 0);
   ASSERT(Get(aTid, aItem) == aValue);
 }
 
-void WindowIndex::MarkChunkUsage(Item aItem, unsigned aChunkIndex, bool aUsed) {
-  unsigned itemIndex = aItem.GetIndex();
-  if (itemIndex >= mActiveChunks.size()) {
-    mActiveChunks.resize(itemIndex + 1);
-  }
-  set<unsigned>& activeChunks = mActiveChunks[itemIndex];
-  if (aUsed) {
-    activeChunks.insert(aChunkIndex);
-    ASSERT(activeChunks.count(aChunkIndex) == 1);
-    ASSERT(mActiveChunks[itemIndex].count(aChunkIndex) == 1);
-  } else {
-    activeChunks.erase(aChunkIndex);
-    ASSERT(activeChunks.count(aChunkIndex) == 0);
-    ASSERT(mActiveChunks[itemIndex].count(aChunkIndex) == 0);
-  }
-}
-
 bool WindowIndex::Get(unsigned aTid, Item aItem) const {
-  if (aItem.GetIndex() >= mIndex.size() ||
-      mIndex[aItem.GetIndex()] == 0) {
+  if (aItem.GetIndex() >= mIndex.size()) {
     return false;
   }
-  unsigned* tidlist = mIndex[aItem.GetIndex()];
-  unsigned index = GetChunkIndex(aTid, mMaxLength);
-  unsigned bitNum = GetChunkBitNum(aTid, mMaxLength);
-  unsigned chunk = tidlist[index];
-  return (chunk & (1u << bitNum)) != 0;
+  return mIndex[aItem.GetIndex()].Contains(aTid % mMaxLength);
 }
 
 void WindowIndex::VerifyWindow(unsigned aWindowFrontTxnNum) const {
@@ -168,8 +115,6 @@ bool WindowIndex::Load() {
       unsigned frontTxnNum = transactionNum - mMaxLength;
       ASSERT((frontTxnNum % mMaxLength) == transactionNum % mMaxLength);
       // Window is full, remove first transaction in the window from the index.
-      ASSERT(GetChunkBitNum(frontTxnNum, mMaxLength) == GetChunkBitNum(transactionNum, mMaxLength));
-      ASSERT(GetChunkIndex(frontTxnNum, mMaxLength) == GetChunkIndex(transactionNum, mMaxLength));
       vector<Item>& txn = mWindow.front();
       for (unsigned i = 0; i < txn.size(); ++i) {
         Set(frontTxnNum, txn[i], false);
@@ -177,6 +122,7 @@ bool WindowIndex::Load() {
       mWindow.pop();
     }
     mWindow.push(transaction);
+    InvalidateCountCache();
 
     // Set each item's bit
     for (unsigned i = 0; i < transaction.size(); ++i) {
@@ -203,73 +149,43 @@ bool WindowIndex::Load() {
   return true;
 }
 
-unsigned WindowIndex::GetNumActiveChunks(Item aItem) const {
-  unsigned index = aItem.GetIndex();
-  if (index >= mActiveChunks.size()) {
-    return 0;
-  }
-  return mActiveChunks[index].size();
-}
-
 bool WindowIndex::IsLoaded() const {
   return mLoaded;
 }
 
-int WindowIndex::Count(const ItemSet& aItemSet) const {
-  // Find the item in the set with the smallest number of non-zero chunks
-  // in its bitset row.
-  Item sparsest;
-  unsigned sparsestNumChunks = UINT_MAX;
-  {
-    set<Item>::const_iterator itr = aItemSet.mItems.begin();
-    set<Item>::const_iterator end = aItemSet.mItems.end();
-    while (itr != end) {
-      Item item = (*itr);
-      unsigned numChunks = GetNumActiveChunks(item);
-      if (numChunks < sparsestNumChunks) {
-        sparsest = item;
-        sparsestNumChunks = numChunks;
-      }
-      itr++;
+int WindowIndex::CountItemSet(const ItemSet& aItemSet) const {
+  // Intersect the items' tid lists, starting with the shortest.
+  vector<const HybridTidList*> tidLists;
+  tidLists.reserve(aItemSet.Size());
+  for (const Item item : aItemSet.mItems) {
+    if (item.GetIndex() >= mIndex.size() || mIndex[item.GetIndex()].IsEmpty()) {
+      // One item doesn't appear anywhere! The union of all items can't
+      // be more frequent!
+      return 0;
     }
+    tidLists.push_back(&mIndex[item.GetIndex()]);
   }
-
-  if (sparsestNumChunks == 0) {
-    // One item doesn't appear anywhere! The union of all items can't
-    // be more frequent!
+  if (tidLists.empty()) {
     return 0;
   }
-
-  // Logical AND together the chunks from the sparsest item with the other
-  // item's corresponding chunks.
-  int count = 0;
-  unsigned* chunks = mIndex[sparsest.GetIndex()];
-  if (!chunks) {
-    return 0;
+  sort(tidLists.begin(), tidLists.end(),
+       [](const HybridTidList* a, const HybridTidList* b) {
+         return a->Count() < b->Count();
+       });
+  if (tidLists.size() == 1) {
+    return tidLists[0]->Count();
   }
-  const set<unsigned>& sparsestChunks = mActiveChunks[sparsest.GetIndex()];
-  set<unsigned>::const_iterator chunkItr = sparsestChunks.begin();
-  set<unsigned>::const_iterator chunkEnd = sparsestChunks.end();
-  while (chunkItr != chunkEnd) {
-    unsigned chunkIndex = (*chunkItr);
-    unsigned chunk = chunks[chunkIndex];
-    ASSERT(chunk); // Should only store for active chunks!
-    // Logical and together with all other items corresponding chunk.
-    set<Item>::const_iterator itr = aItemSet.mItems.begin();
-    set<Item>::const_iterator end = aItemSet.mItems.end();
-    // Logical AND together each item in the set's chunks.
-    while (itr != end && chunk) {
-      Item item = (*itr);
-      itr++;
-      if (item == sparsest || !mIndex[item.GetIndex()]) {
-        continue;
-      }
-      chunk &= mIndex[item.GetIndex()][chunkIndex];
-    }
-    count += PopulationCount(chunk);
-    chunkItr++;
+  if (tidLists.size() == 2) {
+    return HybridTidList::IntersectionCount(*tidLists[0], *tidLists[1]);
+  }
+  HybridTidList intersection;
+  HybridTidList scratch;
+  HybridTidList::Intersect(*tidLists[0], *tidLists[1], intersection);
+  for (size_t i = 2; i + 1 < tidLists.size() && !intersection.IsEmpty(); i++) {
+    HybridTidList::Intersect(intersection, *tidLists[i], scratch);
+    swap(intersection, scratch);
   }
-  return count;
+  return HybridTidList::IntersectionCount(intersection, *tidLists.back());
 }
 
 int WindowIndex::Count(const Item& aItem) const {
@@ -19,6 +19,7 @@
 #include <queue>
 #include <set>
 
+#include "HybridTidList.h"
 #include "Item.h"
 #include "InvertedDataSetIndex.h"
 #include "ItemMap.h"
@@ -40,19 +41,17 @@ public:
 
   bool Load() override;
 
-  int Count(const ItemSet& aItemSet) const override;
+  using DataSet::Count;
   int Count(const Item& aItem) const override;
   unsigned NumTransactions() const override;
 
   bool IsLoaded() const override;
 
-private:
+protected:
 
-  // Records whether aItem's chunk with index aChunkIndex is used or
-  // not. We use this information to optimize the Count() function.
-  void MarkChunkUsage(Item aItem, unsigned aChunkIndex, bool aUsed);
+  int CountItemSet(const ItemSet& aItemSet) const override;
 
-  unsigned GetNumActiveChunks(Item aItem) const;
+private:
 
   void Set(unsigned aTid, Item aItem, bool aValue);
   bool Get(unsigned aTid, Item aItem) const;
@@ -61,17 +60,14 @@ private:
 
   std::set<Item> mItems;
 
-  // Maps item index to the set of the indexes of chunks which contain
-  // non-zero tids. This is used to reduce the number of chunks which
-  // need to be iterated over in Count().
-  std::vector<std::set<unsigned>> mActiveChunks;
-
   // Transactions in the window.
   std::queue<std::vector<Item>> mWindow;
 
-  // Inverted index. First dimension is itemId, second dimension is transaction id.
-  // i.e. (mIndex[item][tid/sizeof(unsigned)] & (tid % sizeof(unsigned)))
-  std::vector<unsigned*> mIndex;
+  // Inverted index, indexed by item index. Each item's tid list stores the
+  // window positions (tid % mMaxLength) of the transactions containing it,
+  // so rare items cost memory in proportion to their occurrences in the
+  // window, rather than one bit for every transaction in the window.
+  std::vector<HybridTidList> mIndex;
 
   // Maximum length of the window, i.e. the max number transactions in the window.
   // Size of mIndex's second dimension.
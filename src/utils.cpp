@@ -25,6 +25,13 @@
 #include "PatternStream.h"
 #include "ItemMap.h"
 #include <memory>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
 
 using namespace std;
 
@@ -107,16 +114,20 @@ void CloseLog() {
 void Log(const char* msg, ...) {
   va_list argp;
   va_start(argp, msg);
+  // vfprintf() consumes its va_list, so the log file needs its own copy.
+  va_list logArgp;
+  va_copy(logArgp, argp);
   vfprintf(stdout, msg, argp);
   if (gOutputLog) {
-    vfprintf(gOutputLog, msg, argp);
+    vfprintf(gOutputLog, msg, logArgp);
   }
+  va_end(logArgp);
   va_end(argp);
 }
 
 
-bool DumpItemSets(vector<ItemSet>& aResult,
-                  DataSet* aIndex,
+bool DumpItemSets(const ItemSetTrie& aItemSets,
+                  unsigned aNumTransactions,
                   Options& options) {
   if (options.countItemSetsOnly) {
     return true;
@@ -129,9 +140,9 @@ bool DumpItemSets(vector<ItemSet>& aResult,
     cerr << "Fail: Can't open '" << filename << "' for writing\n";
     return false;
   }
-  for (unsigned i = 0; i < aResult.size(); i++) {
-    string s = aResult[i];
-    double sup = aIndex->Support(aResult[i]);
+  for (size_t i = 0; i < aItemSets.Size(); i++) {
+    string s = aItemSets.Get(i);
+    double sup = (double)aItemSets.GetCount(i) / (double)aNumTransactions;
     if (sup < options.minSup) {
       cerr << "WARNING: itemset " << s << " has support of "
            << sup << ", but minsup=" << options.minSup << endl;
@@ -151,12 +162,18 @@ double Lift(Rule& r, DataSet* aIndex) {
   return Confidence(r, aIndex) / (double)aIndex->Support(r.mConsequent);
 }
 
+// Generates the rules from the candidate itemset AB, which is in aCountAB
+// transactions out of aNumTransactions. aCount(itemset) returns the number
+// of transactions containing itemset.
+template<class CountFunction>
 void GenerateRulesRecursize(long& aNumRules,
                             double minConf,
                             double minLift,
-                            DataSet* aIndex,
-                            set<Item>::iterator itr,
-                            set<Item>::iterator end,
+                            const CountFunction& aCount,
+                            int aCountAB,
+                            unsigned aNumTransactions,
+                            ItemSet::const_iterator itr,
+                            ItemSet::const_iterator end,
                             ItemSet& aAntecedent,
                             ItemSet& aConsequent,
                             bool aCountRulesOnly,
@@ -172,10 +189,10 @@ void GenerateRulesRecursize(long& aNumRules,
     double lift = 0;
 
     {
-      ItemSet AB(aAntecedent, aConsequent);
-      support = aIndex->Support(AB);
-      confidence = support / (double)aIndex->Support(aAntecedent);
-      lift = confidence / (double)aIndex->Support(aConsequent);
+      const double numTransactions = (double)aNumTransactions;
+      support = (double)aCountAB / numTransactions;
+      confidence = support / ((double)aCount(aAntecedent) / numTransactions);
+      lift = confidence / ((double)aCount(aConsequent) / numTransactions);
     }
 
     if (confidence > minConf &&
@@ -186,7 +203,7 @@ void GenerateRulesRecursize(long& aNumRules,
       r.mConsequent = aConsequent;
       string s = r;
       if (!aCountRulesOnly) {
-        out << s << "," << confidence << "," << lift << "," << support* aIndex->NumTransactions() << endl;
+        out << s << "," << confidence << "," << lift << "," << support* aNumTransactions << '\n';
       }
     }
     return;
@@ -196,62 +213,177 @@ void GenerateRulesRecursize(long& aNumRules,
   itr++;
 
   aAntecedent.mItems.insert(item);
-  GenerateRulesRecursize(aNumRules, minConf, minLift, aIndex, itr, end, aAntecedent, aConsequent, aCountRulesOnly, out);
+  GenerateRulesRecursize(aNumRules, minConf, minLift, aCount, aCountAB, aNumTransactions, itr, end, aAntecedent, aConsequent, aCountRulesOnly, out);
   aAntecedent.mItems.erase(item);
 
   aConsequent.mItems.insert(item);
-  GenerateRulesRecursize(aNumRules, minConf, minLift, aIndex, itr, end, aAntecedent, aConsequent, aCountRulesOnly, out);
+  GenerateRulesRecursize(aNumRules, minConf, minLift, aCount, aCountAB, aNumTransactions, itr, end, aAntecedent, aConsequent, aCountRulesOnly, out);
   aConsequent.mItems.erase(item);
 }
 
-void GenerateRules(PatternInputStream& input,
-                   double minConf,
-                   double minLift,
-                   long& aNumRules,
-                   DataSet* aIndex,
-                   string aOutputPrefix,
-                   bool countRulesOnly) {
-  time_t startTime = time(0);
+static void LogCountCacheStats(const DataSet* aIndex) {
+  const CountCache* cache = aIndex->GetCountCache();
+  if (!cache) {
+    return;
+  }
+  const uint64_t hits = cache->Hits();
+  const uint64_t misses = cache->Misses();
+  Log("Count cache: %llu hits, %llu misses (%.1lf%% hit rate)\n",
+      (unsigned long long)hits, (unsigned long long)misses,
+      (hits + misses) ? 100.0 * hits / (hits + misses) : 0.0);
+}
 
-  aNumRules = 0;
+// Candidate itemsets are shared out to the rule generation workers in
+// batches of this many, so that each worker formats a large block of rules
+// at a time.
+static const size_t kRuleBatchSize = 256;
+
+// Candidate itemsets, with their counts, or -1 if not yet counted.
+typedef vector<pair<ItemSet, int>> CandidateBatch;
+
+// Generates the rules for the candidates returned by aNextBatch on
+// aNumThreads worker threads. aNextBatch(batch) appends the next batch of
+// candidates to batch, returning false when there are none left; it's only
+// called by one worker at a time. Each worker formats its batch's rules into
+// its own buffer, and the calling thread writes the buffers to out in the
+// order the batches were read, so the output is the same as that of one
+// thread. Returns the number of rules generated.
+template<class BatchFunction, class CountFunction>
+static long GenerateRulesInParallel(const BatchFunction& aNextBatch,
+                                    const CountFunction& aCount,
+                                    unsigned aNumTransactions,
+                                    double minConf,
+                                    double minLift,
+                                    bool aCountRulesOnly,
+                                    unsigned aNumThreads,
+                                    ostream& out) {
+  const unsigned numThreads = max(aNumThreads, 1u);
+  // Bounds how far the workers can get ahead of the writer, and so the
+  // amount of formatted rules buffered.
+  const size_t maxPendingBatches = 4 * numThreads;
+
+  mutex lock;
+  condition_variable condition;
+  size_t numBatches = 0;
+  size_t nextBatchToWrite = 0;
+  bool inputFinished = false;
+  unsigned numRunning = numThreads;
+  map<size_t, string> finished;
+  atomic<long> numRules(0);
+
+  auto worker = [&]() {
+    CandidateBatch batch;
+    ostringstream rules;
+    long workerNumRules = 0;
+    while (true) {
+      size_t batchNumber;
+      {
+        unique_lock<mutex> guard(lock);
+        condition.wait(guard, [&]() {
+          return numBatches < nextBatchToWrite + maxPendingBatches;
+        });
+        batch.clear();
+        if (inputFinished || !aNextBatch(batch)) {
+          inputFinished = true;
+          break;
+        }
+        batchNumber = numBatches++;
+      }
+      rules.str(string());
+      for (const auto& candidate : batch) {
+        const ItemSet& itemset = candidate.first;
+        const int count = candidate.second >= 0 ? candidate.second : aCount(itemset);
+        ItemSet antecedent, consequent;
+        GenerateRulesRecursize(workerNumRules, minConf, minLift, aCount,
+                               count, aNumTransactions,
+                               itemset.mItems.begin(), itemset.mItems.end(),
+                               antecedent, consequent, aCountRulesOnly, rules);
+      }
+      {
+        lock_guard<mutex> guard(lock);
+        finished[batchNumber] = rules.str();
+      }
+      condition.notify_all();
+    }
+    numRules += workerNumRules;
+    {
+      lock_guard<mutex> guard(lock);
+      numRunning--;
+    }
+    condition.notify_all();
+  };
 
-  string filename = GetOutputRuleFileName(aOutputPrefix);
-  ofstream out(filename);
-  ASSERT(out.is_open());
+  vector<thread> workers;
+  for (unsigned i = 0; i < numThreads; i++) {
+    workers.push_back(thread(worker));
+  }
 
-  ItemSet candidate;
-  while (!(candidate = input.Read()).IsNull()) {
-    ItemSet antecedent, consequent;
-    GenerateRulesRecursize(aNumRules, minConf, minLift, aIndex,
-                           candidate.mItems.begin(), candidate.mItems.end(),
-                           antecedent, consequent, countRulesOnly, out);
+  while (true) {
+    string rules;
+    {
+      unique_lock<mutex> guard(lock);
+      condition.wait(guard, [&]() {
+        return finished.count(nextBatchToWrite) || numRunning == 0;
+      });
+      auto itr = finished.find(nextBatchToWrite);
+      if (itr == finished.end()) {
+        // The workers have finished, and every batch has been written.
+        break;
+      }
+      rules = move(itr->second);
+      finished.erase(itr);
+      nextBatchToWrite++;
+    }
+    condition.notify_all();
+    out.write(rules.data(), rules.size());
   }
 
-  time_t timeTaken = time(0) - startTime;
-  Log("Generated %d rules in %lld seconds%s\n", aNumRules, timeTaken,
-      (countRulesOnly ? " (not saved to disk)" : ""));
+  for (thread& t : workers) {
+    t.join();
+  }
+  return numRules;
 }
 
-
-void GenerateRules(const vector<ItemSet>& aItemsets,
+void GenerateRules(const ItemSetTrie& aItemSets,
+                   unsigned aNumTransactions,
+                   DataSet* aIndex,
                    double minConf,
                    double minLift,
                    long& aNumRules,
-                   DataSet* aIndex,
                    string aOutputPrefix,
-                   bool countRulesOnly) {
-  aNumRules = 0;
-
+                   bool countRulesOnly,
+                   unsigned numThreads) {
   string filename = GetOutputRuleFileName(aOutputPrefix);
   ofstream out(filename);
   ASSERT(out.is_open());
 
-  for (unsigned i = 0; i < aItemsets.size(); i++) {
-    ItemSet candidate = aItemsets[i];
-    ItemSet antecedent, consequent;
-    GenerateRulesRecursize(aNumRules, minConf, minLift, aIndex,
-                           candidate.mItems.begin(), candidate.mItems.end(),
-                           antecedent, consequent, countRulesOnly, out);
+  size_t next = 0;
+  auto nextBatch = [&aItemSets, &next](CandidateBatch& aBatch) {
+    for (; next < aItemSets.Size() && aBatch.size() < kRuleBatchSize; next++) {
+      aBatch.push_back(make_pair(aItemSets.Get(next), aItemSets.GetCount(next)));
+    }
+    return !aBatch.empty();
+  };
+  // The antecedents and consequents are subsets of mined itemsets, so are
+  // usually mined themselves. Those which aren't, because the miner pruned
+  // them, are counted in the index.
+  atomic<long> numFallbacks(0);
+  auto count = [&aItemSets, aIndex, &numFallbacks](const ItemSet& aItemSet) {
+    int count = aItemSets.Find(aItemSet);
+    if (count < 0) {
+      numFallbacks++;
+      count = aIndex ? aIndex->Count(aItemSet) : 0;
+    }
+    return count;
+  };
+  aNumRules = GenerateRulesInParallel(nextBatch, count, aNumTransactions,
+                                      minConf, minLift, countRulesOnly,
+                                      numThreads, out);
+  if (numFallbacks) {
+    Log("Counted %ld rule antecedents or consequents in the data set\n", (long)numFallbacks);
+  }
+  if (aIndex) {
+    LogCountCacheStats(aIndex);
   }
 }
 
@@ -22,6 +22,7 @@
 #include "Options.h"
 #include "ItemSet.h"
 #include "PatternStream.h"
+#include "ItemSetTrie.h"
 
 using namespace std::chrono;
 
@@ -149,22 +150,22 @@ public:
   }
 };
 
-bool DumpItemSets(std::vector<ItemSet>& aResult, DataSet* aIndex, Options& options);
+// Writes the itemsets, in the order they were added, with their supports.
+bool DumpItemSets(const ItemSetTrie& aItemSets, unsigned aNumTransactions, Options& options);
 
-void GenerateRules(const std::vector<ItemSet>& aItemsets,
-                   double minConf,
-                   double minLift,
-                   long& aNumRules,
+// Generates rules from the mined itemsets, looking up supports in
+// aItemSets. aIndex is only consulted for antecedents and consequents which
+// weren't mined, and may be null if the miner doesn't prune any. The
+// itemsets are shared out amongst numThreads threads, and the rules are
+// written in the same order as a single thread would.
+void GenerateRules(const ItemSetTrie& aItemSets,
+                   unsigned aNumTransactions,
                    DataSet* aIndex,
-                   std::string aOutputPrefix,
-                   bool countRulesOnly);
-
-void GenerateRules(PatternInputStream& input,
                    double minConf,
                    double minLift,
                    long& aNumRules,
-                   DataSet* aIndex,
                    std::string aOutputPrefix,
-                   bool countRulesOnly);
+                   bool countRulesOnly,
+                   unsigned numThreads);
 
 #endif
@@ -1,7 +1,9 @@
 #include "gtest/gtest.h"
 #include "AprioriFilter.h"
+#include "CandidateTrie.h"
 #include "TestDataSets.h"
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 
@@ -140,6 +142,77 @@ TEST(Apriori_Test, main) {
   }
 }
 
+TEST(Apriori_Test, HorizontalCounting) {
+  Item::ResetBaseId();
+  InvertedDataSetIndex index(Test3DataSet());
+  ASSERT_TRUE(index.Load());
+
+  vector<int> ids;
+  for (const Item item : index.GetItems()) {
+    ids.push_back(item.GetId());
+  }
+  sort(ids.begin(), ids.end());
+  vector<uint32_t> offsets;
+  vector<int> items;
+  index.GetTransactions(ids, offsets, items);
+  ASSERT_EQ(offsets.size(), index.NumTransactions() + 1);
+
+  // Every candidate of sizes 2 and 3 from the first 10 items, in
+  // lexicographic order.
+  for (unsigned k = 2; k <= 3; k++) {
+    vector<int> candidates;
+    vector<int> row(k);
+    vector<bool> chosen(10, false);
+    fill(chosen.begin(), chosen.begin() + k, true);
+    do {
+      for (unsigned i = 0, j = 0; i < chosen.size(); i++) {
+        if (chosen[i]) {
+          row[j++] = ids[i];
+        }
+      }
+      candidates.insert(candidates.end(), row.begin(), row.end());
+    } while (prev_permutation(chosen.begin(), chosen.end()));
+    const size_t numCandidates = candidates.size() / k;
+
+    CandidateTrie trie(candidates.data(), numCandidates, k);
+    vector<int> counts(numCandidates, 0);
+    for (size_t t = 0; t + 1 < offsets.size(); t++) {
+      trie.Count(items.data() + offsets[t], offsets[t + 1] - offsets[t], counts.data());
+    }
+    for (size_t c = 0; c < numCandidates; c++) {
+      ItemSet itemset;
+      for (unsigned i = 0; i < k; i++) {
+        itemset.Add(Item(candidates[c * k + i]));
+      }
+      EXPECT_EQ(counts[c], index.Count(itemset));
+    }
+  }
+}
+
+extern vector<size_t> SplitJoinsIntoChunks(const vector<size_t>& aClassEnds,
+                                           unsigned aNumThreads);
+
+TEST(Apriori_Test, SplitJoinsIntoChunks) {
+  // Level 1; the 100 frequent items are all in the one prefix class, so the
+  // class must be split for level 2 to be generated on several threads.
+  vector<size_t> classEnds(100, 100);
+  for (unsigned numThreads = 1; numThreads <= 8; numThreads++) {
+    const vector<size_t> chunks = SplitJoinsIntoChunks(classEnds, numThreads);
+    ASSERT_GT(chunks.size() - 1, numThreads > 1 ? 1u : 0u);
+    EXPECT_EQ(chunks.front(), 0u);
+    EXPECT_EQ(chunks.back(), classEnds.size());
+    EXPECT_TRUE(is_sorted(chunks.begin(), chunks.end()));
+  }
+
+  // Classes {0,1,2}, {3}, {4,5}; the single row class has no joins.
+  classEnds = {3, 3, 3, 4, 6, 6};
+  vector<size_t> chunks = SplitJoinsIntoChunks(classEnds, 4);
+  EXPECT_EQ(chunks, vector<size_t>({0, 1, 4, 6}));
+
+  classEnds = {1, 2, 3};
+  EXPECT_TRUE(SplitJoinsIntoChunks(classEnds, 4).empty());
+}
+
 extern int MinAbsSup(int A, int B, int N, double E);
 
 TEST(MinAbsSupFilter, main) {
@@ -151,4 +224,10 @@ TEST(MinAbsSupFilter, main) {
   EXPECT_EQ(MinAbsSup(500, 1000, 10000, 0.999), 71);
   EXPECT_EQ(MinAbsSup(50, 1000, 10000, 0.999), 12);
   EXPECT_EQ(MinAbsSup(50, 5000, 10000, 0.999), 36);
+
+  // A table larger than N can be shared between calls.
+  const LogFactorialTable table(10000);
+  EXPECT_EQ(MinAbsSup(250, 500, 1000, 0.999, table), 146);
+  EXPECT_EQ(MinAbsSup(500, 250, 1000, 0.999, table), 146);
+  EXPECT_EQ(MinAbsSup(50, 1000, 10000, 0.999, table), 12);
 }
@@ -0,0 +1,169 @@
+#include "gtest/gtest.h"
+#include "DataSetReader.h"
+#include "BinaryDataSet.h"
+#include "PipelinedDataSetReader.h"
+#include "TestDataSets.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static vector<string> ReadAll(DataSetReader& reader) {
+  vector<string> transactions;
+  vector<Item> transaction;
+  while (reader.GetNext(transaction)) {
+    string s;
+    for (Item item : transaction) {
+      s += (s.empty() ? "" : "|") + (string)item;
+    }
+    transactions.push_back(s);
+  }
+  return transactions;
+}
+
+static string WriteTempFile(const string& name, const string& data) {
+  ofstream out(name, ios::binary);
+  out << data;
+  return name;
+}
+
+TEST(DataSetReader, MappedFileMatchesStream) {
+  // Dirty data; leading, trailing and repeated delimiters, whitespace
+  // padding, Windows line endings, duplicate items, and no newline at the
+  // end of the file.
+  const string data =
+    "aa, bb, cc , dd\n"
+    "aa, gg,\n"
+    ",,aa,,bb\r\n"
+    "\tee\t,aa ,ee, aa\r\n"
+    "a-long-item-name-which-wont-fit-in-small-string-storage, bb\n"
+    "bb";
+  const vector<string> expected = {
+    "aa|bb|cc|dd",
+    "aa|gg",
+    "aa|bb",
+    "ee|aa",
+    "a-long-item-name-which-wont-fit-in-small-string-storage|bb",
+    "bb",
+  };
+
+  DataSetReader stream(make_unique<istringstream>(data));
+  EXPECT_EQ(ReadAll(stream), expected);
+
+  DataSetReader mapped(WriteTempFile("Test_DataSetReader.csv", data));
+  EXPECT_TRUE(mapped.IsGood());
+  EXPECT_EQ(ReadAll(mapped), expected);
+
+  // Rewinding must restart from the beginning, and duplicate removal must
+  // still work for transactions we've already read once.
+  EXPECT_TRUE(mapped.Rewind());
+  EXPECT_EQ(ReadAll(mapped), expected);
+}
+
+TEST(DataSetReader, MappedFileEdgeCases) {
+  DataSetReader missing(string("NotAValidFilePath"));
+  EXPECT_FALSE(missing.IsGood());
+
+  DataSetReader empty(WriteTempFile("Test_DataSetReader-empty.csv", ""));
+  EXPECT_TRUE(empty.IsGood());
+  vector<Item> transaction;
+  EXPECT_FALSE(empty.GetNext(transaction));
+
+  DataSetReader single(WriteTempFile("Test_DataSetReader-single.csv", "x,y\n"));
+  EXPECT_EQ(ReadAll(single), vector<string>({"x|y"}));
+}
+
+static vector<int> ReadIds(DataSetReader& reader) {
+  vector<int> ids;
+  vector<Item> transaction;
+  while (reader.GetNext(transaction)) {
+    for (Item item : transaction) {
+      ids.push_back(item.GetId());
+    }
+    ids.push_back(0);
+  }
+  return ids;
+}
+
+TEST(DataSetReader, BinaryRoundTrip) {
+  const string data =
+    "dd,aa,cc\n"
+    "aa, bb,aa\n"
+    "cc\n"
+    "bb,dd,cc,aa\n";
+  const string csvFileName = WriteTempFile("Test_DataSetReader-binary.csv", data);
+
+  Item::ResetBaseId();
+  DataSetReader csv(csvFileName);
+  const vector<string> expected = ReadAll(csv);
+  Item::ResetBaseId();
+  EXPECT_TRUE(csv.Rewind());
+  const vector<int> expectedIds = ReadIds(csv);
+
+  const string binaryFileName = "Test_DataSetReader-binary.harmbin";
+  EXPECT_TRUE(WriteBinaryDataSet(csv, binaryFileName));
+  EXPECT_TRUE(BinaryDataSetReader::IsBinaryDataSet(binaryFileName));
+  EXPECT_FALSE(BinaryDataSetReader::IsBinaryDataSet(csvFileName));
+
+  // Items must be assigned the same ids as they are when reading the CSV.
+  Item::ResetBaseId();
+  unique_ptr<DataSetReader> binary = OpenDataSetReader(binaryFileName);
+  EXPECT_TRUE(binary->IsGood());
+  EXPECT_EQ(ReadIds(*binary), expectedIds);
+  EXPECT_TRUE(binary->Rewind());
+  EXPECT_EQ(ReadAll(*binary), expected);
+
+  ItemMap<unsigned> frequencies;
+  EXPECT_TRUE(binary->GetItemFrequencies(frequencies));
+  EXPECT_EQ(frequencies.Get(Item("aa")), 3u);
+  EXPECT_EQ(frequencies.Get(Item("bb")), 2u);
+  EXPECT_EQ(frequencies.Get(Item("cc")), 3u);
+  EXPECT_EQ(frequencies.Get(Item("dd")), 2u);
+  EXPECT_FALSE(csv.GetItemFrequencies(frequencies));
+
+  // An empty data set round trips to an empty binary data set.
+  DataSetReader empty(WriteTempFile("Test_DataSetReader-binary-empty.csv", ""));
+  EXPECT_TRUE(WriteBinaryDataSet(empty, "Test_DataSetReader-binary-empty.harmbin"));
+  unique_ptr<DataSetReader> emptyBinary =
+    OpenDataSetReader("Test_DataSetReader-binary-empty.harmbin");
+  EXPECT_TRUE(emptyBinary->IsGood());
+  vector<Item> transaction;
+  EXPECT_FALSE(emptyBinary->GetNext(transaction));
+}
+
+TEST(DataSetReader, Pipelined) {
+  Item::ResetBaseId();
+  unique_ptr<DataSetReader> direct = UCIZooDataSetReader();
+  const vector<string> expected = ReadAll(*direct);
+  Item::ResetBaseId();
+  EXPECT_TRUE(direct->Rewind());
+  const vector<int> expectedIds = ReadIds(*direct);
+
+  // A small batch size and ring, so that the parser thread frequently
+  // blocks waiting for us to catch up.
+  Item::ResetBaseId();
+  PipelinedDataSetReader pipelined(UCIZooDataSetReader(), 3, 2);
+  EXPECT_TRUE(pipelined.IsGood());
+  EXPECT_EQ(ReadIds(pipelined), expectedIds);
+  vector<Item> transaction;
+  EXPECT_FALSE(pipelined.GetNext(transaction));
+
+  EXPECT_TRUE(pipelined.Rewind());
+  EXPECT_EQ(ReadAll(pipelined), expected);
+
+  // Rewinding part way through stops the parser thread and restarts it
+  // from the beginning.
+  EXPECT_TRUE(pipelined.Rewind());
+  for (int i = 0; i < 10; i++) {
+    EXPECT_TRUE(pipelined.GetNext(transaction));
+  }
+  EXPECT_TRUE(pipelined.Rewind());
+  EXPECT_EQ(ReadAll(pipelined), expected);
+
+  // Destroying the reader part way through must not hang.
+  PipelinedDataSetReader abandoned(UCIZooDataSetReader(), 1, 1);
+  EXPECT_TRUE(abandoned.GetNext(transaction));
+}
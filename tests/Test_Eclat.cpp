@@ -0,0 +1,56 @@
+#include "gtest/gtest.h"
+#include "InvertedDataSetIndex.h"
+#include "ItemSetTrie.h"
+#include "PatternStream.h"
+#include "TestDataSets.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+extern void MineEclat(const InvertedDataSetIndex& aIndex,
+                      double aMinCount,
+                      PatternOutputStream& aOutput,
+                      unsigned numThreads);
+
+TEST(Eclat, main) {
+  UCIZooFixture zoo(kFPTree);
+  InvertedDataSetIndex& index = zoo.index;
+
+  // Low enough that some classes switch to diffsets.
+  for (const double minSup : {0.4, 0.2}) {
+    const double minCount = minSup * index.NumTransactions();
+    const vector<pair<ItemSet, int>> frequent = zoo.FrequentItemSets(minCount);
+
+    string firstOutput;
+    for (unsigned numThreads : {1, 4}) {
+      shared_ptr<ostringstream> stream(make_shared<ostringstream>());
+      PatternOutputStream output(stream, &index);
+      shared_ptr<ItemSetTrie> patterns(make_shared<ItemSetTrie>());
+      output.RecordPatterns(patterns);
+      output.UseMinedCounts();
+      MineEclat(index, minCount, output, numThreads);
+      output.Close();
+
+      // Same itemsets and counts as FP-Growth, though mined in a different
+      // order, and the mined counts are the true counts.
+      ASSERT_EQ(patterns->Size(), frequent.size());
+      ASSERT_EQ(patterns->Size(), (size_t)output.GetNumPatterns());
+      for (const pair<ItemSet, int>& x : frequent) {
+        EXPECT_EQ(patterns->Find(x.first), x.second);
+      }
+      for (size_t i = 0; i < patterns->Size(); i++) {
+        ASSERT_EQ(patterns->GetCount(i), index.Count(patterns->Get(i)));
+      }
+
+      // The output doesn't depend on the number of threads.
+      if (firstOutput.empty()) {
+        firstOutput = stream->str();
+      } else {
+        EXPECT_EQ(stream->str(), firstOutput);
+      }
+    }
+  }
+}
@@ -1,8 +1,11 @@
 #include "gtest/gtest.h"
 #include "FPTree.h"
 #include "FPNode.h"
+#include "FrozenFPTree.h"
+#include "ItemSetTrie.h"
 #include "TestDataSets.h"
 
+#include <algorithm>
 #include <string>
 #include <iostream>
 
@@ -13,22 +16,46 @@ extern FPTree* CreateFPTree(DataSet* aDataSet, Options& options);
 extern void FPGrowth(FPTree* tree,
                      PatternOutputStream& output,
                      vector<Item>& pattern,
-                     DataSet* index,
                      const double minCount,
                      unsigned nodePruneDepth = std::numeric_limits<unsigned>::max(),
                      ItemFilter* = nullptr);
 
+extern void ParallelFPGrowth(FPTree* tree,
+                             PatternOutputStream& output,
+                             const double minCount,
+                             unsigned nodePruneDepth,
+                             ItemFilter* filter,
+                             unsigned numThreads);
+
+extern void MineClosedItemSets(FPTree* aTree,
+                               double aMinCount,
+                               bool aMaximal,
+                               PatternOutputStream& aOutput);
+
+extern double MineTopKItemSets(FPTree* aTree,
+                               unsigned aK,
+                               double aMinCount,
+                               PatternOutputStream& aOutput);
+
 extern void AddPatternsInPath(const FPNode* tree,
                               PatternOutputStream& output,
                               vector<Item>& pattern,
                               unsigned maxNodeDepth = UINT32_MAX,
-                              ItemFilter* filter = nullptr);
+                              ItemFilter* filter = nullptr,
+                              double minCount = 0);
 
 extern void ConstructConditionalTree(const FPNode* node,
                               FPTree* tree,
                               double minCount,
                               unsigned nodePruneDepth = std::numeric_limits<unsigned>::max());
 
+extern void ConstructConditionalTree(const FrozenFPTree& frozen,
+                                     unsigned headerIndex,
+                                     FPTree* tree,
+                                     double minCount,
+                                     unsigned nodePruneDepth,
+                                     FPGrowthScratch& scratch);
+
 static string GetPath(FPNode* n) {
   string path;
   while (!n->IsRoot()) {
@@ -68,7 +95,7 @@ TEST(FPTree, TestInitialConstruction) {
   shared_ptr<std::ostringstream> stream(make_shared<std::ostringstream>());
   PatternOutputStream output(stream, 0);
   vector<Item> pattern;
-  FPGrowth(fptree, output, pattern, &index, 0);
+  FPGrowth(fptree, output, pattern, 0);
   output.Close();
 
   ItemSet expected[] = {
@@ -118,6 +145,149 @@ TEST(FPTree, TestInitialConstruction) {
   delete fptree;
 }
 
+TEST(FPTree, ParallelFPGrowth) {
+  Item::SetCompareMode(Item::ALPHABETIC_COMPARE);
+  InvertedDataSetIndex index(UCIZooDataSetReader());
+  Options options(0, kFPTree, 0, 0, 0, 0, 0, 0, 0);
+  FPTree* fptree = CreateFPTree(&index, options);
+  index.Load();
+  const double minCount = 0.4 * index.NumTransactions();
+
+  shared_ptr<std::ostringstream> expected(make_shared<std::ostringstream>());
+  PatternOutputStream sequential(expected, &index);
+  vector<Item> pattern;
+  FPGrowth(fptree, sequential, pattern, minCount);
+  sequential.Close();
+  EXPECT_GT(sequential.GetNumPatterns(), 0);
+
+  // The parallel output must match the sequential output exactly, including
+  // the order in which the patterns were written.
+  for (unsigned numThreads : {1, 2, 4}) {
+    shared_ptr<std::ostringstream> stream(make_shared<std::ostringstream>());
+    PatternOutputStream output(stream, &index);
+    ParallelFPGrowth(fptree, output, minCount, UINT32_MAX, nullptr, numThreads);
+    output.Close();
+    EXPECT_EQ(output.GetNumPatterns(), sequential.GetNumPatterns());
+    EXPECT_EQ(stream->str(), expected->str());
+
+    PatternOutputStream counter;
+    ParallelFPGrowth(fptree, counter, minCount, UINT32_MAX, nullptr, numThreads);
+    EXPECT_EQ(counter.GetNumPatterns(), sequential.GetNumPatterns());
+  }
+
+  delete fptree;
+}
+
+TEST(FPTree, FPArray) {
+  Item::SetCompareMode(Item::ALPHABETIC_COMPARE);
+  {
+    FPTree tree;
+    tree.EnableFPArray({Item("a"), Item("b"), Item("c")});
+    tree.Insert({Item("a"), Item("b"), Item("c")}, 2);
+    tree.Insert({Item("a"), Item("c")}, 1);
+    tree.Insert({Item("b")}, 5);
+    EXPECT_EQ(tree.FPArrayItems().size(), 3u);
+    // Row c: a is above c in 3 transactions, b in 2, and c never is.
+    const unsigned* row = tree.FPArrayRow(Item("c"));
+    EXPECT_EQ(row[0], 3u);
+    EXPECT_EQ(row[1], 2u);
+    EXPECT_EQ(row[2], 0u);
+    row = tree.FPArrayRow(Item("a"));
+    EXPECT_EQ(row[0] + row[1] + row[2], 0u);
+    tree.Clear();
+    EXPECT_FALSE(tree.HasFPArray());
+  }
+
+  // Conditional trees built from FP-arrays must be the same as those built
+  // by counting. A finite prune depth too deep to prune anything turns the
+  // FP-arrays off.
+  InvertedDataSetIndex index(UCIZooDataSetReader());
+  Options options(0, kFPTree, 0, 0, 0, 0, 0, 0, 0);
+  FPTree* fptree = CreateFPTree(&index, options);
+  index.Load();
+  const double minCount = 0.3 * index.NumTransactions();
+
+  shared_ptr<std::ostringstream> expected(make_shared<std::ostringstream>());
+  PatternOutputStream counted(expected, &index);
+  vector<Item> pattern;
+  FPGrowth(fptree, counted, pattern, minCount, 1000);
+  counted.Close();
+
+  shared_ptr<std::ostringstream> stream(make_shared<std::ostringstream>());
+  PatternOutputStream output(stream, &index);
+  FPGrowth(fptree, output, pattern, minCount);
+  output.Close();
+  EXPECT_GT(output.GetNumPatterns(), 0);
+  EXPECT_EQ(stream->str(), expected->str());
+
+  delete fptree;
+}
+
+TEST(FPTree, ClosedAndMaximal) {
+  UCIZooFixture zoo(kFPClose);
+  const double minCount = 0.3 * zoo.index.NumTransactions();
+  const vector<pair<ItemSet, int>> frequent = zoo.FrequentItemSets(minCount);
+
+  for (const bool maximal : {false, true}) {
+    PatternOutputStream output(make_shared<ostringstream>(), &zoo.index);
+    shared_ptr<ItemSetTrie> mined(make_shared<ItemSetTrie>());
+    output.RecordPatterns(mined);
+    output.UseMinedCounts();
+    MineClosedItemSets(zoo.tree, minCount, maximal, output);
+    output.Close();
+
+    // An itemset is closed if no superset has the same count, and maximal
+    // if no superset is frequent.
+    size_t expected = 0;
+    for (const pair<ItemSet, int>& x : frequent) {
+      bool subsumed = false;
+      for (size_t j = 0; j < frequent.size() && !subsumed; j++) {
+        const ItemSet& y = frequent[j].first;
+        subsumed = y.Size() > x.first.Size() &&
+                   includes(y.mItems.begin(), y.mItems.end(),
+                            x.first.mItems.begin(), x.first.mItems.end()) &&
+                   (maximal || frequent[j].second == x.second);
+      }
+      EXPECT_EQ(mined->Find(x.first), subsumed ? -1 : x.second);
+      expected += subsumed ? 0 : 1;
+    }
+    EXPECT_GT(expected, 0u);
+    EXPECT_EQ(mined->Size(), expected);
+  }
+}
+
+TEST(FPTree, TopK) {
+  UCIZooFixture zoo(kTopK);
+  const double minCount = 0.3 * zoo.index.NumTransactions();
+  const vector<pair<ItemSet, int>> frequent = zoo.FrequentItemSets(minCount);
+
+  // The counts of every frequent itemset, most frequent first.
+  vector<int> counts;
+  ItemSetTrie frequentTrie;
+  for (const pair<ItemSet, int>& x : frequent) {
+    counts.push_back(x.second);
+    frequentTrie.Insert(x.first, x.second);
+  }
+  sort(counts.rbegin(), counts.rend());
+
+  for (const unsigned k : {1u, 10u, 100u, (unsigned)counts.size() + 10}) {
+    PatternOutputStream output(make_shared<ostringstream>(), &zoo.index);
+    shared_ptr<ItemSetTrie> mined(make_shared<ItemSetTrie>());
+    output.RecordPatterns(mined);
+    output.UseMinedCounts();
+    MineTopKItemSets(zoo.tree, k, minCount, output);
+    output.Close();
+
+    // Which of the itemsets tied at the k-th count are mined is arbitrary,
+    // but the counts must be the k greatest, and each must be correct.
+    ASSERT_EQ(mined->Size(), min((size_t)k, counts.size()));
+    for (size_t i = 0; i < mined->Size(); i++) {
+      EXPECT_EQ(mined->GetCount(i), counts[i]);
+      EXPECT_EQ(frequentTrie.Find(mined->Get(i)), mined->GetCount(i));
+    }
+  }
+}
+
 TEST(FPTree, HasSinglePath) {
   Item::SetCompareMode(Item::ALPHABETIC_COMPARE);
   InvertedDataSetIndex index(SinglePathDataSetReader());
@@ -178,6 +348,34 @@ TEST(FPTree, AddPatternsInPath) {
 
 }
 
+TEST(FPTree, TreeLocalSupports) {
+  Item::SetCompareMode(Item::ALPHABETIC_COMPARE);
+  // Mining needs no data set; the header table can carry items below the
+  // minimum count, as in cantree mode, and they must be left out whether or
+  // not the tree is a single path.
+  for (bool singlePath : {false, true}) {
+    FPTree tree;
+    tree.Insert({Item("a"), Item("b")}, 2);
+    tree.Insert({Item("a"), Item("b"), Item("c")}, 1);
+    if (!singlePath) {
+      tree.Insert({Item("d")}, 1);
+    }
+    EXPECT_EQ(tree.HasSinglePath(), singlePath);
+    for (unsigned numThreads : {1, 2}) {
+      shared_ptr<std::ostringstream> stream(make_shared<std::ostringstream>());
+      PatternOutputStream output(stream, nullptr);
+      ParallelFPGrowth(&tree, output, 2, UINT32_MAX, nullptr, numThreads);
+      output.Close();
+      PatternInputStream input(make_shared<istringstream>(stream->str()));
+      vector<ItemSet> v = input.ToVector();
+      sort(v.begin(), v.end(), [](const ItemSet& x, const ItemSet& y) {
+        return string(x) < string(y);
+      });
+      EXPECT_EQ(Flatten(v), "(a,a b,b)");
+    }
+  }
+}
+
 void TestConstructConditionalTree_inner(DataSet* index,
                                         FPTree* condTree,
                                         const char* item,
@@ -202,6 +400,70 @@ void TestConstructConditionalTree_inner(DataSet* index,
     EXPECT_EQ(s, res_conf_count);
     delete tree;
   }
+
+  // Constructing from the frozen tree must give the same conditional trees.
+  FrozenFPTree frozen(*condTree);
+  unsigned headerIndex = 0;
+  while (headerIndex < frozen.NumHeaderItems() &&
+         !(frozen.HeaderItem(headerIndex) == Item(item))) {
+    headerIndex++;
+  }
+  ASSERT_LT(headerIndex, frozen.NumHeaderItems());
+  // Reusing the scratch tree must give the same result as a fresh tree.
+  FPGrowthScratch scratch;
+  for (unsigned i = 0; i < 2; i++) {
+    FPTree* tree = scratch.TreeAt(0);
+    ConstructConditionalTree(frozen, headerIndex, tree, 0, UINT32_MAX, scratch);
+    EXPECT_EQ(tree->ToString(), res_conf0);
+    tree = scratch.TreeAt(0);
+    ConstructConditionalTree(frozen, headerIndex, tree, min_count, UINT32_MAX, scratch);
+    EXPECT_EQ(tree->ToString(), res_conf_count);
+  }
+}
+
+TEST(FPTree, Frozen) {
+  Item::SetCompareMode(Item::ALPHABETIC_COMPARE);
+  InvertedDataSetIndex index(UCIZooDataSetReader());
+  Options options(0, kFPTree, 0, 0, 0, 0, 0, 0, 0);
+  FPTree* fptree = CreateFPTree(&index, options);
+  index.Load();
+
+  FrozenFPTree frozen(*fptree);
+  EXPECT_EQ(frozen.NumNodes(), fptree->NumNodes());
+  EXPECT_TRUE(frozen.GetItem(0).IsNull());
+  for (uint32_t n = 1; n < frozen.NumNodes(); n++) {
+    // Preorder numbering puts parents before their children.
+    EXPECT_LT(frozen.Parent(n), n);
+    EXPECT_EQ(frozen.Depth(n), frozen.Depth(frozen.Parent(n)) + 1);
+    if (frozen.Parent(n) != 0) {
+      EXPECT_GE(frozen.Count(frozen.Parent(n)), frozen.Count(n));
+    }
+  }
+
+  // Each chain has its header item's nodes in preorder, and their counts
+  // sum to the item's count in the tree.
+  unsigned numChained = 0;
+  for (unsigned i = 0; i < frozen.NumHeaderItems(); i++) {
+    const Item item = frozen.HeaderItem(i);
+    unsigned expected = 0;
+    for (FPNode* n = fptree->HeaderTable().Get(item); n; n = n->next) {
+      expected += n->count;
+    }
+    unsigned count = 0;
+    for (const uint32_t* n = frozen.ChainBegin(i); n != frozen.ChainEnd(i); n++) {
+      EXPECT_EQ(frozen.GetItem(*n), item);
+      if (n != frozen.ChainBegin(i)) {
+        EXPECT_LT(n[-1], n[0]);
+      }
+      count += frozen.Count(*n);
+      numChained++;
+    }
+    EXPECT_EQ(count, expected);
+    EXPECT_EQ(frozen.HeaderFrequency(i), fptree->FrequencyTable().Get(item, 0));
+  }
+  EXPECT_EQ(numChained + 1, frozen.NumNodes());
+
+  delete fptree;
 }
 
 TEST(FPTree, ConstructConditionalTree) {
@@ -256,7 +518,7 @@ static void TestFPGrowth() {
 
   PatternOutputStream output("datasets/test/fp-test-itemsets.csv", 0);
   vector<Item> vec;
-  FPGrowth(fptree, output, vec, &index, 2);
+  FPGrowth(fptree, output, vec, 2);
   output.Close();
 
   PatternInputStream input;
@@ -290,7 +552,7 @@ static void TestFPGrowth2() {
   PatternOutputStream output("datasets/test/fptree-fp-test-3-itemsets.csv", 0);
   double minCount = index.NumTransactions() * 0.2;
   vector<Item> vec;
-  FPGrowth(fptree, output, vec, &index, minCount);
+  FPGrowth(fptree, output, vec, minCount);
   output.Close();
 
   PatternInputStream input;
@@ -341,6 +603,48 @@ TEST(FPTree, Stream) {
   }
 }
 
+TEST(FPTree, HighFanOut) {
+  Item::SetCompareMode(Item::INSERTION_ORDER_COMPARE);
+  // Enough children under the root that they're moved out of the node's
+  // inline storage and into a hash table.
+  const unsigned numItems = 100;
+  Item common("fan-out-common");
+  vector<Item> items;
+  for (unsigned i = 0; i < numItems; i++) {
+    items.push_back(Item("fan-out-" + to_string(i)));
+  }
+
+  FPTree tree;
+  FPTree expected;
+  for (unsigned i = 0; i < numItems; i++) {
+    tree.Insert({items[i], common});
+    if (i % 2) {
+      expected.Insert({items[i], common});
+    }
+  }
+  EXPECT_EQ(tree.NumNodes(), 1 + 2 * numItems);
+  EXPECT_EQ(tree.GetRoot()->children.Size(), numItems);
+
+  // Removing every second path exercises deletion from the hash table.
+  for (unsigned i = 0; i < numItems; i += 2) {
+    tree.Remove({items[i], common});
+  }
+  EXPECT_EQ(tree.NumNodes(), 1 + numItems);
+  EXPECT_EQ(tree.GetRoot()->children.Size(), numItems / 2);
+  EXPECT_EQ(tree.ToString(), expected.ToString());
+  EXPECT_EQ(tree.FrequencyTable().Get(common), numItems / 2);
+  EXPECT_FALSE(tree.HeaderTable().Contains(items[0]));
+
+  unsigned chainLength = 0;
+  for (FPNode* n = tree.HeaderTable().Get(common); n; n = n->next) {
+    EXPECT_TRUE(n->IsLeaf());
+    EXPECT_EQ(tree.GetRoot()->children.Get(n->parent->item), n->parent);
+    chainLength++;
+  }
+  EXPECT_EQ(chainLength, numItems / 2);
+  EXPECT_EQ(tree.Leaves().GetSize(), numItems / 2);
+}
+
 TEST(FPTree, TreeSorted) {
   {
     InvertedDataSetIndex index(Census2DataSetReader());
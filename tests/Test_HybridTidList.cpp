@@ -0,0 +1,105 @@
+#include "gtest/gtest.h"
+#include "HybridTidList.h"
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace std;
+
+static vector<uint32_t> ToVector(const HybridTidList& aList) {
+  vector<uint32_t> tids;
+  aList.ForEach([&tids](uint32_t tid) {
+    tids.push_back(tid);
+  });
+  return tids;
+}
+
+// Builds a list spanning three chunks, where each chunk has the given
+// density, or is a few long runs if aDensity is 0.
+static void Fill(HybridTidList& aList, set<uint32_t>& aExpected,
+                 double aDensity, mt19937& aRng) {
+  uniform_real_distribution<double> coin(0.0, 1.0);
+  for (uint32_t tid = 0; tid < 3 * 65536; tid++) {
+    const bool add = aDensity > 0 ? coin(aRng) < aDensity
+                                  : (tid / 1000) % 3 == 0;
+    if (add) {
+      aList.Add(tid);
+      aExpected.insert(tid);
+    }
+  }
+}
+
+TEST(HybridTidList, AddRemoveContains) {
+  mt19937 rng(1);
+  uniform_int_distribution<uint32_t> pick(0, 200000);
+  HybridTidList list;
+  set<uint32_t> expected;
+  EXPECT_TRUE(list.IsEmpty());
+  // Enough adds to push some chunks past the array limit, then enough
+  // removes to take them back down again.
+  for (int i = 0; i < 60000; i++) {
+    const uint32_t tid = pick(rng);
+    list.Add(tid);
+    expected.insert(tid);
+  }
+  EXPECT_EQ(list.Count(), expected.size());
+  for (int i = 0; i < 200000; i++) {
+    const uint32_t tid = pick(rng);
+    list.Remove(tid);
+    expected.erase(tid);
+  }
+  EXPECT_EQ(list.Count(), expected.size());
+  for (uint32_t tid = 0; tid <= 200000; tid++) {
+    ASSERT_EQ(list.Contains(tid), expected.count(tid) == 1);
+  }
+  EXPECT_EQ(ToVector(list), vector<uint32_t>(expected.begin(), expected.end()));
+
+  // Runs are expanded again when modified.
+  list.Clear();
+  for (uint32_t tid = 100; tid < 70000; tid++) {
+    list.Add(tid);
+  }
+  list.Optimize();
+  EXPECT_LT(list.MemoryUsage(), 1024u);
+  EXPECT_TRUE(list.Contains(100));
+  EXPECT_TRUE(list.Contains(69999));
+  EXPECT_FALSE(list.Contains(99));
+  EXPECT_FALSE(list.Contains(70000));
+  list.Remove(500);
+  list.Add(80000);
+  EXPECT_FALSE(list.Contains(500));
+  EXPECT_TRUE(list.Contains(80000));
+  EXPECT_EQ(list.Count(), 70000u - 100u);
+}
+
+TEST(HybridTidList, Intersection) {
+  // Sparse chunks are arrays, dense chunks are bitmaps, and the runs become
+  // run containers after Optimize(); intersect every combination.
+  const double densities[] = {0.001, 0.03, 0.5, 0.0};
+  mt19937 rng(2);
+  for (const double a : densities) {
+    for (const double b : densities) {
+      HybridTidList listA;
+      HybridTidList listB;
+      set<uint32_t> expectedA;
+      set<uint32_t> expectedB;
+      Fill(listA, expectedA, a, rng);
+      Fill(listB, expectedB, b, rng);
+      listA.Optimize();
+      listB.Optimize();
+      vector<uint32_t> expected;
+      set_intersection(expectedA.begin(), expectedA.end(),
+                       expectedB.begin(), expectedB.end(),
+                       back_inserter(expected));
+
+      EXPECT_EQ(HybridTidList::IntersectionCount(listA, listB), expected.size());
+      HybridTidList intersection;
+      HybridTidList::Intersect(listA, listB, intersection);
+      EXPECT_EQ(intersection.Count(), expected.size());
+      EXPECT_EQ(ToVector(intersection), expected);
+    }
+  }
+}
@@ -1,10 +1,15 @@
 #include "gtest/gtest.h"
+#include "BitmapKernels.h"
+#include "CountCache.h"
 #include "InvertedDataSetIndex.h"
 #include "TidList.h"
 #include "WindowIndex.h"
 #include "VariableWindowDataSet.h"
 #include "TestDataSets.h"
 
+#include <random>
+#include <sstream>
+
 using namespace std;
 
 TEST(InvertedDataSetIndex, main) {
@@ -115,6 +120,175 @@ TEST(InvertedDataSetIndex, main) {
   }
 }
 
+TEST(InvertedDataSetIndex, DenseAndSparseItems) {
+  // Items "d*" appear in about half the transactions, so are stored as
+  // bitmap rows; items "s*" are rare, so are stored as transaction lists.
+  mt19937 rng(1);
+  bernoulli_distribution dense(0.5);
+  bernoulli_distribution sparse(0.01);
+  vector<vector<string>> transactions;
+  string data;
+  while (transactions.size() < 3000) {
+    vector<string> transaction;
+    for (int i = 0; i < 6; i++) {
+      if (dense(rng)) {
+        transaction.push_back("d" + to_string(i));
+      }
+      if (sparse(rng)) {
+        transaction.push_back("s" + to_string(i));
+      }
+    }
+    if (transaction.empty()) {
+      continue;
+    }
+    for (size_t i = 0; i < transaction.size(); i++) {
+      data += (i ? "," : "") + transaction[i];
+    }
+    data += "\n";
+    transactions.push_back(transaction);
+  }
+
+  InvertedDataSetIndex index(make_unique<DataSetReader>(make_unique<istringstream>(data)));
+  ASSERT_TRUE(index.Load());
+
+  vector<string> names;
+  for (int i = 0; i < 6; i++) {
+    names.push_back("d" + to_string(i));
+    names.push_back("s" + to_string(i));
+  }
+  uniform_int_distribution<size_t> pick(0, names.size() - 1);
+  for (int n = 0; n < 500; n++) {
+    vector<string> itemset;
+    const size_t size = 1 + n % 4;
+    while (itemset.size() < size) {
+      const string& name = names[pick(rng)];
+      if (find(itemset.begin(), itemset.end(), name) == itemset.end()) {
+        itemset.push_back(name);
+      }
+    }
+    int expected = 0;
+    for (const vector<string>& transaction : transactions) {
+      bool containsAll = true;
+      for (const string& name : itemset) {
+        containsAll &= find(transaction.begin(), transaction.end(), name) != transaction.end();
+      }
+      expected += containsAll;
+    }
+    ItemSet items;
+    for (const string& name : itemset) {
+      items.Add(Item(name));
+    }
+    EXPECT_EQ(index.Count(items), expected);
+  }
+}
+
+TEST(InvertedDataSetIndex, CountCache) {
+  InvertedDataSetIndex index(UCIZooDataSetReader());
+  ASSERT_TRUE(index.Load());
+  vector<ItemSet> itemsets = {
+    ItemSet("hair=1", "eggs=0"),
+    ItemSet("eggs=0", "hair=1"),
+    ItemSet("milk=1", "backbone=1", "breathes=1"),
+    ItemSet("feathers=1", "milk=1"),
+  };
+  vector<int> expected;
+  for (const ItemSet& itemset : itemsets) {
+    expected.push_back(index.Count(itemset));
+  }
+
+  index.EnableCountCache(1 << 20);
+  const CountCache* cache = index.GetCountCache();
+  ASSERT_TRUE(cache != nullptr);
+  for (int round = 0; round < 2; round++) {
+    for (size_t i = 0; i < itemsets.size(); i++) {
+      EXPECT_EQ(index.Count(itemsets[i]), expected[i]);
+    }
+  }
+  // The same items in a different order share an entry. Single items
+  // aren't cached.
+  EXPECT_EQ(index.Count(ItemSet("hair=1")), index.Count(Item("hair=1")));
+  EXPECT_EQ(cache->Misses(), 3u);
+  EXPECT_EQ(cache->Hits(), 5u);
+
+  // Even a tiny cache gives the right counts.
+  index.EnableCountCache(64);
+  for (int round = 0; round < 2; round++) {
+    for (size_t i = 0; i < itemsets.size(); i++) {
+      EXPECT_EQ(index.Count(itemsets[i]), expected[i]);
+    }
+  }
+
+  // Windowed data sets drop cached counts when the window moves.
+  VariableWindowDataSet window;
+  window.EnableCountCache(1 << 20);
+  window.Append(Transaction(0, "a,b"));
+  window.Append(Transaction(1, "a,b,c"));
+  EXPECT_EQ(window.Count(ItemSet("a", "b")), 2);
+  EXPECT_EQ(window.Count(ItemSet("a", "b")), 2);
+  window.Pop();
+  EXPECT_EQ(window.Count(ItemSet("a", "b")), 1);
+  window.Append(Transaction(2, "a,b"));
+  EXPECT_EQ(window.Count(ItemSet("a", "b")), 2);
+  EXPECT_EQ(window.GetCountCache()->Hits(), 1u);
+}
+
+TEST(CountCache, MemoryUsage) {
+  // Fill the cache several times over; its tables must stay in budget.
+  for (const size_t maxBytes : {size_t(1) << 16, size_t(1) << 20, size_t(3) << 20}) {
+    CountCache cache(maxBytes);
+    for (int a = 1; a <= 400; a++) {
+      for (int b = a + 1; b <= 400; b += 3) {
+        ItemSet itemset;
+        itemset.Add(Item(a));
+        itemset.Add(Item(b));
+        itemset.Add(Item(b + 1000));
+        const CountCache::Key key(itemset);
+        cache.Insert(key, a + b);
+        int count = -1;
+        ASSERT_TRUE(cache.Lookup(key, count));
+        ASSERT_EQ(count, a + b);
+      }
+    }
+    EXPECT_LE(cache.MemoryUsage(), maxBytes);
+    EXPECT_GT(cache.MemoryUsage(), maxBytes / 4);
+  }
+}
+
+TEST(BitmapKernels, AllKernelsMatchScalar) {
+  const size_t numWords = BitmapRowWords(5000);
+  EXPECT_EQ(numWords % kBitmapBlockWords, 0u);
+  mt19937_64 rng(1);
+  vector<uint64_t*> rows;
+  for (int r = 0; r < 5; r++) {
+    uint64_t* row = AllocateBitmapWords(numWords);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(row) % kBitmapRowAlignment, 0u);
+    for (size_t w = 0; w < numWords; w++) {
+      // Bias towards set bits, so that the AND of several rows is non zero.
+      row[w] = rng() | rng();
+    }
+    rows.push_back(row);
+  }
+
+  const eBitmapKernel selected = GetBitmapKernel();
+  const eBitmapKernel kernels[] = {kBitmapPopcnt, kBitmapAVX2, kBitmapAVX512};
+  for (unsigned numRows = 1; numRows <= rows.size(); numRows++) {
+    ASSERT_TRUE(SetBitmapKernel(kBitmapScalar));
+    const uint64_t expected = AndPopCount(rows.data(), numRows, numWords);
+    EXPECT_GT(expected, 0u);
+    for (const eBitmapKernel kernel : kernels) {
+      if (SetBitmapKernel(kernel)) {
+        EXPECT_EQ(AndPopCount(rows.data(), numRows, numWords), expected)
+          << GetBitmapKernelName(kernel) << " with " << numRows << " rows";
+      }
+    }
+  }
+  SetBitmapKernel(selected);
+
+  for (uint64_t* row : rows) {
+    FreeBitmapWords(row);
+  }
+}
+
 TEST(TidList_Test, main) {
   TidList tl;
   tl.Set(123, true);
@@ -0,0 +1,104 @@
+#include "gtest/gtest.h"
+#include "ItemDictionary.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+TEST(ItemDictionary, InternAndLookup) {
+  ItemDictionary dictionary;
+  EXPECT_EQ(dictionary.Size(), 0u);
+  EXPECT_EQ(dictionary.Find("a", 1), 0);
+  EXPECT_FALSE(dictionary.Contains(1));
+
+  // Ids are assigned in order of first appearance, starting at 1.
+  EXPECT_EQ(dictionary.Intern("bb", 2), 1);
+  EXPECT_EQ(dictionary.Intern("a", 1), 2);
+  EXPECT_EQ(dictionary.Intern("bb", 2), 1);
+  // Only the first aLength characters are the name.
+  EXPECT_EQ(dictionary.Intern("abc", 2), 3);
+  EXPECT_EQ(dictionary.Find("ab", 2), 3);
+  EXPECT_EQ(dictionary.Size(), 3u);
+
+  EXPECT_TRUE(dictionary.Contains(3));
+  EXPECT_FALSE(dictionary.Contains(4));
+  EXPECT_STREQ(dictionary.GetName(3), "ab");
+  EXPECT_EQ(dictionary.GetNameLength(3), 2u);
+
+  // Enough names to grow the shards' tables and span several segments of
+  // the id to name table.
+  for (int i = 0; i < 50000; i++) {
+    const string name = "item" + to_string(i);
+    EXPECT_EQ(dictionary.Intern(name.data(), name.size()), i + 4);
+  }
+  for (int i = 0; i < 50000; i++) {
+    const string name = "item" + to_string(i);
+    EXPECT_EQ(dictionary.Find(name.data(), name.size()), i + 4);
+    EXPECT_EQ(dictionary.GetName(i + 4), name);
+  }
+
+  dictionary.Reset();
+  EXPECT_EQ(dictionary.Size(), 0u);
+  EXPECT_FALSE(dictionary.Contains(1));
+  EXPECT_EQ(dictionary.Find("bb", 2), 0);
+  EXPECT_EQ(dictionary.Intern("zz", 2), 1);
+}
+
+TEST(ItemDictionary, ConcurrentIntern) {
+  ItemDictionary dictionary;
+  const int numThreads = 4;
+  const int numNames = 20000;
+  // Each thread interns every name, starting at a different offset, so
+  // threads race to insert the same names.
+  vector<vector<int>> ids(numThreads, vector<int>(numNames, 0));
+  vector<thread> threads;
+  // Meanwhile, every id counted by Size() must already have its name, as
+  // the pattern streams' name tables rely on.
+  atomic<bool> finished(false);
+  atomic<int> numUnwritten(0);
+  thread reader([&]() {
+    size_t numChecked = 0;
+    while (!finished) {
+      const size_t size = dictionary.Size();
+      for (; numChecked < size; numChecked++) {
+        const int id = static_cast<int>(numChecked + 1);
+        const char* name = dictionary.GetName(id);
+        if (!dictionary.Contains(id) || !name || name[0] != 'n' ||
+            dictionary.GetNameLength(id) < 2) {
+          numUnwritten++;
+        }
+      }
+    }
+  });
+  for (int t = 0; t < numThreads; t++) {
+    threads.emplace_back([&, t]() {
+      for (int j = 0; j < numNames; j++) {
+        const int i = (j + t * numNames / numThreads) % numNames;
+        const string name = "n" + to_string(i);
+        ids[t][i] = dictionary.Intern(name.data(), name.size());
+      }
+    });
+  }
+  for (thread& t : threads) {
+    t.join();
+  }
+  finished = true;
+  reader.join();
+  EXPECT_EQ(numUnwritten, 0);
+
+  EXPECT_EQ(dictionary.Size(), size_t(numNames));
+  vector<bool> seen(numNames + 1, false);
+  for (int i = 0; i < numNames; i++) {
+    const int id = ids[0][i];
+    for (int t = 1; t < numThreads; t++) {
+      EXPECT_EQ(ids[t][i], id);
+    }
+    ASSERT_TRUE(id >= 1 && id <= numNames);
+    EXPECT_FALSE(seen[id]);
+    seen[id] = true;
+    EXPECT_EQ(dictionary.GetName(id), "n" + to_string(i));
+  }
+}
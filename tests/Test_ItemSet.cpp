@@ -1,6 +1,8 @@
 #include "gtest/gtest.h"
 #include "ItemSet.h"
 #include "ItemMap.h"
+#include "ItemSetTrie.h"
+#include "InvertedDataSetIndex.h"
 
 #include <iostream>
 #include <string>
@@ -104,6 +106,50 @@ TEST(ItemSet, main) {
 
 }
 
+TEST(ItemSet, LargerThanInline) {
+  Item::SetCompareMode(Item::INSERTION_ORDER_COMPARE);
+
+  // Interleaved halves of 20 items, so the merge and the inserts spill out
+  // of the inline storage.
+  vector<Item> evens, odds, all;
+  for (int i = 1; i <= 20; i++) {
+    (i % 2 ? odds : evens).push_back(Item(i));
+    all.push_back(Item(i));
+  }
+  ItemSet even(evens);
+  ItemSet odd(vector<Item>(odds.rbegin(), odds.rend()));
+  ItemSet merged(even, odd);
+  ASSERT_EQ(merged.Size(), 20);
+  EXPECT_TRUE(merged == all);
+  EXPECT_EQ(merged.AsVector(), all);
+  EXPECT_EQ(merged.Hash(), ItemSet(all).Hash());
+
+  ItemSet added(odd);
+  for (const Item item : evens) {
+    added += item;
+  }
+  added += Item(3);
+  EXPECT_TRUE(added == merged);
+  EXPECT_EQ(IntersectionSize(even, merged), 10);
+  EXPECT_EQ(IntersectionSize(even, odd), 0);
+
+  ItemSet removed = merged;
+  for (const Item item : evens) {
+    Item i = item;
+    EXPECT_TRUE(removed.Contains(i));
+    removed = removed - item;
+    EXPECT_FALSE(removed.Contains(i));
+  }
+  EXPECT_TRUE(removed == odd);
+  EXPECT_EQ(removed.Hash(), odd.Hash());
+  EXPECT_FALSE(removed == even);
+  EXPECT_TRUE(even < merged);
+
+  ItemSet moved(move(merged));
+  EXPECT_TRUE(moved == all);
+  EXPECT_TRUE(merged.IsNull());
+}
+
 TEST(ItemMap, main) {
   std::map<int, unsigned> expected;
   ItemMap<unsigned> m;
@@ -123,4 +169,34 @@ TEST(ItemMap, main) {
     count++;
   }
   EXPECT_EQ(count, expected.size());
-}
\ No newline at end of file
+}
+TEST(ItemSetTrie, main) {
+  ItemSet abc("a", "b", "c");
+  ItemSet ab("a", "b");
+  ItemSet bc("b", "c");
+  ItemSet c("c");
+
+  ItemSetTrie trie;
+  trie.Insert(abc, 3);
+  trie.Insert(c, 7);
+  // "a b" is a prefix of "a b c", but wasn't inserted.
+  EXPECT_EQ(trie.Find(ab), -1);
+  EXPECT_EQ(trie.Find(bc), -1);
+  EXPECT_EQ(trie.Find(abc), 3);
+  EXPECT_EQ(trie.Find(c), 7);
+
+  ItemSetTrie other;
+  other.Insert(ab, 5);
+  other.Insert(c, 8);
+  trie.Append(other);
+
+  // Updated itemsets keep their original position.
+  ASSERT_EQ(trie.Size(), 3u);
+  EXPECT_TRUE(trie.Get(0) == abc);
+  EXPECT_EQ(trie.GetCount(0), 3);
+  EXPECT_TRUE(trie.Get(1) == c);
+  EXPECT_EQ(trie.GetCount(1), 8);
+  EXPECT_TRUE(trie.Get(2) == ab);
+  EXPECT_EQ(trie.GetCount(2), 5);
+  EXPECT_EQ(trie.Find(ab), 5);
+}
@@ -3,6 +3,12 @@
 #include <vector>
 #include "List.h"
 #include "PatternStream.h"
+#include "ItemSetTrie.h"
+#include "TestDataSets.h"
+#include "utils.h"
+
+#include <fstream>
+#include <sstream>
 
 using namespace std;
 
@@ -87,3 +93,105 @@ TEST(PatternStream, main) {
   }
   EXPECT_EQ(count, num);
 }
+
+TEST(PatternStream, WriteIds) {
+  // Items written from id spans in any order must come out as ItemSets
+  // write them, with the names sorted alphabetically, including for items
+  // interned after the stream was created.
+  shared_ptr<std::ostringstream> expected(make_shared<std::ostringstream>());
+  shared_ptr<std::ostringstream> actual(make_shared<std::ostringstream>());
+  auto patterns = make_shared<ItemSetTrie>();
+  {
+    PatternOutputStream out(actual, nullptr);
+    out.UseMinedCounts();
+    out.RecordPatterns(patterns);
+    PatternOutputStream forked = out.Fork();
+
+    const Item items[] = {Item("zeta"), Item("alpha"), Item("Beta"), Item("alp"), Item("stream-later")};
+    for (size_t n = 1; n <= 5; n++) {
+      out.Write(items, n, (int)n);
+      forked.Write(vector<Item>(items + 5 - n, items + 5), 10);
+      PatternOutputStream reference(expected, nullptr);
+      reference.Write(ItemSet(vector<Item>(items, items + n)));
+      reference.Close();
+    }
+    for (size_t n = 1; n <= 5; n++) {
+      PatternOutputStream reference(expected, nullptr);
+      reference.Write(ItemSet(vector<Item>(items + 5 - n, items + 5)));
+      reference.Close();
+    }
+    out.Join(forked);
+    EXPECT_EQ(out.GetNumPatterns(), 10);
+    out.Close();
+  }
+  EXPECT_EQ(actual->str(), expected->str());
+  // Both write all five items.
+  EXPECT_EQ(patterns->Size(), 9u);
+  EXPECT_EQ(patterns->Find(ItemSet("alpha", "zeta")), 2);
+  EXPECT_EQ(patterns->Find(ItemSet("alp", "stream-later")), 10);
+}
+
+TEST(PatternStream, UseMinedCounts) {
+  // The counts FP-Growth hands the stream must be the true counts, and the
+  // output the same as when the stream counts the patterns in the index.
+  UCIZooFixture zoo(kFPTree);
+  for (const double minSup : {0.4, 0.2}) {
+    const double minCount = minSup * zoo.index.NumTransactions();
+    const vector<pair<ItemSet, int>> frequent = zoo.FrequentItemSets(minCount);
+    EXPECT_GT(frequent.size(), 0u);
+    for (const pair<ItemSet, int>& x : frequent) {
+      ASSERT_EQ(x.second, zoo.index.Count(x.first));
+    }
+
+    string outputs[2];
+    for (const bool minedCounts : {false, true}) {
+      shared_ptr<std::ostringstream> stream(make_shared<std::ostringstream>());
+      PatternOutputStream out(stream, &zoo.index);
+      if (minedCounts) {
+        out.UseMinedCounts();
+      }
+      ParallelFPGrowth(zoo.tree, out, minCount, UINT32_MAX, nullptr, 1);
+      out.Close();
+      outputs[minedCounts] = stream->str();
+    }
+    EXPECT_FALSE(outputs[0].empty());
+    EXPECT_EQ(outputs[1], outputs[0]);
+  }
+}
+
+static string ReadFile(const string& aFilename) {
+  ifstream in(aFilename);
+  stringstream contents;
+  contents << in.rdbuf();
+  return contents.str();
+}
+
+TEST(GenerateRules, Parallel) {
+  // Every subset of 10 items, with counts that make most splits of each
+  // itemset into a rule; enough itemsets for several batches.
+  const char* names[] = {"a", "b", "c", "d", "e", "f", "g", "h", "i", "j"};
+  const unsigned numItems = 10;
+  ItemSetTrie itemsets;
+  for (unsigned mask = 1; mask < (1u << numItems); mask++) {
+    ItemSet itemset;
+    for (unsigned i = 0; i < numItems; i++) {
+      if (mask & (1u << i)) {
+        itemset.Add(Item(names[i]));
+      }
+    }
+    itemsets.Insert(itemset, itemset.Size() == 1 ? 50 : 46);
+  }
+
+  long numRules = 0;
+  GenerateRules(itemsets, 100, nullptr, 0.9, 1.0, numRules,
+                "Test_GenerateRules_1", false, 1);
+  EXPECT_GT(numRules, 0);
+  long numParallelRules = 0;
+  GenerateRules(itemsets, 100, nullptr, 0.9, 1.0, numParallelRules,
+                "Test_GenerateRules_4", false, 4);
+  EXPECT_EQ(numParallelRules, numRules);
+
+  const string rules = ReadFile(GetOutputRuleFileName("Test_GenerateRules_1"));
+  EXPECT_EQ(count(rules.begin(), rules.end(), '\n'), numRules);
+  EXPECT_EQ(ReadFile(GetOutputRuleFileName("Test_GenerateRules_4")), rules);
+}